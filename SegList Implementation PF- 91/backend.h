@@ -0,0 +1,43 @@
+/*
+ * backend.h - The allocators mdriver can run, as tables of functions
+ *
+ * mdriver -a <name> replays the traces against mm_backends[i] instead of
+ * mm.c(the first entry, and the default), and -a all against each in
+ * turn. Only init, malloc, free and realloc are required; the rest are
+ * NULL for an allocator that does not have them, and the mdriver
+ * options that need them refuse it.
+ *
+ * An allocator whose heap is not memlib's(libc) has memlib 0: mdriver
+ * then does not check that payloads lie in the heap, and cannot
+ * measure its utilization.
+ */
+#ifndef __BACKEND_H_
+#define __BACKEND_H_
+
+#include <stddef.h>
+
+#include "mm.h"
+
+typedef struct {
+    const char *name;
+    const char *desc;
+    int (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    int memlib;         /* takes its heap from mem_sbrk */
+
+    /* Optional: heap checker(-D), free space(-U), heap maps, counters */
+    int (*check)(int mode, int nthreads, mm_check_error_t *err);
+    void (*freeinfo)(mm_freeinfo_t *info);
+    int (*dump_heapmap)(int fd);
+    void (*stats)(struct mm_stats *st);
+} mm_backend_t;
+
+/* Every backend, ending with one whose name is NULL */
+extern const mm_backend_t mm_backends[];
+
+/* The backend called name, NULL if there is none */
+const mm_backend_t *find_backend(const char *name);
+
+#endif /* __BACKEND_H_ */
@@ -0,0 +1,55 @@
+/*
+ * backends.c - The table of allocators mdriver can run(see backend.h)
+ *
+ * The older allocators are built from their own sources with every
+ * public mm_* name prefixed(the Makefile's -D renames), so that they
+ * link next to mm.c: mm_explicit_* is the explicit free list of
+ * "../Explicit Free List Implementation PF-76/mm.c", mm_textbook_* the
+ * implicit list of textBook.c.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "backend.h"
+#include "mm_variants.h"
+
+int mm_explicit_init(void);
+void *mm_explicit_malloc(size_t size);
+void mm_explicit_free(void *ptr);
+void *mm_explicit_realloc(void *ptr, size_t size);
+
+int mm_textbook_init(void);
+void *mm_textbook_malloc(size_t size);
+void mm_textbook_free(void *ptr);
+void *mm_textbook_realloc(void *ptr, size_t size);
+
+/* libc's heap needs no setting up(nor can it be reset) */
+static int libc_init(void)
+{
+    return 0;
+}
+
+#define MM_PLAIN_BACKEND(name, desc)                                     \
+    { #name, desc, mm_##name##_init, mm_##name##_malloc,                 \
+      mm_##name##_free, mm_##name##_realloc, 1, NULL, NULL, NULL, NULL },
+
+const mm_backend_t mm_backends[] = {
+    { "mm", "mm.c: seg lists", mm_init, mm_malloc, mm_free, mm_realloc, 1,
+      mm_check, mm_freeinfo, mm_dump_heapmap, mm_stats },
+    MM_PLAIN_BACKEND(explicit, "explicit free list, first fit")
+    MM_PLAIN_BACKEND(textbook, "textBook.c: CS:APP implicit list")
+    MM_VARIANTS(MM_PLAIN_BACKEND)
+    { "libc", "the C library's malloc(no utilization)", libc_init, malloc,
+      free, realloc, 0, NULL, NULL, NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, NULL, NULL }
+};
+
+const mm_backend_t *find_backend(const char *name)
+{
+    const mm_backend_t *b;
+
+    for (b = mm_backends; b->name != NULL; b++)
+        if (strcmp(b->name, name) == 0)
+            return b;
+    return NULL;
+}
@@ -54,4 +54,16 @@ double fsecs(fsecs_test_funct f, void *argp)
 #endif 
 }
 
-
+/*
+ * fsecs_stats - Spread of the runs behind the last fsecs estimate
+ */
+int fsecs_stats(ftimer_stats_t *st)
+{
+#if USE_GETTOD
+    ftimer_last_stats(st);
+    return 1;
+#else
+    st->n = 0;
+    return 0;
+#endif
+}
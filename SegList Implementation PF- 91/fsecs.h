@@ -1,4 +1,10 @@
+#include "ftimer.h"
+
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+
+/* Spread of the runs behind the last fsecs estimate; returns 0 if the
+   timer in use does not keep it */
+int fsecs_stats(ftimer_stats_t *st);
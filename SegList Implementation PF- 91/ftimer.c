@@ -6,10 +6,12 @@
  *
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
- *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_gettod: version that times each run on its own
  */
+#include <math.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <time.h>
 #include "ftimer.h"
 
 /* function prototypes */
@@ -33,23 +35,69 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n)
     return tmeas / n;
 }
 
+/* Stats of the runs behind the last ftimer_gettod estimate */
+static ftimer_stats_t last;
+
 /* 
- * ftimer_gettod - Use gettimeofday to estimate the running time of
- * f(argp). Return the average of n runs.  
+ * ftimer_gettod - Estimate the running time of f(argp). Each of the n
+ * runs is timed on its own, with the monotonic clock since a single
+ * short run is far below gettimeofday's resolution, so that the spread
+ * of the runs is known too. Return the average of n runs.
  */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
 {
     int i;
-    struct timeval stv, etv;
-    double diff;
+    struct timespec stv, etv;
+    double diff, sum = 0, sumsq = 0;
 
-    gettimeofday(&stv, NULL);
-    for (i = 0; i < n; i++) 
+    for (i = 0; i < n; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &stv);
 	f(argp);
-    gettimeofday(&etv,NULL);
-    diff = 1E3*(etv.tv_sec - stv.tv_sec) + 1E-3*(etv.tv_usec-stv.tv_usec);
-    diff /= n;
-    return (1E-3*diff);
+        clock_gettime(CLOCK_MONOTONIC, &etv);
+        diff = (etv.tv_sec - stv.tv_sec) + 1E-9*(etv.tv_nsec - stv.tv_nsec);
+        sum += diff;
+        sumsq += diff * diff;
+    }
+
+    last.n = n;
+    last.mean = sum / n;
+    last.sd = 0;
+    last.ci95 = 0;
+    if (n > 1) {
+        diff = (sumsq - sum * last.mean) / (n - 1);
+        last.sd = (diff > 0) ? sqrt(diff) : 0;
+        last.ci95 = ftimer_t975(n - 1) * last.sd / sqrt(n);
+    }
+    return last.mean;
+}
+
+/*
+ * ftimer_last_stats - Spread of the runs of the last ftimer_gettod
+ */
+void ftimer_last_stats(ftimer_stats_t *st)
+{
+    *st = last;
+}
+
+/*
+ * ftimer_t975 - 97.5% quantile of Student's t with df degrees of
+ * freedom: from a table up to 30, then a series in 1/df that is
+ * within 0.001 of the exact value
+ */
+double ftimer_t975(double df)
+{
+    static const double t[31] = {
+        0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+        2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052,
+        2.048, 2.045, 2.042
+    };
+
+    if (df < 1)
+        df = 1;
+    if (df <= 30)
+        return t[(int)df];   /* rounding df down is conservative */
+    return 1.960 + 2.374 / df + 3.2 / (df * df);
 }
 
 
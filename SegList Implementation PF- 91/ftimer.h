@@ -1,3 +1,6 @@
+#ifndef __FTIMER_H_
+#define __FTIMER_H_
+
 /* 
  * Function timers 
  */
@@ -8,7 +11,21 @@ typedef void (*ftimer_test_funct)(void *);
 double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
 
 
-/* Estimate the running time of f(argp) using gettimeofday 
-   Return the average of n runs */
+/* Estimate the running time of f(argp) from n separately timed runs
+   Return their average */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Spread of the runs behind the last ftimer_gettod estimate */
+typedef struct {
+    int n;         /* number of runs */
+    double mean;   /* average secs per run */
+    double sd;     /* sample standard deviation */
+    double ci95;   /* half-width of the 95% confidence interval of mean */
+} ftimer_stats_t;
+void ftimer_last_stats(ftimer_stats_t *st);
+
+/* 97.5% quantile of Student's t distribution with df degrees of
+   freedom, for two-sided 95% intervals and tests */
+double ftimer_t975(double df);
+
+#endif /* __FTIMER_H_ */
@@ -0,0 +1,117 @@
+/*
+ * idmap.c - Map trace block ids to their blocks
+ *
+ * Linear probing, kept at most half full. Removal shifts the entries
+ * after the hole back instead of leaving tombstones, so a long replay
+ * with many short-lived ids never degrades.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "idmap.h"
+
+#define IDMAP_MINSLOTS 1024
+
+static size_t hash(const idmap_t *map, int id)
+{
+    return ((uint64_t)(unsigned)id * 0x9e3779b97f4a7c15ULL >> 32) & map->mask;
+}
+
+static int alloc_slots(idmap_t *map, size_t nslots)
+{
+    size_t i;
+
+    if ((map->slots = malloc(nslots * sizeof(*map->slots))) == NULL)
+        return -1;
+    for (i = 0; i < nslots; i++)
+        map->slots[i].id = -1;
+    map->mask = nslots - 1;
+    return 0;
+}
+
+/*
+ * grow - Double the table and rehash every entry into it
+ */
+static int grow(idmap_t *map)
+{
+    idmap_entry_t *old = map->slots;
+    size_t oldslots = map->mask + 1;
+    size_t i, j;
+
+    if (alloc_slots(map, 2 * oldslots) < 0) {
+        map->slots = old;
+        map->mask = oldslots - 1;
+        return -1;
+    }
+    for (i = 0; i < oldslots; i++) {
+        if (old[i].id < 0)
+            continue;
+        for (j = hash(map, old[i].id); map->slots[j].id >= 0;
+             j = (j + 1) & map->mask)
+            ;
+        map->slots[j] = old[i];
+    }
+    free(old);
+    return 0;
+}
+
+int idmap_init(idmap_t *map)
+{
+    map->count = 0;
+    return alloc_slots(map, IDMAP_MINSLOTS);
+}
+
+void idmap_deinit(idmap_t *map)
+{
+    free(map->slots);
+    map->slots = NULL;
+}
+
+idmap_entry_t *idmap_find(idmap_t *map, int id)
+{
+    size_t i;
+
+    for (i = hash(map, id); map->slots[i].id >= 0; i = (i + 1) & map->mask)
+        if (map->slots[i].id == id)
+            return &map->slots[i];
+    return NULL;
+}
+
+idmap_entry_t *idmap_insert(idmap_t *map, int id)
+{
+    idmap_entry_t *e;
+    size_t i;
+
+    if ((e = idmap_find(map, id)) != NULL)
+        return e;
+    if (2 * (map->count + 1) > map->mask + 1 && grow(map) < 0)
+        return NULL;
+
+    for (i = hash(map, id); map->slots[i].id >= 0; i = (i + 1) & map->mask)
+        ;
+    e = &map->slots[i];
+    e->id = id;
+    e->p = NULL;
+    e->size = 0;
+    map->count++;
+    return e;
+}
+
+void idmap_remove(idmap_t *map, idmap_entry_t *e)
+{
+    size_t hole = e - map->slots;
+    size_t i, home;
+
+    /* Move back every later entry of the run that the hole would
+       otherwise cut off from its home slot */
+    for (i = (hole + 1) & map->mask; map->slots[i].id >= 0;
+         i = (i + 1) & map->mask) {
+        home = hash(map, map->slots[i].id);
+        if (((i - home) & map->mask) >= ((i - hole) & map->mask)) {
+            map->slots[hole] = map->slots[i];
+            hole = i;
+        }
+    }
+    map->slots[hole].id = -1;
+    map->count--;
+}
@@ -0,0 +1,38 @@
+/*
+ * idmap.h - Map trace block ids to their blocks
+ *
+ * An open-addressing hash table sized by the number of live blocks
+ * rather than by the largest id, for traces whose id space is sparse
+ * or too big for the flat arrays in trace_t.
+ */
+#ifndef __IDMAP_H_
+#define __IDMAP_H_
+
+#include <stddef.h>
+
+typedef struct {
+    int id;       /* block id(0..INT_MAX), or -1 if the slot is empty */
+    char *p;      /* block returned by malloc/realloc... */
+    size_t size;  /* ...and its payload size */
+} idmap_entry_t;
+
+typedef struct {
+    idmap_entry_t *slots;
+    size_t mask;  /* number of slots - 1 */
+    size_t count; /* live entries */
+} idmap_t;
+
+int idmap_init(idmap_t *map);
+void idmap_deinit(idmap_t *map);
+
+/* Entry for id, or NULL if there is none */
+idmap_entry_t *idmap_find(idmap_t *map, int id);
+
+/* Entry for id, added with p NULL and size 0 if there was none;
+   NULL if out of memory. id must not be negative */
+idmap_entry_t *idmap_insert(idmap_t *map, int id);
+
+/* Remove the entry e returned by idmap_find or idmap_insert */
+void idmap_remove(idmap_t *map, idmap_entry_t *e);
+
+#endif /* __IDMAP_H_ */
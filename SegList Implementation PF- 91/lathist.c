@@ -0,0 +1,91 @@
+/*
+ * lathist.c - Low-overhead latency histograms (see lathist.h)
+ */
+#include <string.h>
+#include <time.h>
+#include "lathist.h"
+
+static double ns_per_tick = 1.0;
+
+/*
+ * lathist_reset - Clear a histogram
+ */
+void lathist_reset(lathist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+/*
+ * bin_high - Largest value that falls into bin
+ */
+static unsigned long bin_high(int bin)
+{
+    int shift;
+
+    if (bin < (2 << LATHIST_SUBBITS))
+        return bin;
+    shift = (bin >> LATHIST_SUBBITS) - 1;
+    return ((((unsigned long)bin & ((1 << LATHIST_SUBBITS) - 1)) +
+             (1UL << LATHIST_SUBBITS) + 1) << shift) - 1;
+}
+
+/*
+ * lathist_percentile - Smallest value that at least a fraction p of
+ *     the values are at or below. Reported as the top of its bin, but
+ *     never above the largest value recorded.
+ */
+unsigned long lathist_percentile(const lathist_t *h, double p)
+{
+    unsigned long rank, seen = 0;
+    unsigned long v;
+    int bin;
+
+    if (h->total == 0)
+        return 0;
+    rank = (unsigned long)(p * h->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    for (bin = 0; bin < LATHIST_NBINS; bin++) {
+        seen += h->counts[bin];
+        if (seen >= rank) {
+            v = bin_high(bin);
+            return (v < h->max) ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+/*
+ * elapsed_ns - Nanoseconds from a to b
+ */
+static double elapsed_ns(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+/*
+ * lathist_init - Measure how many nanoseconds a lathist_now() tick is
+ */
+void lathist_init(void)
+{
+    struct timespec start, now;
+    unsigned long t0, t1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    t0 = lathist_now();
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while (elapsed_ns(&start, &now) < 1e7);
+    t1 = lathist_now();
+
+    ns_per_tick = (t1 > t0) ? elapsed_ns(&start, &now) / (t1 - t0) : 1.0;
+}
+
+/*
+ * lathist_ticks_to_ns - Convert ticks to nanoseconds
+ */
+double lathist_ticks_to_ns(unsigned long ticks)
+{
+    return ticks * ns_per_tick;
+}
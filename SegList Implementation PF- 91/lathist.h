@@ -0,0 +1,69 @@
+/*
+ * lathist.h - Low-overhead latency histograms (HDR-style, log-linear)
+ *
+ * Values are binned by their top LATHIST_SUBBITS+1 significant bits, so
+ * every bin is within ~6% of the values it holds, whatever the range,
+ * and recording a value is a count-leading-zeros and an increment.
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#include <time.h>
+
+#define LATHIST_SUBBITS 4                          /* 16 bins per power of 2 */
+#define LATHIST_NBINS   (64 << LATHIST_SUBBITS)
+
+typedef struct {
+    unsigned long counts[LATHIST_NBINS];
+    unsigned long total;  /* number of values recorded */
+    unsigned long max;    /* largest value recorded */
+} lathist_t;
+
+/* Clear a histogram */
+void lathist_reset(lathist_t *h);
+
+/* Smallest value v such that a fraction p (0..1) of the values are <= v,
+   give or take the bin width. Returns 0 for an empty histogram. */
+unsigned long lathist_percentile(const lathist_t *h, double p);
+
+/* Calibrate lathist_ticks_to_ns (call once, takes ~10ms) */
+void lathist_init(void);
+
+/* Convert a difference of lathist_now() values to nanoseconds */
+double lathist_ticks_to_ns(unsigned long ticks);
+
+/* Bin of a value */
+static inline int lathist_bin(unsigned long v)
+{
+    int msb;
+
+    if (v < (2UL << LATHIST_SUBBITS))
+        return (int)v;
+    msb = 63 - __builtin_clzl(v);
+    return ((msb - LATHIST_SUBBITS + 1) << LATHIST_SUBBITS) +
+        (int)((v >> (msb - LATHIST_SUBBITS)) - (1UL << LATHIST_SUBBITS));
+}
+
+/* Record one value */
+static inline void lathist_record(lathist_t *h, unsigned long v)
+{
+    h->counts[lathist_bin(v)]++;
+    h->total++;
+    if (v > h->max)
+        h->max = v;
+}
+
+/* Timestamp in ticks: the cycle counter on x86, nanoseconds elsewhere */
+static inline unsigned long lathist_now(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+#endif
+}
+
+#endif /* __LATHIST_H_ */
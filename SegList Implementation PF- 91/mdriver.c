@@ -10,6 +10,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <float.h>
+#include <getopt.h>
+#include <math.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -18,11 +20,28 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef MM_THREADSAFE
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
 
 
 #include "mm.h"
+#include "backend.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "lathist.h"
+#include "perfctr.h"
+#include "trace.h"
+#include "tstream.h"
+#include "idmap.h"
 #include "config.h"
 
 /**********************
@@ -54,29 +73,29 @@
  * Remember that index (-1) is the null pointer.
  */
 
-/* Records the extent of each block's payload */
+/*
+ * Records the extent of each block's payload. The live payloads are
+ * kept in a treap: a search tree ordered by lo that is also a heap on
+ * prio, which keeps it balanced with high probability.
+ */
 typedef struct range_t {
     char *lo;              /* low payload address */
     char *hi;              /* high payload address */
-    struct range_t *next;  /* next list element */
+    struct range_t *left;  /* payloads below lo... */
+    struct range_t *right; /* ...and above hi */
+    unsigned prio;         /* random; no child has a higher one */
     int index;             /* same index as free; for debugging */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum { ALLOC, FREE, REALLOC } type; /* type of request */
-    int index;                        /* index for free() to use later */
-    size_t size;                      /* byte size of alloc/realloc request */
-} traceop_t;
-
 /* Holds the information for one trace file*/
 typedef struct {
     char filename[MAXLINE];
-    int ignore_ranges;   /* don't check ranges (i.e. this is too big) */
+    int ignore_ranges;   /* ignored: the range tree checks every trace */
     int num_ids;         /* number of alloc/realloc ids */
     int num_ops;         /* number of distinct requests */
     int weight;          /* weight for this trace (unused) */
     traceop_t *ops;      /* array of requests */
+    size_t map_len;      /* binary traces: length of the mapping of ops */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
     int *block_rand_base;/* index into random_data, if debug is on */
@@ -92,6 +111,14 @@ typedef struct {
     range_t *ranges;
 } speed_t;
 
+/* One point of the -U utilization timeline */
+typedef struct {
+    int opnum;          /* sampled after this op */
+    double live;        /* payload bytes allocated by the trace */
+    double heap;        /* mem_heapsize() */
+    mm_freeinfo_t fi;   /* the allocator's free space */
+} tlsample_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* set in read_trace */
@@ -102,9 +129,21 @@ typedef struct {
     /* run-time stats defined for both libc and student */
     int valid;       /* was the trace processed correctly by the allocator? */
     double secs;     /* number of secs needed to run the trace */
+    double secs_sd;  /* standard deviation of the timed runs... */
+    int nsamples;    /* ...and how many there were (0 if unknown) */
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    lathist_t *lat;  /* -L: latency of each op type, indexed by ALLOC... */
+
+    /* -P: hardware counters over one speed run (libc and student) */
+    int counted;     /* were the counters read for this trace? */
+    double counts[PERFCTR_NEVENTS]; /* -1 where an event is unavailable */
+    int scaled;      /* bit i: event i was multiplexed and scaled */
+
+    /* -U: the timeline sample where the heap grew at the lowest util */
+    int sampled;
+    tlsample_t worst;
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
@@ -121,8 +160,10 @@ typedef struct {
  * For debugging.  If debug-mode is on, then we have each block start
  * at a "random" place (a hash of the index), and copy random data
  * into it.  With DBG_CHEAP, we check that the data survived when we
- * realloc and when we free.  With DBG_EXPENSIVE, we check every block
- * every operation.
+ * realloc and when we free.  With DBG_EXPENSIVE, we check after every
+ * operation the blocks it touched and their neighbours, and every block
+ * at the end of the trace.  With DBG_FULL, we check every block every
+ * operation.
  * randint_t should be a byte, in case students return unaligned memory.
  *******************/
 #define RANDOM_DATA_LEN (1<<16)
@@ -135,7 +176,7 @@ static randint_t random_data[RANDOM_DATA_LEN];
  * Global variables
  *******************/
 
-static enum { DBG_NONE, DBG_CHEAP, DBG_EXPENSIVE } debug_mode = DBG_CHEAP;
+static enum { DBG_NONE, DBG_CHEAP, DBG_EXPENSIVE, DBG_FULL } debug_mode = DBG_CHEAP;
 
 int verbose = 1;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
@@ -144,6 +185,62 @@ int onetime_flag = 0;
 /* by default, no timeouts */
 static int set_timeout = 0;
 
+/* -L: time every op into per op type latency histograms */
+static int latency_mode = 0;
+
+/* -P: read hardware performance counters around the speed function */
+static int perf_mode = 0;
+
+/* -S: stream the traces instead of loading them */
+static int stream_mode = 0;
+
+/* --json/--csv: write the mm results to these files */
+static char *json_file = NULL;
+static char *csv_file = NULL;
+
+/* -U: write a utilization timeline of every trace to this file */
+static FILE *timeline = NULL;
+static int timeline_json = 0;
+static int timeline_first = 1;  /* no JSON trace object written yet */
+#define TL_SAMPLES 1000         /* about this many samples per trace */
+
+/* --heapmap: dump mm_dump_heapmap to <prefix><trace>.<op>.hmap before
+   each op in heapmap_ops (sorted) and, if heapmap_end, after the last */
+static char *heapmap_prefix = NULL;
+static int *heapmap_ops = NULL;
+static int heapmap_nops = 0;
+static int heapmap_end = 1;
+
+/* -a: the allocator under test; with several(-a all, or a list), each
+   of run_backends in turn, and their results side by side */
+static const mm_backend_t *backend = &mm_backends[0];
+static const mm_backend_t **run_backends = NULL;
+static int num_backends = 0;
+
+/* --guard: put about one allocation per guard_rate bytes on a guarded
+   page */
+static size_t guard_rate = 0;
+#define GUARD_SLOTS 256         /* guarded pages live or quarantined */
+
+/* --prof: sample about one allocation per prof_rate bytes over every
+   replay(mm_prof_start) and write the profile to prof_file at the end */
+static char *prof_file = NULL;
+static size_t prof_rate = 512 * 1024;
+
+/* -T: replay with 1..mt_threads threads; -X: shard ids across them */
+static int mt_threads = 0;
+static int mt_shard = 0;
+
+/* --fork: in the first run at every thread count, thread 0 forks before
+   its op mt_fork_at, and the child replays the trace on the copied heap */
+static int mt_fork_at = -1;
+
+/* --numa-spread: replay thread t allocates from NUMA node t % nodes */
+static int mt_numa_spread = 0;
+
+/* --cpu-cache: bytes of small blocks cached per CPU(mm_cpucache_start) */
+static size_t mt_cache_bytes = 0;
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -162,11 +259,13 @@ sum_stats_t global_mm_sum_stats;
  * Function prototypes
  *********************/
 
-/* these functions manipulate range lists */
+/* these functions manipulate the range tree */
 static int add_range(range_t **ranges, char *lo, int size,
                      const trace_t *trace, int opnum, int index);
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
+static void check_ranges(const trace_t *trace, int opnum, range_t *r);
+static void check_near(const trace_t *trace, int opnum, range_t *r, char *lo);
 
 /* These functions implement the debugging code */
 static void init_random_data(void);
@@ -176,6 +275,8 @@ static void randomize_block(trace_t *trace, int index);
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
                            const char *filename);
+static void map_trace(trace_t *trace);
+static void check_id(const trace_t *trace, int index, int type, int opnum);
 static void reinit_trace(trace_t *trace);
 static void free_trace(trace_t *trace);
 
@@ -188,10 +289,50 @@ static void eval_libc_speed(void *ptr);
 static int eval_mm_valid(trace_t *trace, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_latency(trace_t *trace, lathist_t *lat);
+static void eval_counters(void (*f)(void *), speed_t *speed_params,
+                          stats_t *stats);
+static void eval_mm_timeline(trace_t *trace, stats_t *stats);
+static void open_timeline(const char *filename);
+static const char *escape(const char *s, int json);
+static void close_timeline(void);
+static void eval_mm_heapmap(trace_t *trace, stats_t *stats);
+static void parse_heapmap_at(const char *list);
+static void write_prof(void);
+
+/* Routines for the streaming replay of traces */
+static void run_stream_tests(int num_tracefiles, const char *tracedir,
+                             char **tracefiles, stats_t *mm_stats);
+static void eval_mm_stream(stats_t *stats);
+
+#ifdef MM_THREADSAFE
+/* Routines for the multi-threaded replay of traces */
+static void run_mt_tests(int num_tracefiles, const char *tracedir,
+                         char **tracefiles);
+static double eval_mm_mt(trace_t *trace, int nthreads, double *thread_kops);
+static void *mt_worker(void *arg);
+#endif
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void printlatency(int n, stats_t *stats);
+static void printcounters(int n, stats_t *stats);
+static void printtimeline(int n, stats_t *stats);
+static void printmmstats(void);
+static void time_trace(fsecs_test_funct f, speed_t *speed_params,
+                       stats_t *stats);
+static void write_results(const char *filename, int json, int n,
+                          stats_t *stats, double util, double tput,
+                          double perfindex);
+static int compare_results(const char *oldfile, const char *newfile);
 static void usage(void);
+static void print_backends(FILE *fp);
+static void parse_backends(const char *list);
+static void run_all_backends(int num_tracefiles, const char *tracedir,
+                             char **tracefiles, range_t *ranges,
+                             speed_t *speed_params);
+static void printbackends(int n, stats_t **stats);
+static void free_stats(int n, stats_t *stats);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
 static void unix_error(const char *fmt, ...)
@@ -245,12 +386,26 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         if (mm_stats[i].valid) {
             if (verbose > 1)
                 printf("efficiency, ");
-            mm_stats[i].util = eval_mm_util(trace, i);
+            if (backend->memlib)
+                mm_stats[i].util = eval_mm_util(trace, i);
             speed_params->trace = trace;
             speed_params->ranges = ranges;
             if (verbose > 1)
                 printf("and performance.\n");
-            mm_stats[i].secs = fsecs(eval_mm_speed, speed_params);
+            time_trace(eval_mm_speed, speed_params, &mm_stats[i]);
+            if (verbose > 1 && backend->stats != NULL)
+                printmmstats();
+            if (latency_mode) {
+                if ((mm_stats[i].lat = malloc(3 * sizeof(lathist_t))) == NULL)
+                    unix_error("malloc failed in run_tests");
+                eval_mm_latency(trace, mm_stats[i].lat);
+            }
+            if (perf_mode)
+                eval_counters(eval_mm_speed, speed_params, &mm_stats[i]);
+            if (timeline != NULL)
+                eval_mm_timeline(trace, &mm_stats[i]);
+            if (heapmap_prefix != NULL)
+                eval_mm_heapmap(trace, &mm_stats[i]);
         }
 
         free_trace(trace);
@@ -260,6 +415,55 @@ static void run_tests(int num_tracefiles, const char *tracedir,
     }
 }
 
+/*
+ * run_all_backends - Run the traces against each of run_backends, then
+ *     print their results side by side
+ */
+static void run_all_backends(int num_tracefiles, const char *tracedir,
+                             char **tracefiles, range_t *ranges,
+                             speed_t *speed_params)
+{
+    stats_t **stats;
+    int b;
+
+    if ((stats = calloc(num_backends, sizeof(*stats))) == NULL)
+        unix_error("calloc failed in run_all_backends");
+    for (b = 0; b < num_backends; b++) {
+        backend = run_backends[b];
+        if (verbose > 1)
+            printf("\nTesting %s malloc\n", backend->name);
+        if ((stats[b] = calloc(num_tracefiles, sizeof(stats_t))) == NULL)
+            unix_error("calloc failed in run_all_backends");
+        if (stream_mode)
+            run_stream_tests(num_tracefiles, tracedir, tracefiles, stats[b]);
+        else
+            run_tests(num_tracefiles, tracedir, tracefiles, stats[b],
+                      ranges, speed_params);
+    }
+
+    if (verbose) {
+        printf("\n");
+        printbackends(num_tracefiles, stats);
+    }
+    for (b = 0; b < num_backends; b++)
+        free_stats(num_tracefiles, stats[b]);
+    free(stats);
+}
+
+/*
+ * free_stats - Free an array of per-trace stats and what they point to
+ */
+static void free_stats(int n, stats_t *stats)
+{
+    int i;
+
+    if (stats == NULL)
+        return;
+    for (i = 0; i < n; i++)
+        free(stats[i].lat);
+    free(stats);
+}
+
 /**************
  * Main routine
  **************/
@@ -277,6 +481,22 @@ int main(int argc, char **argv)
 
     int run_libc = 0;     /* If set, run libc malloc (set by -l) */
     int autograder = 0;   /* if set then called by autograder (-A) */
+    int compare = 0;      /* if set then compare two result files */
+
+    static const struct option longopts[] = {
+        { "json",    required_argument, NULL, 'J' },
+        { "csv",     required_argument, NULL, 'C' },
+        { "compare", no_argument,       NULL, 'K' },
+        { "heapmap", required_argument, NULL, 'H' },
+        { "guard",   required_argument, NULL, 'G' },
+        { "heapmap-at", required_argument, NULL, 'O' },
+        { "fork",    required_argument, NULL, 'F' },
+        { "numa-spread", no_argument,   NULL, 'N' },
+        { "cpu-cache", required_argument, NULL, 'Q' },
+        { "prof",    required_argument, NULL, 'I' },
+        { "prof-rate", required_argument, NULL, 'R' },
+        { NULL, 0, NULL, 0 }
+    };
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput = 0, p1, p2, perfindex;
@@ -290,9 +510,14 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hVAlD")) != EOF) {
+    while ((c = getopt_long(argc, argv, "a:d:f:c:s:t:v:hVAlDLPST:U:X",
+                            longopts, NULL)) != EOF) {
         switch (c) {
 
+        case 'a': /* Allocator(s) under test */
+            parse_backends(optarg);
+            break;
+
         case 'A': /* Hidden Autolab driver argument */
             autograder = 1;
             break;
@@ -340,14 +565,83 @@ int main(int argc, char **argv)
             debug_mode = atoi(optarg);
             break;
 
-        case 'D':
-            debug_mode = DBG_EXPENSIVE;
+        case 'D': /* -D -D checks every block after every op */
+            debug_mode = (debug_mode >= DBG_EXPENSIVE) ? DBG_FULL
+                                                       : DBG_EXPENSIVE;
             break;
 
         case 's':
             set_timeout = atoi(optarg);
             break;
 
+        case 'L': /* Per-op latency histograms */
+            latency_mode = 1;
+            break;
+
+        case 'P': /* Hardware performance counters */
+            perf_mode = 1;
+            break;
+
+        case 'S': /* Stream the traces */
+            stream_mode = 1;
+            break;
+
+        case 'U': /* Utilization timeline */
+            open_timeline(optarg);
+            break;
+
+        case 'T': /* Replay with 1..n threads */
+            mt_threads = atoi(optarg);
+            break;
+
+        case 'X': /* Shard ids across the threads */
+            mt_shard = 1;
+            break;
+
+        case 'F': /* Fork in the middle of the -T replay */
+            mt_fork_at = atoi(optarg);
+            break;
+
+        case 'N': /* Spread the -T threads over the NUMA nodes */
+            mt_numa_spread = 1;
+            break;
+
+        case 'Q': /* Per-CPU caches for the -T replay */
+            mt_cache_bytes = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'J': /* Results as JSON */
+            json_file = optarg;
+            break;
+
+        case 'C': /* Results as CSV */
+            csv_file = optarg;
+            break;
+
+        case 'K': /* Compare two result files */
+            compare = 1;
+            break;
+
+        case 'H': /* Heap maps */
+            heapmap_prefix = optarg;
+            break;
+
+        case 'O': /* Ops at which to write them */
+            parse_heapmap_at(optarg);
+            break;
+
+        case 'G': /* Sampled guard pages */
+            guard_rate = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'I': /* Heap profile */
+            prof_file = optarg;
+            break;
+
+        case 'R': /* Bytes between its samples */
+            prof_rate = strtoul(optarg, NULL, 0);
+            break;
+
         case 'h': /* Print this message */
             usage();
             exit(0);
@@ -358,6 +652,14 @@ int main(int argc, char **argv)
         }
     }
 
+    if (compare) {
+        if (argc - optind != 2) {
+            usage();
+            exit(1);
+        }
+        exit(compare_results(argv[optind], argv[optind + 1]));
+    }
+
     if (tracefiles == NULL) {
         tracefiles = default_tracefiles;
         num_tracefiles = sizeof(default_tracefiles) / sizeof(char *) - 1;
@@ -368,8 +670,41 @@ int main(int argc, char **argv)
         init_random_data();
     }
 
+    /* Options that need more of the allocator than -a gave */
+    if (num_backends > 1 &&
+        (timeline != NULL || heapmap_prefix != NULL || latency_mode ||
+         perf_mode || onetime_flag || json_file != NULL || csv_file != NULL))
+        app_error("-c, -L, -P, -U, --heapmap, --json and --csv need a "
+                  "single allocator");
+    if (timeline != NULL && backend->freeinfo == NULL)
+        app_error("-U: allocator %s reports no free space", backend->name);
+    if (heapmap_prefix != NULL && backend->dump_heapmap == NULL)
+        app_error("--heapmap: allocator %s has no heap map", backend->name);
+    if (mt_fork_at >= 0 && mt_threads == 0)
+        app_error("--fork needs -T");
+    if (mt_numa_spread && mt_threads == 0)
+        app_error("--numa-spread needs -T");
+    if (mt_cache_bytes > 0 && mt_threads == 0)
+        app_error("--cpu-cache needs -T");
+    if (stream_mode && (mt_threads > 0 || latency_mode || perf_mode ||
+                        timeline != NULL || heapmap_prefix != NULL))
+        app_error("-S does not go with -T, -L, -P, -U or --heapmap");
+    if ((guard_rate > 0 || mt_threads > 0 || prof_file != NULL) &&
+        (backend != &mm_backends[0] || num_backends > 1))
+        app_error("--guard, --prof and -T only work with the mm allocator");
+
+    if (guard_rate > 0 && mm_guard_start(guard_rate, GUARD_SLOTS) < 0)
+        app_error("mm_guard_start failed");
+    if (prof_file != NULL && mm_prof_start(prof_rate) < 0)
+        app_error("--prof-rate must be more than 0");
+
     /* Initialize the timing package */
     init_fsecs();
+    if (latency_mode)
+        lathist_init();
+    if (perf_mode && perfctr_open() == 0)
+        fprintf(stderr, "-P: no hardware counters available "
+                "(check /proc/sys/kernel/perf_event_paranoid)\n");
 
     /* Initialize the timeout */
     if (set_timeout > 0) {
@@ -377,6 +712,20 @@ int main(int argc, char **argv)
         alarm(set_timeout); 
     }
 
+    /*
+     * The multi-threaded replay only measures throughput, so it
+     * replaces the normal evaluation
+     */
+    if (mt_threads > 0) {
+#ifdef MM_THREADSAFE
+        run_mt_tests(num_tracefiles, tracedir, tracefiles);
+        write_prof();
+        exit(errors != 0);
+#else
+        app_error("-T needs a thread-safe allocator: use mdriver-mt\n");
+#endif
+    }
+
     /*
      * Optionally run and evaluate the libc malloc package
      */
@@ -400,7 +749,10 @@ int main(int argc, char **argv)
                 speed_params.trace = trace;
                 if (verbose > 1)
                     printf("and performance.\n");
-                libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+                time_trace(eval_libc_speed, &speed_params, &libc_stats[i]);
+                if (perf_mode)
+                    eval_counters(eval_libc_speed, &speed_params,
+                                  &libc_stats[i]);
             }
             free_trace(trace);
         }
@@ -413,6 +765,13 @@ int main(int argc, char **argv)
         }
     }
 
+    /* Several allocators: a table of their results instead of one's */
+    if (num_backends > 1) {
+        run_all_backends(num_tracefiles, tracedir, tracefiles, ranges,
+                         &speed_params);
+        exit(errors != 0);
+    }
+
     /*
      * Always run and evaluate the student's mm package
      */
@@ -424,8 +783,11 @@ int main(int argc, char **argv)
     if (mm_stats == NULL)
         unix_error("mm_stats calloc in main failed");
 
-    run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
-              ranges, &speed_params);
+    if (stream_mode)
+        run_stream_tests(num_tracefiles, tracedir, tracefiles, mm_stats);
+    else
+        run_tests(num_tracefiles, tracedir, tracefiles, mm_stats,
+                  ranges, &speed_params);
 
 
     /* Display the mm results in a compact table */
@@ -438,11 +800,21 @@ int main(int argc, char **argv)
                 printf(" => incorrect.\n\n");
             }
         } else {
-            printf("\nResults for mm malloc:\n");
+            printf("\nResults for %s malloc:\n", backend->name);
             printresults(num_tracefiles, mm_stats, &global_mm_sum_stats);
             printf("\n");
+            if (latency_mode) {
+                printlatency(num_tracefiles, mm_stats);
+                printf("\n");
+            }
+            if (timeline != NULL) {
+                printtimeline(num_tracefiles, mm_stats);
+                printf("\n");
+            }
         }
     }
+    if (timeline != NULL)
+        close_timeline();
 
     /* Optionally compare the performance of mm and libc */
     if (run_libc) {
@@ -551,6 +923,13 @@ int main(int argc, char **argv)
         printf("Terminated with %d errors\n", errors);
     }
 
+    if (json_file != NULL)
+        write_results(json_file, 1, num_tracefiles, mm_stats, avg_mm_util,
+                      avg_mm_throughput, perfindex);
+    if (csv_file != NULL)
+        write_results(csv_file, 0, num_tracefiles, mm_stats, avg_mm_util,
+                      avg_mm_throughput, perfindex);
+
     /* Optionally emit autoresult string */
     double raw_score = perfindex;
     if (raw_score < PERF_THRESHHOLD) {
@@ -564,21 +943,82 @@ int main(int argc, char **argv)
         printf("%s\n", autoresult);
     }
 
+    free_stats(num_tracefiles, mm_stats);
+    free_stats(num_tracefiles, libc_stats);
+    write_prof();
     exit(0);
 }
 
 
 /*****************************************************************
- * The following routines manipulate the range list, which keeps
+ * The following routines manipulate the range tree, which keeps
  * track of the extent of every allocated block payload. We use the
- * range list to detect any overlapping allocated blocks.
+ * range tree to detect any overlapping allocated blocks.
  ****************************************************************/
 
+/*
+ * range_prio - Random priorities for new range records
+ */
+static unsigned range_prio(void)
+{
+    static unsigned state = 2463534242u;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/*
+ * find_overlap - Return a range that overlaps [lo, hi], or NULL. The
+ *     live payloads never overlap, so one path down the tree suffices.
+ */
+static range_t *find_overlap(range_t *p, char *lo, char *hi)
+{
+    while (p != NULL) {
+        if (p->hi < lo)
+            p = p->right;
+        else if (p->lo > hi)
+            p = p->left;
+        else
+            return p;
+    }
+    return NULL;
+}
+
+/*
+ * insert_range - Insert the record n into the treap rooted at *pp
+ */
+static void insert_range(range_t **pp, range_t *n)
+{
+    range_t *p = *pp;
+
+    if (p == NULL) {
+        *pp = n;
+        return;
+    }
+    if (n->lo < p->lo) {
+        insert_range(&p->left, n);
+        if (p->left->prio > p->prio) {   /* rotate right */
+            *pp = p->left;
+            p->left = (*pp)->right;
+            (*pp)->right = p;
+        }
+    } else {
+        insert_range(&p->right, n);
+        if (p->right->prio > p->prio) {  /* rotate left */
+            *pp = p->right;
+            p->right = (*pp)->left;
+            (*pp)->left = p;
+        }
+    }
+}
+
 /*
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     we create a range struct for this block and add it to the range tree.
  */
 static int add_range(range_t **ranges, char *lo, int size,
                      const trace_t *trace, int opnum, int index)
@@ -595,42 +1035,36 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of the heap(or be guarded) */
+    if (backend->memlib && !mm_guard_owns(lo) &&
+        ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
+         (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi()))) {
         malloc_error(trace, opnum,
                      "Payload (%p:%p) lies outside heap (%p:%p)",
                      lo, hi, mem_heap_lo(), mem_heap_hi());
         return 0;
     }
 
-    /* If we can't afford the linear-time loop, we check less thoroughly and
-       just assume the overlap will be caught by writing random bits. */
-    if(trace->ignore_ranges || debug_mode == DBG_NONE) return 1;
-
-
     /* The payload must not overlap any other payloads */
-    for (p = *ranges;  p != NULL;  p = p->next) {
-        if ((lo >= p->lo && lo <= p-> hi) ||
-            (hi >= p->lo && hi <= p->hi)) {
-            malloc_error(trace, opnum,
-                         "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-                         lo, hi, p->lo, p->hi);
-            return 0;
-        }
+    if ((p = find_overlap(*ranges, lo, hi)) != NULL) {
+        malloc_error(trace, opnum,
+                     "Payload (%p:%p) overlaps another payload (%p:%p)\n",
+                     lo, hi, p->lo, p->hi);
+        return 0;
     }
 
     /*
      * Everything looks OK, so remember the extent of this block
-     * by creating a range struct and adding it the range list.
+     * by creating a range struct and adding it the range tree.
      */
     if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
         unix_error("malloc error in add_range");
-    p->next = *ranges;
     p->lo = lo;
     p->hi = hi;
+    p->left = p->right = NULL;
+    p->prio = range_prio();
     p->index = index;
-    *ranges = p;
+    insert_range(ranges, p);
 
     return 1;
 }
@@ -640,16 +1074,47 @@ static int add_range(range_t **ranges, char *lo, int size,
  */
 static void remove_range(range_t **ranges, char *lo)
 {
-    range_t *p;
-    range_t **prevpp = ranges;
-
-    for (p = *ranges;  p != NULL; p = p->next) {
-        if (p->lo == lo) {
-            *prevpp = p->next;
-            free(p);
-            break;
+    range_t **pp = ranges;
+    range_t *p, *c;
+
+    /* Find the record... */
+    while ((p = *pp) != NULL && p->lo != lo)
+        pp = (lo < p->lo) ? &p->left : &p->right;
+    if (p == NULL)
+        return;
+
+    /* ...and rotate it down until it has at most one child */
+    while (p->left != NULL && p->right != NULL) {
+        if (p->left->prio > p->right->prio) {
+            c = p->left;
+            p->left = c->right;
+            c->right = p;
+            *pp = c;
+            pp = &c->right;
+        } else {
+            c = p->right;
+            p->right = c->left;
+            c->left = p;
+            *pp = c;
+            pp = &c->left;
         }
-        prevpp = &(p->next);
+    }
+    *pp = (p->left != NULL) ? p->left : p->right;
+    free(p);
+}
+
+/*
+ * free_ranges - Free the records of the subtree rooted at p
+ */
+static void free_ranges(range_t *p)
+{
+    range_t *right;
+
+    while (p != NULL) {
+        free_ranges(p->left);
+        right = p->right;
+        free(p);
+        p = right;
     }
 }
 
@@ -658,14 +1123,53 @@ static void remove_range(range_t **ranges, char *lo)
  */
 static void clear_ranges(range_t **ranges)
 {
+    free_ranges(*ranges);
+    *ranges = NULL;
+}
+
+/*
+ * check_ranges - check_index every block in the subtree rooted at r
+ */
+static void check_ranges(const trace_t *trace, int opnum, range_t *r)
+{
+    while (r != NULL) {
+        check_ranges(trace, opnum, r->left);
+        check_index(trace, opnum, r->index);
+        r = r->right;
+    }
+}
+
+/*
+ * check_near - check_index the block whose payload starts at lo, if it
+ *     is live, and the live blocks just below and above it: the ones
+ *     that an op on lo may have written headers, footers or a bad copy
+ *     over. Blocks further away are left to the walk at the end.
+ */
+static void check_near(const trace_t *trace, int opnum, range_t *r, char *lo)
+{
+    range_t *below = NULL, *above = NULL;
     range_t *p;
-    range_t *pnext;
 
-    for (p = *ranges;  p != NULL;  p = pnext) {
-        pnext = p->next;
-        free(p);
+    while (r != NULL) {
+        if (r->lo < lo) {
+            below = r;
+            r = r->right;
+        } else if (r->lo > lo) {
+            above = r;
+            r = r->left;
+        } else {
+            check_index(trace, opnum, r->index);
+            for (p = r->left; p != NULL; p = p->right)
+                below = p;
+            for (p = r->right; p != NULL; p = p->left)
+                above = p;
+            break;
+        }
     }
-    *ranges = NULL;
+    if (below != NULL)
+        check_index(trace, opnum, below->index);
+    if (above != NULL)
+        check_index(trace, opnum, above->index);
 }
 
 /**********************************************
@@ -742,6 +1246,7 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
 {
     FILE *tracefile;
     trace_t *trace;
+    char magic[TRACE_MAGICLEN];
     char type[MAXLINE];
     int index, size;
     int max_index = 0;
@@ -760,10 +1265,63 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     if ((tracefile = fopen(trace->filename, "r")) == NULL) {
         unix_error("Could not open %s in read_trace", trace->filename);
     }
-    fscanf(tracefile, "%d", &trace->weight);
-    fscanf(tracefile, "%d", &trace->num_ids);
-    fscanf(tracefile, "%d", &trace->num_ops);
-    fscanf(tracefile, "%d", &trace->ignore_ranges);
+
+    /* Binary traces are mapped rather than parsed */
+    if (fread(magic, 1, TRACE_MAGICLEN, tracefile) == TRACE_MAGICLEN &&
+        memcmp(magic, TRACE_MAGIC, TRACE_MAGICLEN) == 0) {
+        fclose(tracefile);
+        map_trace(trace);
+    } else {
+        rewind(tracefile);
+        fscanf(tracefile, "%d", &trace->weight);
+        fscanf(tracefile, "%d", &trace->num_ids);
+        fscanf(tracefile, "%d", &trace->num_ops);
+        fscanf(tracefile, "%d", &trace->ignore_ranges);
+
+        /* We'll store each request line in the trace in this array */
+        trace->map_len = 0;
+        if ((trace->ops =
+             (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
+            unix_error("malloc 2 failed in read_trace");
+
+        /* read every request line in the trace file */
+        index = 0;
+        op_index = 0;
+        while (fscanf(tracefile, "%s", type) != EOF) {
+            switch(type[0]) {
+            case 'a':
+                fscanf(tracefile, "%u %u", &index, &size);
+                check_id(trace, index, ALLOC, op_index);
+                trace->ops[op_index].type = ALLOC;
+                trace->ops[op_index].index = index;
+                trace->ops[op_index].size = size;
+                max_index = (index > max_index) ? index : max_index;
+                break;
+            case 'r':
+                fscanf(tracefile, "%u %u", &index, &size);
+                check_id(trace, index, REALLOC, op_index);
+                trace->ops[op_index].type = REALLOC;
+                trace->ops[op_index].index = index;
+                trace->ops[op_index].size = size;
+                max_index = (index > max_index) ? index : max_index;
+                break;
+            case 'f':
+                fscanf(tracefile, "%u", &index);
+                check_id(trace, index, FREE, op_index);
+                trace->ops[op_index].type = FREE;
+                trace->ops[op_index].index = index;
+                break;
+            default:
+                app_error("Bogus type character (%c) in tracefile %s\n",
+                          type[0], trace->filename);
+            }
+            op_index++;
+            if(op_index == trace->num_ops) break;
+        }
+        fclose(tracefile);
+        assert(max_index == trace->num_ids - 1);
+        assert(trace->num_ops == op_index);
+    }
 
     if(trace->weight < 0 || trace->weight > 3) {
         app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
@@ -772,11 +1330,6 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
         app_error("%s: ignore-ranges can only be zero or one", trace->filename);
     }
 
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops =
-         (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-        unix_error("malloc 2 failed in read_trace");
-
     /* We'll keep an array of pointers to the allocated blocks here... */
     if ((trace->blocks =
          (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
@@ -792,42 +1345,6 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
          calloc(trace->num_ids, sizeof(*trace->block_rand_base))) == NULL)
         unix_error("malloc 5 failed in read_trace");
 
-
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-        switch(type[0]) {
-        case 'a':
-            fscanf(tracefile, "%u %u", &index, &size);
-            trace->ops[op_index].type = ALLOC;
-            trace->ops[op_index].index = index;
-            trace->ops[op_index].size = size;
-            max_index = (index > max_index) ? index : max_index;
-            break;
-        case 'r':
-            fscanf(tracefile, "%u %u", &index, &size);
-            trace->ops[op_index].type = REALLOC;
-            trace->ops[op_index].index = index;
-            trace->ops[op_index].size = size;
-            max_index = (index > max_index) ? index : max_index;
-            break;
-        case 'f':
-            fscanf(tracefile, "%ud", &index);
-            trace->ops[op_index].type = FREE;
-            trace->ops[op_index].index = index;
-            break;
-        default:
-            app_error("Bogus type character (%c) in tracefile %s\n",
-                      type[0], trace->filename);
-        }
-        op_index++;
-        if(op_index == trace->num_ops) break;
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-
     /* fill in the stats */
     strcpy(stats->filename, trace->filename);
     stats->weight = trace->weight;
@@ -836,6 +1353,75 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     return trace;
 }
 
+/*
+ * check_id - Reject an id of a text trace that the replay could not
+ *     index blocks[] with; as in map_trace, only a free may be negative
+ *     (free(NULL)). Ids past INT_MAX read as negative.
+ */
+static void check_id(const trace_t *trace, int index, int type, int opnum)
+{
+    if (index >= trace->num_ids || (index < 0 && type != FREE))
+        app_error("%s: bad index %u at op %d", trace->filename,
+                  (unsigned)index, opnum);
+}
+
+/*
+ * map_trace - Map the ops of the binary trace trace->filename in place
+ *     and fill in the header fields. The records are only checked, not
+ *     copied, so even huge captures load in about the time it takes to
+ *     page them in once.
+ */
+static void map_trace(trace_t *trace)
+{
+    const tracehdr_t *hdr;
+    struct stat st;
+    char *base;
+    int fd, i;
+    int max_index = -1;
+
+    if ((fd = open(trace->filename, O_RDONLY)) < 0 || fstat(fd, &st) < 0)
+        unix_error("Could not open %s in map_trace", trace->filename);
+    if ((size_t)st.st_size < sizeof(tracehdr_t))
+        app_error("%s: truncated binary trace", trace->filename);
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+        unix_error("mmap failed in map_trace");
+    close(fd);
+    madvise(base, st.st_size, MADV_WILLNEED);
+
+    hdr = (const tracehdr_t *)base;
+    if (hdr->version != TRACE_VERSION)
+        app_error("%s: binary trace version %u, expected %d",
+                  trace->filename, hdr->version, TRACE_VERSION);
+    if (hdr->num_ops > INT_MAX || hdr->num_ids < 0 ||
+        (size_t)st.st_size < sizeof(tracehdr_t) +
+                             hdr->num_ops * sizeof(traceop_t))
+        app_error("%s: truncated binary trace", trace->filename);
+
+    trace->weight = hdr->weight;
+    trace->num_ids = hdr->num_ids;
+    trace->num_ops = hdr->num_ops;
+    trace->ignore_ranges = hdr->ignore_ranges;
+    trace->ops = (traceop_t *)(base + sizeof(tracehdr_t));
+    trace->map_len = st.st_size;
+
+    /* The replay indexes blocks[] with these without checking */
+    for (i = 0; i < trace->num_ops; i++) {
+        const traceop_t *op = &trace->ops[i];
+
+        if (op->type != ALLOC && op->type != FREE && op->type != REALLOC)
+            app_error("%s: bogus type %d at op %d", trace->filename,
+                      op->type, i);
+        if (op->index >= trace->num_ids ||
+            (op->index < 0 && op->type != FREE))
+            app_error("%s: bad index %d at op %d", trace->filename,
+                      op->index, i);
+        if (op->type != FREE && op->index > max_index)
+            max_index = op->index;
+    }
+    assert(max_index == trace->num_ids - 1);
+}
+
 /*
  * reinit_trace - get the trace ready for another run.
  */
@@ -848,12 +1434,15 @@ static void reinit_trace(trace_t *trace)
 
 /*
  * free_trace - Free the trace record and the four arrays it points
- *              to, all of which were allocated in read_trace().
+ *              to, allocated(or, for ops, mapped) in read_trace().
  */
 static void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);
+    if (trace->map_len != 0)  /* unmap or free the ops... */
+        munmap((char *)trace->ops - sizeof(tracehdr_t), trace->map_len);
+    else
+        free(trace->ops);
+    free(trace->blocks);      /* ...the other three arrays... */
     free(trace->block_sizes);
     free(trace->block_rand_base);
     free(trace);              /* and the trace record itself... */
@@ -869,6 +1458,7 @@ static void free_trace(trace_t *trace)
  */
 static int eval_mm_valid(trace_t *trace, range_t **ranges)
 {
+    mm_check_error_t check_err;
     int i;
     int index;
     size_t size;
@@ -876,13 +1466,13 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
     char *oldp;
     char *p;
 
-    /* Reset the heap and free any records in the range list */
+    /* Reset the heap and free any records in the range tree */
     mem_reset_brk();
     clear_ranges(ranges);
     reinit_trace(trace);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (backend->init() < 0) {
         malloc_error(trace, 0, "mm_init failed.");
         return 0;
     }
@@ -892,18 +1482,20 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
         index = trace->ops[i].index;
         size = trace->ops[i].size;
 
-        if(debug_mode == DBG_EXPENSIVE) {
-            range_t *r;
-                        
-            /* Let the students check their own heap */
-            mm_checkheap(verbose);
+        if(debug_mode >= DBG_EXPENSIVE) {
+            /* Let the students check their own heap(what changed since
+               the last op) */
+            if (backend->check != NULL &&
+                backend->check(MM_CHECK_INCREMENTAL, 1, &check_err) !=
+                MM_CHECK_OK) {
+                malloc_error(trace, i, "heap check: %s at %p.",
+                             mm_check_strerror(check_err.code), check_err.bp);
+                return 0;
+            }
 
             /* Now check that all our allocated blocks have the right data */
-            r = *ranges;
-            while(r) {
-                check_index(trace, i, r->index);
-                r = r->next;
-            }
+            if (debug_mode == DBG_FULL)
+                check_ranges(trace, i, *ranges);
         }
 
         switch (trace->ops[i].type) {
@@ -911,14 +1503,14 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
         case ALLOC: /* mm_malloc */
 
             /* Call the student's malloc */
-            if ((p = mm_malloc(size)) == NULL) {
+            if ((p = backend->malloc(size)) == NULL) {
                 malloc_error(trace, i, "mm_malloc failed.");
                 return 0;
             }
 
             /*
              * Test the range of the new block for correctness and add it
-             * to the range list if OK. The block must be  be aligned properly,
+             * to the range tree if OK. The block must be  be aligned properly,
              * and must not overlap any currently allocated block.
              */
             if (add_range(ranges, p, size, trace, i, index) == 0)
@@ -930,6 +1522,8 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
             /* Set to random data, for debugging. */
             randomize_block(trace, index);
+            if (debug_mode == DBG_EXPENSIVE)
+                check_near(trace, i, *ranges, p);
             break;
 
         case REALLOC: /* mm_realloc */
@@ -937,7 +1531,7 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
             /* Call the student's realloc */
             oldp = trace->blocks[index];
-            newp = mm_realloc(oldp, size);
+            newp = backend->realloc(oldp, size);
             if( (newp == NULL) && (size != 0) ) {
                 malloc_error(trace, i, "mm_realloc failed.");
                 return 0;
@@ -949,10 +1543,10 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
             }
 
 
-            /* Remove the old region from the range list */
+            /* Remove the old region from the range tree */
             remove_range(ranges, oldp);
 
-            /* Check new block for correctness and add it to range list */
+            /* Check new block for correctness and add it to range tree */
             if (size > 0) {
                 if(add_range(ranges, newp, size, trace, i, index) == 0)
                     return 0;
@@ -970,6 +1564,12 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
             /* Set to random data, for debugging. */
             randomize_block(trace, index);
+            if (debug_mode == DBG_EXPENSIVE) {
+                if (newp != NULL)
+                    check_near(trace, i, *ranges, newp);
+                if (oldp != NULL && newp != oldp)
+                    check_near(trace, i, *ranges, oldp);
+            }
             break;
 
         case FREE: /* mm_free */
@@ -982,7 +1582,9 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
                 p = trace->blocks[index];
                 remove_range(ranges, p);
             }
-            mm_free(p);
+            backend->free(p);
+            if (debug_mode == DBG_EXPENSIVE && p != NULL)
+                check_near(trace, i, *ranges, p);
             break;
 
         default:
@@ -991,6 +1593,18 @@ static int eval_mm_valid(trace_t *trace, range_t **ranges)
 
     }
 
+    /* Every block's data once more, and one full check of the final
+       heap, with every core helping */
+    if (debug_mode >= DBG_EXPENSIVE)
+        check_ranges(trace, trace->num_ops, *ranges);
+    if (debug_mode >= DBG_EXPENSIVE && backend->check != NULL &&
+        backend->check(MM_CHECK_FULL, sysconf(_SC_NPROCESSORS_ONLN),
+                       &check_err) != MM_CHECK_OK) {
+        malloc_error(trace, trace->num_ops, "heap check: %s at %p.",
+                     mm_check_strerror(check_err.code), check_err.bp);
+        return 0;
+    }
+
     /* As far as we know, this is a valid malloc package */
     return 1;
 }
@@ -1021,7 +1635,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    if (backend->init() < 0)
         app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -1031,7 +1645,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
             index = trace->ops[i].index;
             size = trace->ops[i].size;
 
-            if ((p = mm_malloc(size)) == NULL) {
+            if ((p = backend->malloc(size)) == NULL) {
                 app_error("trace %d: mm_malloc failed in eval_mm_util",
                           tracenum);
             }
@@ -1049,7 +1663,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
             oldsize = trace->block_sizes[index];
 
             oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0) {
+            if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0) {
                 app_error("trace %d: mm_realloc failed in eval_mm_util",
                           tracenum);
             }
@@ -1071,7 +1685,7 @@ static double eval_mm_util(trace_t *trace, int tracenum)
                 p = trace->blocks[index];
             }
 
-            mm_free(p);
+            backend->free(p);
 
             total_size -= size;
             break;
@@ -1105,7 +1719,7 @@ static void eval_mm_speed(void *ptr)
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
-    if (mm_init() < 0)
+    if (backend->init() < 0)
         app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
@@ -1115,7 +1729,7 @@ static void eval_mm_speed(void *ptr)
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = backend->malloc(size)) == NULL)
                 app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
@@ -1124,7 +1738,7 @@ static void eval_mm_speed(void *ptr)
             index = trace->ops[i].index;
             newsize = trace->ops[i].size;
             oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
+            if ((newp = backend->realloc(oldp,newsize)) == NULL && newsize != 0)
                 app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
             break;
@@ -1136,7 +1750,7 @@ static void eval_mm_speed(void *ptr)
             } else {
                 block = trace->blocks[index];
             }
-            mm_free(block);
+            backend->free(block);
             break;
 
         default:
@@ -1145,78 +1759,602 @@ static void eval_mm_speed(void *ptr)
 }
 
 /*
- * eval_libc_valid - We run this function to make sure that the
- *    libc malloc can run to completion on the set of traces.
- *    We'll be conservative and terminate if any libc malloc call fails.
- *
+ * eval_mm_latency - Replay the trace once more, timing every single
+ *    request into the latency histogram of its type. Kept apart from
+ *    eval_mm_speed so that the timestamps don't slow down the
+ *    throughput measurements.
  */
-static int eval_libc_valid(trace_t *trace)
+static void eval_mm_latency(trace_t *trace, lathist_t *lat)
 {
-    int i, newsize;
-    char *p, *newp, *oldp;
+    int i, index;
+    char *p;
+    unsigned long start;
+
+    lathist_reset(&lat[ALLOC]);
+    lathist_reset(&lat[FREE]);
+    lathist_reset(&lat[REALLOC]);
 
     reinit_trace(trace);
+    mem_reset_brk();
+    if (backend->init() < 0)
+        app_error("mm_init failed in eval_mm_latency");
 
     for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
         switch (trace->ops[i].type) {
 
-        case ALLOC: /* malloc */
-            if ((p = malloc(trace->ops[i].size)) == NULL) {
-                malloc_error(trace, i, "libc malloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = p;
+        case ALLOC: /* mm_malloc */
+            start = lathist_now();
+            p = backend->malloc(trace->ops[i].size);
+            lathist_record(&lat[ALLOC], lathist_now() - start);
+            if (p == NULL)
+                app_error("mm_malloc error in eval_mm_latency");
+            trace->blocks[index] = p;
             break;
 
-        case REALLOC: /* realloc */
-            newsize = trace->ops[i].size;
-            oldp = trace->blocks[trace->ops[i].index];
-            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0) {
-                malloc_error(trace, i, "libc realloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = newp;
+        case REALLOC: /* mm_realloc */
+            start = lathist_now();
+            p = backend->realloc(trace->blocks[index], trace->ops[i].size);
+            lathist_record(&lat[REALLOC], lathist_now() - start);
+            if (p == NULL && trace->ops[i].size != 0)
+                app_error("mm_realloc error in eval_mm_latency");
+            trace->blocks[index] = p;
             break;
 
-        case FREE: /* free */
-            if(trace->ops[i].index >= 0) {
-                free(trace->blocks[trace->ops[i].index]);
-            } else {
-                free(0);
-            }
+        case FREE: /* mm_free */
+            p = (index < 0) ? NULL : trace->blocks[index];
+            start = lathist_now();
+            backend->free(p);
+            lathist_record(&lat[FREE], lathist_now() - start);
             break;
 
         default:
-            app_error("invalid operation type  in eval_libc_valid");
+            app_error("Nonexistent request type in eval_mm_latency");
         }
     }
+}
 
-    return 1;
+/*
+ * time_trace - Time the speed function f on a trace with fsecs and
+ *     keep the spread of the timed runs as well
+ */
+static void time_trace(fsecs_test_funct f, speed_t *speed_params,
+                       stats_t *stats)
+{
+    ftimer_stats_t st;
+
+    stats->secs = fsecs(f, speed_params);
+    stats->secs_sd = 0;
+    stats->nsamples = 0;
+    if (fsecs_stats(&st)) {
+        stats->secs_sd = st.sd;
+        stats->nsamples = st.n;
+    }
 }
 
 /*
- * eval_libc_speed - This is the function that is used by fcyc() to
- *    measure the running time of the libc malloc package on the set
- *    of traces.
+ * eval_counters - Run the speed function f once more with the hardware
+ *    counters on. fsecs has already warmed up the caches and the heap,
+ *    so this run sees the same steady state that was timed.
  */
-static void eval_libc_speed(void *ptr)
+static void eval_counters(void (*f)(void *), speed_t *speed_params,
+                          stats_t *stats)
 {
-    int i;
-    int index, size, newsize;
-    char *p, *newp, *oldp, *block;
-    trace_t *trace = ((speed_t *)ptr)->trace;
+    perfctr_start();
+    f(speed_params);
+    stats->scaled = perfctr_stop(stats->counts);
+    stats->counted = 1;
+}
 
-    reinit_trace(trace);
+/*
+ * wall_now - Current time in seconds
+ */
+static double wall_now(void)
+{
+    struct timespec ts;
 
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-        case ALLOC: /* malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = malloc(size)) == NULL)
-                unix_error("malloc failed in eval_libc_speed");
-            trace->blocks[index] = p;
-            break;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * escape - s as a JSON string body(\" and \\ escaped) or as a CSV
+ *     field(quoted, with "" for ", if it holds a comma, quote or
+ *     newline). The result lives in a static buffer until the next call.
+ */
+static const char *escape(const char *s, int json)
+{
+    static char buf[6 * MAXLINE + 3];
+    char *q = buf;
+
+    if (!json && strpbrk(s, ",\"\n") == NULL)
+        return s;
+    if (!json)
+        *q++ = '"';
+    for (; *s != '\0'; s++) {
+        if (json && (*s == '"' || *s == '\\'))
+            *q++ = '\\';
+        else if (json && (unsigned char)*s < 0x20) {
+            q += sprintf(q, "\\u%04x", (unsigned char)*s);
+            continue;
+        } else if (!json && *s == '"')
+            *q++ = '"';
+        *q++ = *s;
+    }
+    if (!json)
+        *q++ = '"';
+    *q = '\0';
+    return buf;
+}
+
+/*
+ * open_timeline - Start the -U timeline file; JSON if it ends in .json,
+ *     else CSV
+ */
+static void open_timeline(const char *filename)
+{
+    size_t len = strlen(filename);
+    int i;
+
+    if ((timeline = fopen(filename, "w")) == NULL)
+        unix_error("Could not open %s for the timeline", filename);
+    timeline_json = (len > 5 && strcmp(filename + len - 5, ".json") == 0);
+    if (timeline_json) {
+        fprintf(timeline, "[");
+    } else {
+        fprintf(timeline, "trace,op,live,heap,free,largest_free,ext_frag");
+        for (i = 0; i < MM_SIZECLASSES; i++)
+            fprintf(timeline, ",class%d", i);
+        fprintf(timeline, "\n");
+    }
+}
+
+static void close_timeline(void)
+{
+    if (timeline_json)
+        fprintf(timeline, "\n]\n");
+    if (fclose(timeline) != 0)
+        unix_error("Could not write the timeline");
+    timeline = NULL;
+}
+
+/*
+ * ext_frag - External fragmentation index of a sample: the share of
+ *     the free bytes that a request for all of them could not use
+ */
+static double ext_frag(const mm_freeinfo_t *fi)
+{
+    if (fi->free_bytes == 0)
+        return 0;
+    return 1.0 - (double)fi->largest_free / fi->free_bytes;
+}
+
+/*
+ * write_sample - Append one sample of trace filename to the timeline
+ */
+static void write_sample(const char *filename, const tlsample_t *t, int first)
+{
+    int i;
+
+    if (timeline_json) {
+        fprintf(timeline, "%s\n    {\"op\": %d, \"live\": %.0f, "
+                "\"heap\": %.0f, \"free\": %zu, \"largest_free\": %zu, "
+                "\"ext_frag\": %.4f, \"class_free\": [",
+                first ? "" : ",", t->opnum, t->live, t->heap,
+                t->fi.free_bytes, t->fi.largest_free, ext_frag(&t->fi));
+        for (i = 0; i < MM_SIZECLASSES; i++)
+            fprintf(timeline, "%s%zu", i ? ", " : "", t->fi.class_free[i]);
+        fprintf(timeline, "]}");
+    } else {
+        fprintf(timeline, "%s,%d,%.0f,%.0f,%zu,%zu,%.4f", escape(filename, 0),
+                t->opnum, t->live, t->heap, t->fi.free_bytes,
+                t->fi.largest_free, ext_frag(&t->fi));
+        for (i = 0; i < MM_SIZECLASSES; i++)
+            fprintf(timeline, ",%zu", t->fi.class_free[i]);
+        fprintf(timeline, "\n");
+    }
+}
+
+/*
+ * eval_mm_timeline - Replay the trace once more, sampling the live
+ *     payload, the heap size and the allocator's free space about
+ *     TL_SAMPLES times along the way. Since the heap never shrinks,
+ *     the worst point is the sample with the lowest utilization among
+ *     those where the heap had grown since the previous sample: that
+ *     is where the allocator asked for more memory it did not need.
+ */
+static void eval_mm_timeline(trace_t *trace, stats_t *stats)
+{
+    int i, index;
+    int every = trace->num_ops / TL_SAMPLES + 1;
+    double live = 0, lastheap;
+    tlsample_t t;
+    char *p;
+
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (backend->init() < 0)
+        app_error("mm_init failed in eval_mm_timeline");
+    lastheap = mem_heapsize();
+
+    if (timeline_json)
+        fprintf(timeline, "%s\n  {\"trace\": \"%s\", \"samples\": [",
+                timeline_first ? "" : ",", escape(stats->filename, 1));
+    timeline_first = 0;
+    stats->sampled = 0;
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            if ((p = backend->malloc(trace->ops[i].size)) == NULL)
+                app_error("mm_malloc error in eval_mm_timeline");
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = trace->ops[i].size;
+            live += trace->ops[i].size;
+            break;
+
+        case REALLOC: /* mm_realloc */
+            p = backend->realloc(trace->blocks[index], trace->ops[i].size);
+            if (p == NULL && trace->ops[i].size != 0)
+                app_error("mm_realloc error in eval_mm_timeline");
+            trace->blocks[index] = p;
+            live += (double)trace->ops[i].size - trace->block_sizes[index];
+            trace->block_sizes[index] = trace->ops[i].size;
+            break;
+
+        case FREE: /* mm_free */
+            if (index < 0) {
+                backend->free(NULL);
+                break;
+            }
+            backend->free(trace->blocks[index]);
+            live -= trace->block_sizes[index];
+            trace->block_sizes[index] = 0;
+            break;
+
+        default:
+            app_error("Nonexistent request type in eval_mm_timeline");
+        }
+
+        if (i % every != every - 1 && i != trace->num_ops - 1)
+            continue;
+        t.opnum = i;
+        t.live = live;
+        t.heap = mem_heapsize();
+        backend->freeinfo(&t.fi);
+        write_sample(stats->filename, &t, i < every);
+        if (t.heap > lastheap && (!stats->sampled ||
+            t.live / t.heap < stats->worst.live / stats->worst.heap)) {
+            stats->worst = t;
+            stats->sampled = 1;
+        }
+        lastheap = t.heap;
+    }
+
+    if (timeline_json && !stats->sampled)
+        fprintf(timeline, "\n  ], \"worst\": null}");
+    else if (timeline_json) {
+        t = stats->worst;
+        fprintf(timeline, "\n  ], \"worst\": {\"op\": %d, \"live\": %.0f, "
+                "\"heap\": %.0f, \"largest_free\": %zu, "
+                "\"ext_frag\": %.4f}}", t.opnum, t.live, t.heap,
+                t.fi.largest_free, ext_frag(&t.fi));
+    }
+}
+
+/* Sort heapmap_ops */
+static int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/*
+ * parse_heapmap_at - Parse the --heapmap-at list: op numbers and
+ *     "end", separated by commas
+ */
+static void parse_heapmap_at(const char *list)
+{
+    char *copy, *tok, *end;
+    long op;
+
+    if ((copy = strdup(list)) == NULL)
+        unix_error("strdup failed in parse_heapmap_at");
+    heapmap_end = 0;
+    heapmap_nops = 0;
+    for (tok = strtok(copy, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (strcmp(tok, "end") == 0) {
+            heapmap_end = 1;
+            continue;
+        }
+        op = strtol(tok, &end, 10);
+        if (*end != '\0' || end == tok || op < 0 || op > INT_MAX)
+            app_error("--heapmap-at: bad op number \"%s\"", tok);
+        if ((heapmap_ops = realloc(heapmap_ops, (heapmap_nops + 1) *
+                                   sizeof(int))) == NULL)
+            unix_error("realloc failed in parse_heapmap_at");
+        heapmap_ops[heapmap_nops++] = op;
+    }
+    free(copy);
+    qsort(heapmap_ops, heapmap_nops, sizeof(int), cmp_int);
+}
+
+/*
+ * write_heapmap - Dump the heap as <prefix><trace basename>.<op>.hmap
+ */
+static void write_heapmap(const char *filename, int opnum)
+{
+    char path[MAXLINE];
+    const char *base;
+    int fd;
+
+    base = strrchr(filename, '/');
+    base = base ? base + 1 : filename;
+    snprintf(path, sizeof(path), "%s%s.%d.hmap", heapmap_prefix, base, opnum);
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        unix_error("Could not open %s for the heap map", path);
+    if (backend->dump_heapmap(fd) < 0 || close(fd) < 0)
+        unix_error("Could not write the heap map %s", path);
+    if (verbose > 1)
+        printf("Wrote heap map %s\n", path);
+}
+
+/*
+ * write_prof - Write the --prof heap profile, if one was asked for
+ */
+static void write_prof(void)
+{
+    int fd;
+
+    if (prof_file == NULL)
+        return;
+    if ((fd = open(prof_file, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        unix_error("Could not open %s for the heap profile", prof_file);
+    if (mm_prof_dump(fd) < 0 || close(fd) < 0)
+        unix_error("Could not write the heap profile %s", prof_file);
+    if (verbose > 1)
+        printf("Wrote heap profile %s\n", prof_file);
+}
+
+/*
+ * eval_mm_heapmap - Replay the trace once more, writing a heap map
+ *     before each op in heapmap_ops (the heap as the first opnum ops
+ *     left it) and after the last op if heapmap_end
+ */
+static void eval_mm_heapmap(trace_t *trace, stats_t *stats)
+{
+    int i, index, next = 0;
+    char *p;
+
+    reinit_trace(trace);
+    mem_reset_brk();
+    if (backend->init() < 0)
+        app_error("mm_init failed in eval_mm_heapmap");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        for (; next < heapmap_nops && heapmap_ops[next] <= i; next++)
+            if (heapmap_ops[next] == i &&
+                (next == 0 || heapmap_ops[next - 1] != i))
+                write_heapmap(stats->filename, i);
+
+        index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            if ((p = backend->malloc(trace->ops[i].size)) == NULL)
+                app_error("mm_malloc error in eval_mm_heapmap");
+            trace->blocks[index] = p;
+            break;
+
+        case REALLOC: /* mm_realloc */
+            p = backend->realloc(trace->blocks[index], trace->ops[i].size);
+            if (p == NULL && trace->ops[i].size != 0)
+                app_error("mm_realloc error in eval_mm_heapmap");
+            trace->blocks[index] = p;
+            break;
+
+        case FREE: /* mm_free */
+            backend->free(index < 0 ? NULL : trace->blocks[index]);
+            break;
+
+        default:
+            app_error("Nonexistent request type in eval_mm_heapmap");
+        }
+    }
+    if (heapmap_end)
+        write_heapmap(stats->filename, trace->num_ops);
+}
+
+/*
+ * run_stream_tests - Replay each trace once, streaming it from disk.
+ *     There are no correctness checks and no separate timing runs, so
+ *     traces of any length can be replayed.
+ */
+static void run_stream_tests(int num_tracefiles, const char *tracedir,
+                             char **tracefiles, stats_t *mm_stats)
+{
+    int i;
+
+    for (i = 0; i < num_tracefiles; i++) {
+        mem_init();
+        strcpy(mm_stats[i].filename, tracedir);
+        strcat(mm_stats[i].filename, tracefiles[i]);
+        if (verbose > 1)
+            printf("Streaming tracefile: %s\n", mm_stats[i].filename);
+        eval_mm_stream(&mm_stats[i]);
+        mem_deinit();
+    }
+}
+
+/*
+ * eval_mm_stream - Replay stats->filename chunk by chunk, keeping the
+ *     blocks in an idmap. secs covers only the replay of the chunks,
+ *     not any wait for the reader; util is computed as in eval_mm_util.
+ */
+static void eval_mm_stream(stats_t *stats)
+{
+    tstream_t *ts;
+    tstream_info_t info;
+    const traceop_t *ops;
+    idmap_t map;
+    idmap_entry_t *e;
+    double start;
+    double total_size = 0, max_total_size = 0;
+    size_t size;
+    char *p;
+    int i, n;
+
+    if ((ts = tstream_open(stats->filename, &info)) == NULL)
+        unix_error("Could not open %s in eval_mm_stream", stats->filename);
+    if (idmap_init(&map) < 0)
+        unix_error("idmap_init failed in eval_mm_stream");
+    stats->weight = info.weight;
+    stats->ops = 0;
+    stats->secs = 0;
+    stats->valid = 0;
+
+    mem_reset_brk();
+    if (backend->init() < 0)
+        app_error("mm_init failed in eval_mm_stream");
+
+    while ((ops = tstream_next(ts, &n)) != NULL) {
+        start = wall_now();
+        for (i = 0; i < n; i++) {
+            switch (ops[i].type) {
+
+            case ALLOC:
+            case REALLOC:
+                if ((e = idmap_insert(&map, ops[i].index)) == NULL)
+                    unix_error("idmap_insert failed in eval_mm_stream");
+                size = ops[i].size;
+                if (ops[i].type == ALLOC)
+                    p = backend->malloc(size);
+                else
+                    p = backend->realloc(e->p, size);
+                if (p == NULL && size != 0) {
+                    printf("%s: op %.0f: %s failed\n", stats->filename,
+                           stats->ops + i,
+                           ops[i].type == ALLOC ? "mm_malloc" : "mm_realloc");
+                    errors = 1;
+                    goto out;
+                }
+                if (!IS_ALIGNED(p)) {
+                    printf("%s: op %.0f: payload %p is not aligned\n",
+                           stats->filename, stats->ops + i, p);
+                    errors = 1;
+                    goto out;
+                }
+                total_size += (double)size - e->size;
+                e->p = p;
+                e->size = size;
+                if (total_size > max_total_size)
+                    max_total_size = total_size;
+                break;
+
+            case FREE:
+                if ((e = idmap_find(&map, ops[i].index)) == NULL) {
+                    backend->free(NULL);
+                    break;
+                }
+                backend->free(e->p);
+                total_size -= e->size;
+                idmap_remove(&map, e);
+                break;
+            }
+        }
+        stats->secs += wall_now() - start;
+        stats->ops += n;
+    }
+
+    if (tstream_error(ts) || stats->ops != info.num_ops) {
+        printf("%s: trace ended after %.0f of %lu ops\n", stats->filename,
+               stats->ops, (unsigned long)info.num_ops);
+        errors = 1;
+    } else {
+        stats->valid = 1;
+        if (backend->memlib)
+            stats->util = max_total_size / mem_heapsize();
+    }
+
+ out:
+    idmap_deinit(&map);
+    tstream_close(ts);
+}
+
+/*
+ * eval_libc_valid - We run this function to make sure that the
+ *    libc malloc can run to completion on the set of traces.
+ *    We'll be conservative and terminate if any libc malloc call fails.
+ *
+ */
+static int eval_libc_valid(trace_t *trace)
+{
+    int i, newsize;
+    char *p, *newp, *oldp;
+
+    reinit_trace(trace);
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* malloc */
+            if ((p = malloc(trace->ops[i].size)) == NULL) {
+                malloc_error(trace, i, "libc malloc failed");
+                unix_error("System message");
+            }
+            trace->blocks[trace->ops[i].index] = p;
+            break;
+
+        case REALLOC: /* realloc */
+            newsize = trace->ops[i].size;
+            oldp = trace->blocks[trace->ops[i].index];
+            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0) {
+                malloc_error(trace, i, "libc realloc failed");
+                unix_error("System message");
+            }
+            trace->blocks[trace->ops[i].index] = newp;
+            break;
+
+        case FREE: /* free */
+            if(trace->ops[i].index >= 0) {
+                free(trace->blocks[trace->ops[i].index]);
+            } else {
+                free(0);
+            }
+            break;
+
+        default:
+            app_error("invalid operation type  in eval_libc_valid");
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * eval_libc_speed - This is the function that is used by fcyc() to
+ *    measure the running time of the libc malloc package on the set
+ *    of traces.
+ */
+static void eval_libc_speed(void *ptr)
+{
+    int i;
+    int index, size, newsize;
+    char *p, *newp, *oldp, *block;
+    trace_t *trace = ((speed_t *)ptr)->trace;
+
+    reinit_trace(trace);
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+        switch (trace->ops[i].type) {
+        case ALLOC: /* malloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = malloc(size)) == NULL)
+                unix_error("malloc failed in eval_libc_speed");
+            trace->blocks[index] = p;
+            break;
 
         case REALLOC: /* realloc */
             index = trace->ops[i].index;
@@ -1241,6 +2379,473 @@ static void eval_libc_speed(void *ptr)
     }
 }
 
+#ifdef MM_THREADSAFE
+/*****************************************************************
+ * Multi-threaded replay(-T). With 1..mt_threads threads, either every
+ * thread replays its own copy of the trace, or(-X) the ids of a single
+ * trace are sharded across the threads: id is allocated and realloc'ed
+ * by thread id % n and freed by thread (id + 1) % n, so that every free
+ * crosses threads. Ops on one id still run in trace order: id_done[id]
+ * counts the ops done on the id, and an op waits until that count
+ * reaches its own position(op_seq) among the id's ops. A thread runs
+ * its ops in trace order too, so the earliest unfinished op of the
+ * trace can always go ahead and no thread waits forever.
+ ****************************************************************/
+
+#define MT_MAXTHREADS 256 /* most threads -T accepts */
+#define MT_RUNS         3 /* runs per thread count; the fastest one counts */
+#define MT_SPINS      100 /* busy waits before a waiting thread yields */
+
+/* One replay thread */
+typedef struct {
+    pthread_t tid;
+    trace_t *trace;
+    char **blocks;       /* ptrs returned by malloc/realloc, by id */
+    int *ops;            /* -X: the ops this thread runs(NULL for all) */
+    int num_ops;         /* number of ops this thread runs */
+    const int *op_seq;   /* -X: position of every op among its id's ops */
+    int *id_done;        /* -X: number of ops done so far on every id */
+    double start;        /* when the thread started its ops... */
+    double end;          /* ...and when it finished them */
+    int failed;          /* mm_malloc or mm_realloc ran out of memory */
+    int fork_at;         /* --fork: fork before this op(-1: never)... */
+    pid_t child;         /* ...the child(0: not forked)... */
+    int child_fd;        /* ...and the pipe its report comes down */
+    int node;            /* --numa-spread: its NUMA node(-1: its CPU's) */
+} mtworker_t;
+
+/* What a --fork child did, sent to the parent through a pipe */
+typedef struct {
+    int state;           /* MT_FORK_* */
+    int ops;             /* ops replayed */
+    double secs;         /* how long they took */
+    long faults;         /* minor page faults before its first op */
+    int check;           /* mm_check afterwards(MM_CHECK_*) */
+} mtfork_t;
+
+enum { MT_FORK_NONE, MT_FORK_OK, MT_FORK_NOMEM, MT_FORK_HUNG, MT_FORK_DIED };
+
+static pthread_barrier_t mt_barrier; /* lines the threads up to start */
+static int mt_abort;                 /* set when any thread has failed */
+static mtfork_t mt_fork_result;      /* the last --fork child's report */
+
+#define MT_FORKWAIT    10 /* secs a --fork child gets before it is hung */
+
+/*
+ * mt_fork_child - The child of a --fork: replay the whole trace on top of
+ *     whatever the heap held at the fork, check the heap and report
+ */
+static void mt_fork_child(const trace_t *trace, int fd)
+{
+    mtfork_t r;
+    struct rusage ru;
+    mm_check_error_t err;
+    char **blocks;
+    traceop_t *op;
+    double start;
+    int i;
+
+    /* Faults so far are the pages the fork handlers copied */
+    memset(&r, 0, sizeof(r));
+    getrusage(RUSAGE_SELF, &ru);
+    r.faults = ru.ru_minflt;
+    r.state = MT_FORK_OK;
+
+    if ((blocks = calloc(trace->num_ids, sizeof(char *))) == NULL)
+        _exit(1);
+    start = wall_now();
+    for (i = 0; i < trace->num_ops && r.state == MT_FORK_OK; i++) {
+        op = &trace->ops[i];
+        switch (op->type) {
+        case ALLOC:
+            if ((blocks[op->index] = backend->malloc(op->size)) == NULL)
+                r.state = MT_FORK_NOMEM;
+            break;
+
+        case REALLOC:
+            blocks[op->index] = backend->realloc(blocks[op->index], op->size);
+            if (blocks[op->index] == NULL && op->size != 0)
+                r.state = MT_FORK_NOMEM;
+            break;
+
+        case FREE:
+            backend->free(op->index < 0 ? NULL : blocks[op->index]);
+            break;
+        }
+        r.ops++;
+    }
+    r.secs = wall_now() - start;
+    r.check = backend->check(MM_CHECK_FULL, 1, &err);
+
+    if (write(fd, &r, sizeof(r)) != sizeof(r))
+        _exit(1);
+    _exit(0);
+}
+
+/*
+ * mt_fork - Fork from replay thread w while the others go on
+ */
+static void mt_fork(mtworker_t *w)
+{
+    int fds[2];
+
+    if (pipe(fds) < 0)
+        unix_error("pipe failed in mt_fork");
+    if ((w->child = fork()) < 0)
+        unix_error("fork failed in mt_fork");
+    if (w->child == 0) {
+        close(fds[0]);
+        mt_fork_child(w->trace, fds[1]);
+    }
+    close(fds[1]);
+    w->child_fd = fds[0];
+}
+
+/*
+ * mt_fork_wait - Collect the report of w's child into mt_fork_result;
+ *     a child that says nothing for MT_FORKWAIT secs is hung(deadlocked
+ *     on the heap lock, most likely) and is killed
+ */
+static void mt_fork_wait(mtworker_t *w)
+{
+    struct pollfd pfd;
+    int status;
+
+    memset(&mt_fork_result, 0, sizeof(mt_fork_result));
+    if (w->child == 0)
+        return;
+
+    pfd.fd = w->child_fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, MT_FORKWAIT * 1000) == 0) {
+        kill(w->child, SIGKILL);
+        mt_fork_result.state = MT_FORK_HUNG;
+    } else if (read(w->child_fd, &mt_fork_result, sizeof(mt_fork_result)) !=
+               sizeof(mt_fork_result))
+        mt_fork_result.state = MT_FORK_DIED;
+    waitpid(w->child, &status, 0);
+    close(w->child_fd);
+    w->child = 0;
+}
+
+/*
+ * mt_wait_turn - Wait until *done reaches seq; returns 0 if another
+ *     thread failed meanwhile
+ */
+static int mt_wait_turn(const int *done, int seq)
+{
+    int spins = 0;
+
+    while (__atomic_load_n(done, __ATOMIC_ACQUIRE) != seq) {
+        if (__atomic_load_n(&mt_abort, __ATOMIC_RELAXED))
+            return 0;
+        if (++spins == MT_SPINS) {
+            spins = 0;
+            sched_yield();
+        }
+    }
+    return 1;
+}
+
+/*
+ * mt_worker - Body of a replay thread
+ */
+static void *mt_worker(void *arg)
+{
+    mtworker_t *w = (mtworker_t *)arg;
+    traceop_t *op;
+    int i, opnum, index;
+    char *p;
+
+    mm_numa_set_node(w->node);
+    pthread_barrier_wait(&mt_barrier);
+    w->start = wall_now();
+
+    for (i = 0; i < w->num_ops; i++) {
+        opnum = (w->ops != NULL) ? w->ops[i] : i;
+        op = &w->trace->ops[opnum];
+        index = op->index;
+
+        if (w->op_seq != NULL && index >= 0 &&
+            !mt_wait_turn(&w->id_done[index], w->op_seq[opnum]))
+            break;
+        if (i == w->fork_at)
+            mt_fork(w);
+
+        switch (op->type) {
+        case ALLOC:
+            if ((p = backend->malloc(op->size)) == NULL)
+                w->failed = 1;
+            w->blocks[index] = p;
+            break;
+
+        case REALLOC:
+            p = backend->realloc(w->blocks[index], op->size);
+            if (p == NULL && op->size != 0)
+                w->failed = 1;
+            w->blocks[index] = p;
+            break;
+
+        case FREE:
+            backend->free(index < 0 ? NULL : w->blocks[index]);
+            break;
+        }
+
+        if (w->failed) {
+            __atomic_store_n(&mt_abort, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        if (w->op_seq != NULL && index >= 0)
+            __atomic_store_n(&w->id_done[index], w->op_seq[opnum] + 1,
+                             __ATOMIC_RELEASE);
+    }
+
+    w->end = wall_now();
+    return NULL;
+}
+
+/*
+ * eval_mm_mt - Replay a trace with nthreads threads MT_RUNS times.
+ *     Returns the wall clock secs of the fastest run and fills in
+ *     the Kops of each thread in that run, or returns -1 if the heap
+ *     ran out of memory.
+ */
+static double eval_mm_mt(trace_t *trace, int nthreads, double *thread_kops)
+{
+    mtworker_t *workers;
+    int *op_seq = NULL;
+    int *id_done = NULL;
+    int *id_count;
+    int i, t, run, owner, index;
+    double start, end, best = -1;
+
+    if ((workers = calloc(nthreads, sizeof(mtworker_t))) == NULL)
+        unix_error("calloc failed in eval_mm_mt");
+
+    for (t = 0; t < nthreads; t++) {
+        workers[t].trace = trace;
+        workers[t].num_ops = trace->num_ops;
+        workers[t].blocks = trace->blocks;
+        workers[t].fork_at = -1;
+        workers[t].node = mt_numa_spread ? t % mm_numa_nodes() : -1;
+    }
+
+    if (mt_shard) {
+        /* Deal the ops out to their threads and number them by id */
+        if ((op_seq = malloc(trace->num_ops * sizeof(int))) == NULL ||
+            (id_done = calloc(trace->num_ids, sizeof(int))) == NULL ||
+            (id_count = calloc(trace->num_ids, sizeof(int))) == NULL)
+            unix_error("malloc failed in eval_mm_mt");
+
+        for (t = 0; t < nthreads; t++) {
+            workers[t].num_ops = 0;
+            workers[t].op_seq = op_seq;
+            workers[t].id_done = id_done;
+            if ((workers[t].ops = malloc(trace->num_ops * sizeof(int))) == NULL)
+                unix_error("malloc failed in eval_mm_mt");
+        }
+        for (i = 0; i < trace->num_ops; i++) {
+            index = trace->ops[i].index;
+            if (index < 0) {
+                owner = 0;
+            } else {
+                op_seq[i] = id_count[index]++;
+                owner = index % nthreads;
+                if (trace->ops[i].type == FREE)
+                    owner = (index + 1) % nthreads;
+            }
+            workers[owner].ops[workers[owner].num_ops++] = i;
+        }
+        free(id_count);
+    } else {
+        /* Every thread keeps its own block pointers */
+        for (t = 0; t < nthreads; t++)
+            if ((workers[t].blocks =
+                 calloc(trace->num_ids, sizeof(char *))) == NULL)
+                unix_error("calloc failed in eval_mm_mt");
+    }
+
+    for (run = 0; run < MT_RUNS; run++) {
+        mem_reset_brk();
+        if (backend->init() < 0)
+            app_error("mm_init failed in eval_mm_mt");
+        if (mt_shard) {
+            reinit_trace(trace);
+            memset(id_done, 0, trace->num_ids * sizeof(int));
+        } else {
+            for (t = 0; t < nthreads; t++)
+                memset(workers[t].blocks, 0, trace->num_ids * sizeof(char *));
+        }
+        mt_abort = 0;
+
+        /* The fork slows its run down, so leave the others to time */
+        workers[0].fork_at = (run == 0) ? mt_fork_at : -1;
+
+        pthread_barrier_init(&mt_barrier, NULL, nthreads);
+        for (t = 0; t < nthreads; t++) {
+            workers[t].failed = 0;
+            if (pthread_create(&workers[t].tid, NULL, mt_worker, &workers[t]))
+                unix_error("pthread_create failed in eval_mm_mt");
+        }
+        for (t = 0; t < nthreads; t++)
+            pthread_join(workers[t].tid, NULL);
+        pthread_barrier_destroy(&mt_barrier);
+        if (run == 0 && mt_fork_at >= 0)
+            mt_fork_wait(&workers[0]);
+
+        if (mt_abort) {
+            best = -1;
+            break;
+        }
+
+        start = workers[0].start;
+        end = workers[0].end;
+        for (t = 1; t < nthreads; t++) {
+            start = (workers[t].start < start) ? workers[t].start : start;
+            end = (workers[t].end > end) ? workers[t].end : end;
+        }
+        if (best < 0 || end - start < best) {
+            best = end - start;
+            for (t = 0; t < nthreads; t++)
+                thread_kops[t] = (workers[t].num_ops / 1e3) /
+                    (workers[t].end - workers[t].start);
+        }
+    }
+
+    for (t = 0; t < nthreads; t++) {
+        free(workers[t].ops);
+        if (!mt_shard)
+            free(workers[t].blocks);
+    }
+    free(workers);
+    free(op_seq);
+    free(id_done);
+    return best;
+}
+
+/*
+ * printfork - One line on what the --fork child did
+ */
+static void printfork(const mtfork_t *r)
+{
+    printf("%7s fork at op %d: ", "", mt_fork_at);
+    switch (r->state) {
+    case MT_FORK_NONE:
+        printf("thread 0 has fewer ops, no fork\n");
+        return;
+    case MT_FORK_HUNG:
+        printf("child hung(heap lock held across the fork?)\n");
+        errors++;
+        return;
+    case MT_FORK_DIED:
+        printf("child died without a report\n");
+        errors++;
+        return;
+    case MT_FORK_NOMEM:
+        printf("child ran out of heap after %d ops, ", r->ops);
+        break;
+    default:
+        printf("child replayed %d ops in %.6f secs, ", r->ops, r->secs);
+        break;
+    }
+    printf("%ld faults before, heap %s\n", r->faults,
+           r->check == MM_CHECK_OK ? "ok" : mm_check_strerror(r->check));
+    if (r->check != MM_CHECK_OK)
+        errors++;
+}
+
+/*
+ * printnuma - One line on how often the last run's threads used
+ *     another NUMA node's blocks
+ */
+static void printnuma(void)
+{
+    struct mm_stats st;
+
+    mm_stats(&st);
+    printf("%7s %llu nodes: %llu of %llu frees and %llu mallocs took "
+           "another node's block\n", "", (unsigned long long)st.numa_nodes,
+           (unsigned long long)st.remote_frees, (unsigned long long)st.nfree,
+           (unsigned long long)st.remote_fits);
+}
+
+/*
+ * printcache - One line on how much the last run's caches served
+ */
+static void printcache(void)
+{
+    struct mm_stats st;
+
+    mm_stats(&st);
+    printf("%7s cache: %llu of %llu mallocs, %llu of %llu frees; "
+           "%llu bytes cached, %llu in tables\n", "",
+           (unsigned long long)st.cache_mallocs,
+           (unsigned long long)(st.cache_mallocs + st.nmalloc),
+           (unsigned long long)st.cache_frees,
+           (unsigned long long)(st.cache_frees + st.nfree),
+           (unsigned long long)st.cache_bytes,
+           (unsigned long long)st.cache_tables);
+}
+
+/*
+ * run_mt_tests - Print the throughput of every trace with 1..mt_threads
+ *     threads: for all threads together and for each one of them
+ */
+static void run_mt_tests(int num_tracefiles, const char *tracedir,
+                         char **tracefiles)
+{
+    stats_t stats;
+    trace_t *trace;
+    double thread_kops[MT_MAXTHREADS];
+    double ops, secs;
+    int i, t, j;
+
+    if (mt_threads > MT_MAXTHREADS)
+        app_error("-T: at most %d threads\n", MT_MAXTHREADS);
+    if (mt_cache_bytes > 0) {
+        i = mm_cpucache_start(mt_cache_bytes);
+        if (i < 0)
+            app_error("mm_cpucache_start failed");
+        printf("\nCaching up to %lu bytes of small blocks per %s\n",
+               (unsigned long)mt_cache_bytes, i ? "CPU(rseq)" : "thread");
+    }
+
+    printf("\nResults for mm malloc with 1..%d threads (%s):\n", mt_threads,
+           mt_shard ? "ids sharded across threads, cross-thread frees"
+                    : "one copy of the trace per thread");
+    printf("%7s%10s%10s%8s  %s\n",
+           "threads", "ops", "secs", "Kops", "Kops per thread");
+
+    for (i = 0; i < num_tracefiles; i++) {
+        mem_init();
+        trace = read_trace(&stats, tracedir, tracefiles[i]);
+        printf("%s\n", trace->filename);
+
+        for (t = 1; t <= mt_threads; t++) {
+            ops = mt_shard ? trace->num_ops : (double)trace->num_ops * t;
+            secs = eval_mm_mt(trace, t, thread_kops);
+            if (secs < 0) {
+                printf("%7d%10.0f%10s%8s  out of heap\n", t, ops, "-", "-");
+                continue;
+            }
+            printf("%7d%10.0f%10.6f%8.0f ", t, ops, secs, (ops/1e3)/secs);
+            for (j = 0; j < t; j++)
+                printf(" %.0f", thread_kops[j]);
+            printf("\n");
+            if (mt_fork_at >= 0)
+                printfork(&mt_fork_result);
+            if (mm_numa_nodes() > 1)
+                printnuma();
+            if (mt_cache_bytes > 0)
+                printcache();
+        }
+
+        free_trace(trace);
+        mem_deinit();
+    }
+}
+#endif /* MM_THREADSAFE */
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
@@ -1370,6 +2975,386 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
         sumstats->secs = 0;
         sumstats->tput = 0;
     }
+
+    if (perf_mode)
+        printcounters(n, stats);
+}
+
+/*
+ * printcounters - prints the hardware counters of every valid trace
+ *                 that was run with -P, divided by its number of ops.
+ *                 Counts the kernel had to multiplex are marked with *.
+ */
+static void printcounters(int n, stats_t *stats)
+{
+    int i, j, scaled = 0;
+
+    printf("Hardware counters per op:\n");
+    for (j = 0; j < PERFCTR_NEVENTS; j++)
+        printf("%9s ", perfctr_name(j));
+    printf("  %s\n", "trace");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid || !stats[i].counted)
+            continue;
+        for (j = 0; j < PERFCTR_NEVENTS; j++) {
+            if (stats[i].counts[j] < 0)
+                printf("%9s ", "--");
+            else
+                printf("%9.2f%c", stats[i].counts[j] / stats[i].ops,
+                       (stats[i].scaled & (1 << j)) ? '*' : ' ');
+        }
+        printf("  %s\n", stats[i].filename);
+        scaled |= stats[i].scaled;
+    }
+    if (scaled)
+        printf("* multiplexed with other events and scaled; "
+               "less precise\n");
+}
+
+/*
+ * printlatency - prints the latency percentiles of every op type
+ *                for each valid trace that was run with -L.
+ */
+static void printlatency(int n, stats_t *stats)
+{
+    static const char *opnames[] = { "malloc", "free", "realloc" };
+    static const int optypes[] = { ALLOC, FREE, REALLOC };
+    lathist_t *h;
+    int i, j;
+
+    printf("Latency per op (ns):\n");
+    printf("%8s%9s%8s%8s%8s%9s  %s\n",
+           "op", "count", "p50", "p99", "p99.9", "max", "trace");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid || stats[i].lat == NULL)
+            continue;
+        for (j = 0; j < 3; j++) {
+            h = &stats[i].lat[optypes[j]];
+            if (h->total == 0)
+                continue;
+            printf("%8s%9lu%8.0f%8.0f%8.0f%9.0f  %s\n", opnames[j], h->total,
+                   lathist_ticks_to_ns(lathist_percentile(h, 0.50)),
+                   lathist_ticks_to_ns(lathist_percentile(h, 0.99)),
+                   lathist_ticks_to_ns(lathist_percentile(h, 0.999)),
+                   lathist_ticks_to_ns(h->max),
+                   stats[i].filename);
+        }
+    }
+}
+
+/*
+ * printmmstats - Print the allocator's own counters for the last
+ *     replay of a trace (-V)
+ */
+static void printmmstats(void)
+{
+    struct mm_stats st;
+
+    backend->stats(&st);
+    printf("  %llu malloc, %llu free, %llu realloc, %llu coalesce, "
+           "%llu split\n", (unsigned long long)st.nmalloc,
+           (unsigned long long)st.nfree, (unsigned long long)st.nrealloc,
+           (unsigned long long)st.ncoalesce, (unsigned long long)st.nsplit);
+    printf("  %llu extend_heap(%llu bytes), %.2f blocks per fit search "
+           "(max %llu, %llu misses)\n", (unsigned long long)st.nextend,
+           (unsigned long long)st.extend_bytes,
+           st.nsearch ? (double)st.search_steps / st.nsearch : 0.0,
+           (unsigned long long)st.search_max,
+           (unsigned long long)st.search_misses);
+    if (st.cache_tables > 0)
+        printf("  %llu mallocs and %llu frees served by caches, "
+               "%llu bytes cached\n", (unsigned long long)st.cache_mallocs,
+               (unsigned long long)st.cache_frees,
+               (unsigned long long)st.cache_bytes);
+    if (st.numa_nodes > 1)
+        printf("  %llu NUMA nodes: %llu remote frees, %llu remote fits\n",
+               (unsigned long long)st.numa_nodes,
+               (unsigned long long)st.remote_frees,
+               (unsigned long long)st.remote_fits);
+}
+
+/*
+ * printtimeline - prints the worst point of the -U timeline of each
+ *                 valid trace: where the heap grew at the lowest
+ *                 utilization
+ */
+static void printtimeline(int n, stats_t *stats)
+{
+    tlsample_t *t;
+    int i;
+
+    printf("Worst point of the utilization timeline:\n");
+    printf("%8s%10s%10s%6s%10s%10s%6s  %s\n", "op", "live", "heap", "util",
+           "free", "largest", "frag", "trace");
+    for (i = 0; i < n; i++) {
+        if (!stats[i].valid || !stats[i].sampled)
+            continue;
+        t = &stats[i].worst;
+        printf("%8d%10.0f%10.0f%5.0f%%%10zu%10zu%6.2f  %s\n", t->opnum,
+               t->live, t->heap, t->heap > 0 ? 100.0 * t->live / t->heap : 0,
+               t->fi.free_bytes, t->fi.largest_free, ext_frag(&t->fi),
+               stats[i].filename);
+    }
+}
+
+/*
+ * printbackends - Util and Kops of each of run_backends(stats[b]) on each
+ *     trace, and averaged as in printresults. '-' marks an invalid run
+ *     and a util that was not measured, '--' what a weight leaves out.
+ */
+static void printbackends(int n, stats_t **stats)
+{
+    double sumutil, sumops, sumsecs;
+    int b, i, nutil, valid;
+    const char *name;
+    stats_t *st;
+
+    printf("%-20s", "");
+    for (b = 0; b < num_backends; b++)
+        printf("%15s", run_backends[b]->name);
+    printf("\n%-20s", "trace");
+    for (b = 0; b < num_backends; b++)
+        printf("%7s%8s", "util", "Kops");
+    printf("\n");
+
+    for (i = 0; i < n; i++) {
+        name = strrchr(stats[0][i].filename, '/');
+        printf("%-20s", name != NULL ? name + 1 : stats[0][i].filename);
+        for (b = 0; b < num_backends; b++) {
+            st = &stats[b][i];
+            if (!st->valid)
+                printf("%7s%8s", "-", "-");
+            else {
+                if (st->weight == WPERF)
+                    printf("%7s", "--");
+                else if (!run_backends[b]->memlib)
+                    printf("%7s", "-");
+                else
+                    printf("%6.0f%%", st->util * 100.0);
+                if (st->weight == WUTIL)
+                    printf("%8s", "--");
+                else
+                    printf("%8.0f", (st->ops / 1e3) / st->secs);
+            }
+        }
+        printf("\n");
+    }
+
+    printf("%-20s", "average");
+    for (b = 0; b < num_backends; b++) {
+        sumutil = sumops = sumsecs = 0;
+        nutil = 0;
+        valid = 1;
+        for (i = 0; i < n; i++) {
+            st = &stats[b][i];
+            valid = valid && st->valid;
+            if (st->weight == WALL || st->weight == WUTIL) {
+                sumutil += st->util;
+                nutil++;
+            }
+            if (st->weight == WALL || st->weight == WPERF) {
+                sumops += st->ops;
+                sumsecs += st->secs;
+            }
+        }
+        if (!valid)
+            printf("%7s%8s", "-", "-");
+        else {
+            if (!run_backends[b]->memlib || nutil == 0)
+                printf("%7s", "-");
+            else
+                printf("%6.0f%%", sumutil / nutil * 100.0);
+            printf("%8.0f", sumsecs == 0 ? 0 : (sumops / 1e3) / sumsecs);
+        }
+    }
+    printf("\n");
+}
+
+/*
+ * write_results - Write the mm results of every trace, with the build
+ *     id and the overall scores, as JSON or CSV. The JSON has one
+ *     trace per line so that compare_results can read it back with
+ *     sscanf. A filename of "-" means stdout.
+ */
+static void write_results(const char *filename, int json, int n,
+                          stats_t *stats, double util, double tput,
+                          double perfindex)
+{
+    FILE *fp;
+    double ci95, kops;
+    int i;
+
+    if (strcmp(filename, "-") == 0)
+        fp = stdout;
+    else if ((fp = fopen(filename, "w")) == NULL)
+        unix_error("Could not open %s for the results", filename);
+
+    if (json)
+        fprintf(fp, "{\"build_id\": \"%s\", \"util\": %.4f, \"kops\": %.0f, "
+                "\"perf_index\": %.1f, \"errors\": %d, \"traces\": [\n",
+                mm_build_id(), util, tput / 1e3, perfindex, errors);
+    else
+        fprintf(fp, "build_id,trace,valid,weight,util,ops,secs,secs_sd,"
+                "samples,secs_ci95,kops\n");
+
+    for (i = 0; i < n; i++) {
+        ci95 = 0;
+        if (stats[i].nsamples > 1)
+            ci95 = ftimer_t975(stats[i].nsamples - 1) * stats[i].secs_sd /
+                   sqrt(stats[i].nsamples);
+        kops = (stats[i].valid && stats[i].secs > 0) ?
+               stats[i].ops / 1e3 / stats[i].secs : 0;
+        if (json)
+            fprintf(fp, "  {\"trace\": \"%s\", \"valid\": %d, "
+                    "\"weight\": %d, \"util\": %.6f, \"ops\": %.0f, "
+                    "\"secs\": %.9f, \"secs_sd\": %.9f, \"samples\": %d, "
+                    "\"secs_ci95\": %.9f, \"kops\": %.1f}%s\n",
+                    escape(stats[i].filename, 1), stats[i].valid,
+                    stats[i].weight, stats[i].util, stats[i].ops, stats[i].secs,
+                    stats[i].secs_sd, stats[i].nsamples, ci95, kops,
+                    i < n - 1 ? "," : "");
+        else
+            fprintf(fp, "%s,%s,%d,%d,%.6f,%.0f,%.9f,%.9f,%d,%.9f,%.1f\n",
+                    mm_build_id(), escape(stats[i].filename, 0), stats[i].valid,
+                    stats[i].weight, stats[i].util, stats[i].ops,
+                    stats[i].secs, stats[i].secs_sd, stats[i].nsamples,
+                    ci95, kops);
+    }
+
+    if (json)
+        fprintf(fp, "]}\n");
+    if (fp != stdout && fclose(fp) != 0)
+        unix_error("Could not write %s", filename);
+}
+
+/* One trace's line of a result file, as read back by read_results */
+typedef struct {
+    char trace[MAXLINE];
+    int valid;
+    double util, ops, secs, sd;
+    int n;
+} result_t;
+
+/*
+ * read_results - Read the per trace results of a file written by
+ *     write_results (either format); returns how many there are
+ */
+static int read_results(const char *filename, result_t **results,
+                        char *build_id)
+{
+    FILE *fp;
+    char line[4 * MAXLINE], id[MAXLINE];
+    result_t r;
+    int n = 0, max = 0, weight;
+
+    if ((fp = fopen(filename, "r")) == NULL)
+        unix_error("Could not open %s", filename);
+    *results = NULL;
+    strcpy(build_id, "?");
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (line[0] == '{') {
+            sscanf(line, "{\"build_id\": \"%1023[^\"]\"", build_id);
+            continue;
+        }
+        if (sscanf(line, "  {\"trace\": \"%1023[^\"]\", \"valid\": %d, "
+                   "\"weight\": %d, \"util\": %lf, \"ops\": %lf, "
+                   "\"secs\": %lf, \"secs_sd\": %lf, \"samples\": %d",
+                   r.trace, &r.valid, &weight, &r.util, &r.ops, &r.secs,
+                   &r.sd, &r.n) != 8) {
+            if (sscanf(line, "%1023[^,],%1023[^,],%d,%d,%lf,%lf,%lf,%lf,%d",
+                       id, r.trace, &r.valid, &weight, &r.util, &r.ops,
+                       &r.secs, &r.sd, &r.n) != 9)
+                continue;   /* header or trailer line */
+            strcpy(build_id, id);
+        }
+
+        if (n == max) {
+            max = max ? 2 * max : 32;
+            if ((*results = realloc(*results, max * sizeof(r))) == NULL)
+                unix_error("realloc failed in read_results");
+        }
+        (*results)[n++] = r;
+    }
+    fclose(fp);
+    return n;
+}
+
+/*
+ * compare_results - Compare the traces that two result files share.
+ *     A slowdown counts only if Welch's t-test finds it significant at
+ *     the 5% level and it is at least COMPARE_MINSLOW: the runs within
+ *     one mdriver invocation vary less than separate invocations do, so
+ *     tiny but "significant" changes are mostly noise. util is
+ *     deterministic, so any drop counts. Returns 1 if anything
+ *     regressed, for use as exit status.
+ */
+#define COMPARE_MINSLOW 0.05
+static int compare_results(const char *oldfile, const char *newfile)
+{
+    result_t *olds, *news, *o, *w;
+    char oldid[MAXLINE], newid[MAXLINE];
+    double vo, vw, se, t, df, change;
+    const char *verdict;
+    int nold, nnew, i, j;
+    int regressions = 0;
+
+    nold = read_results(oldfile, &olds, oldid);
+    nnew = read_results(newfile, &news, newid);
+    printf("Comparing %s (build %s) with %s (build %s)\n",
+           oldfile, oldid, newfile, newid);
+    printf("%7s%7s%10s%10s%8s%7s  %-8s %s\n", "util", "util'", "Kops",
+           "Kops'", "change", "t", "verdict", "trace");
+
+    for (i = 0; i < nnew; i++) {
+        w = &news[i];
+        for (j = 0, o = NULL; j < nold && o == NULL; j++)
+            if (strcmp(olds[j].trace, w->trace) == 0)
+                o = &olds[j];
+        if (o == NULL || !o->valid)
+            continue;
+        if (!w->valid) {
+            printf("%7s%7s%10s%10s%8s%7s  %-8s %s\n", "", "", "", "", "",
+                   "", "INVALID", w->trace);
+            regressions++;
+            continue;
+        }
+
+        /* Welch's t-test on the mean secs per run */
+        t = 0;
+        verdict = "same";
+        if (o->n > 1 && w->n > 1) {
+            vo = o->sd * o->sd / o->n;
+            vw = w->sd * w->sd / w->n;
+            se = sqrt(vo + vw);
+            if (se > 0) {
+                t = (w->secs - o->secs) / se;
+                df = (vo + vw) * (vo + vw) /
+                     (vo * vo / (o->n - 1) + vw * vw / (w->n - 1));
+                if (fabs(t) > ftimer_t975(df) &&
+                    fabs(w->secs - o->secs) >= COMPARE_MINSLOW * o->secs)
+                    verdict = (t > 0) ? "SLOWER" : "faster";
+            }
+        } else {
+            verdict = "?";   /* no spread recorded */
+        }
+        if (w->util < o->util - 0.0005)
+            verdict = (t > 0 && verdict[0] == 'S') ? "SLOW+UTIL" : "UTIL";
+        if (verdict[0] == 'S' || verdict[0] == 'U')
+            regressions++;
+
+        change = (w->secs > 0) ? 100.0 * (o->secs / w->secs - 1) : 0;
+        printf("%6.1f%%%6.1f%%%10.0f%10.0f%+7.1f%%%7.2f  %-8s %s\n",
+               100 * o->util, 100 * w->util,
+               o->secs > 0 ? o->ops / 1e3 / o->secs : 0,
+               w->secs > 0 ? w->ops / 1e3 / w->secs : 0,
+               change, t, verdict, w->trace);
+    }
+
+    printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+    free(olds);
+    free(news);
+    return regressions > 0;
 }
 
 /*
@@ -1412,21 +3397,104 @@ void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     va_end(ap);
 }
 
+/*
+ * print_backends - List the allocators -a can choose
+ */
+static void print_backends(FILE *fp)
+{
+    const mm_backend_t *b;
+
+    for (b = mm_backends; b->name != NULL; b++)
+        fprintf(fp, "\t%-12s %s\n", b->name, b->desc);
+}
+
+/*
+ * parse_backends - Set the allocators to run from -a's comma separated
+ *     names: "all" is every one, and "help" lists them
+ */
+static void parse_backends(const char *list)
+{
+    const mm_backend_t *b;
+    char *names, *name, *save;
+
+    if (strcmp(list, "help") == 0) {
+        print_backends(stdout);
+        exit(0);
+    }
+
+    num_backends = 0;
+    if (strcmp(list, "all") == 0) {
+        for (b = mm_backends; b->name != NULL; b++)
+            num_backends++;
+        if ((run_backends = realloc(run_backends, num_backends *
+                                    sizeof(*run_backends))) == NULL)
+            unix_error("realloc failed in parse_backends");
+        for (b = mm_backends; b->name != NULL; b++)
+            run_backends[b - mm_backends] = b;
+    } else {
+        if ((names = strdup(list)) == NULL)
+            unix_error("strdup failed in parse_backends");
+        for (name = strtok_r(names, ",", &save); name != NULL;
+             name = strtok_r(NULL, ",", &save)) {
+            if ((b = find_backend(name)) == NULL) {
+                fprintf(stderr, "Unknown allocator %s; there are:\n", name);
+                print_backends(stderr);
+                exit(1);
+            }
+            if ((run_backends = realloc(run_backends, (num_backends + 1) *
+                                        sizeof(*run_backends))) == NULL)
+                unix_error("realloc failed in parse_backends");
+            run_backends[num_backends++] = b;
+        }
+        free(names);
+    }
+    if (num_backends == 0) {
+        usage();
+        exit(1);
+    }
+    backend = run_backends[0];
+}
+
 /*
  * usage - Explain the command line arguments
  */
 static void usage(void)
 {
-    fprintf(stderr, "Usage: mdriver [-hlVdD] [-f <file>]\n");
+    fprintf(stderr, "Usage: mdriver [-hlLPSVdDX] [-a <name>,...|all|help] [-U <file>] [-f <file>] [-T <n>]\n"
+            "               [--json <file>] [--csv <file>]\n"
+            "               [--heapmap <prefix> [--heapmap-at <op>,...|end]]\n"
+            "               [--guard <bytes>] [--fork <op>] [--numa-spread]\n"
+            "               [--cpu-cache <bytes>] [--prof <file> [--prof-rate <bytes>]]\n"
+            "       mdriver --compare <old results> <new results>\n");
     fprintf(stderr, "Options\n");
-    fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
-    fprintf(stderr, "\t-D         Equivalent to -d2.\n");
+    fprintf(stderr, "\t-a <name>  Allocator to run(default mm); several, comma separated,\n"
+            "\t           or all, to compare their util and Kops per trace:\n");
+    print_backends(stderr);
+    fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots; 3 all blocks every op.\n");
+    fprintf(stderr, "\t-D         Equivalent to -d2; -D -D to -d3.\n");
     fprintf(stderr, "\t-c <file>  Run trace file <file> once, check for correctness only.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L         Print p50/p99/p99.9/max latency of each op type.\n");
+    fprintf(stderr, "\t-P         Print cycles, instructions, cache/TLB/branch misses per op.\n");
+    fprintf(stderr, "\t-S         Stream traces from disk: no checks, one timed run each.\n");
+    fprintf(stderr, "\t-U <file>  Write a utilization/fragmentation timeline (CSV, or JSON if *.json).\n");
     fprintf(stderr, "\t-V         Print diagnostics as each trace is run.\n");
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-T <n>     Throughput with 1..n threads (mdriver-mt only).\n");
+    fprintf(stderr, "\t--json <f> Write the results with build id and timing spread as JSON (- for stdout).\n");
+    fprintf(stderr, "\t--csv <f>  Same, as CSV.\n");
+    fprintf(stderr, "\t--compare  Flag significant (Welch t-test, 95%%) slowdowns and util drops between two result files.\n");
+    fprintf(stderr, "\t--heapmap <p>  Write mm_dump_heapmap maps to <p><trace>.<op>.hmap (see mmheapmap).\n");
+    fprintf(stderr, "\t--heapmap-at <l>  Ops to write them before, e.g. 1000,5000,end (default end).\n");
+    fprintf(stderr, "\t--guard <n>   Put about 1 allocation per n bytes on guarded pages(mm_guard_start).\n");
+    fprintf(stderr, "\t--prof <f>    Write a pprof heap profile of all replays to <f>(mm_prof_start).\n");
+    fprintf(stderr, "\t--prof-rate <n>  Sample about one allocation per n bytes (default 512K).\n");
+    fprintf(stderr, "\t-X         With -T, shard ids across threads; frees cross threads.\n");
+    fprintf(stderr, "\t--fork <i> With -T, fork before op i of thread 0; the child replays the trace.\n");
+    fprintf(stderr, "\t--numa-spread  With -T, thread t allocates from NUMA node t %% nodes.\n");
+    fprintf(stderr, "\t--cpu-cache <n>  With -T, cache up to n bytes of small blocks per CPU.\n");
 }
@@ -20,6 +20,7 @@
 static char *heap;
 static char *mem_brk;
 static char *mem_max_addr;
+static char *mem_fresh;	/* nothing at or above this was ever handed out */
 
 /* 
  * mem_init - initialize the memory system model
@@ -34,6 +35,7 @@ void mem_init(void){
 			0);						/* offset (dunno) */
 	mem_max_addr = heap + MAX_HEAP;
 	mem_brk = heap;					/* heap is empty initially */
+	mem_fresh = heap;
 }
 
 /* 
@@ -67,6 +69,8 @@ void *mem_sbrk(int incr) {
 	}
 
 	mem_brk += incr;
+	if (mem_brk > mem_fresh)
+		mem_fresh = mem_brk;
 	return (void *)old_brk;
 }
 
@@ -84,6 +88,16 @@ void *mem_heap_hi(){
 	return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_fresh_lo - return the lowest address that mem_sbrk has never handed
+ *		out since mem_init. The heap is mapped from /dev/zero and
+ *		mem_reset_brk does not lower this, so everything from here up
+ *		to the end of the mapping still reads as zero.
+ */
+void *mem_fresh_lo(){
+	return (void *)mem_fresh;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
@@ -1,11 +1,19 @@
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_fresh_lo(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
+#ifdef __cplusplus
+}
+#endif
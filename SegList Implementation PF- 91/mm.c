@@ -105,12 +105,118 @@
             Reason for CHUNKSIZE being (1<<8) bytes: If higher, it means that
             the utilization decreases. If less, it means that the kernel has
             to be asked for memory all the time, which reduces throughput.
+   --Regions(mm_region_*):
+        A region takes big chunks from the seg list heap with malloc and
+        bump-allocates inside them, so the objects have no header/footer.
+        The first 8 bytes of every chunk link to the previously taken chunk
+        and the region record itself lives in the first chunk. Destroying a
+        region frees the chunks one by one(they are coalesced back into the
+        seg lists), so the cost is O(number of chunks), not O(objects).
+   --Pools(mm_pool_*):
+        A pool hands out objects of one fixed size. Its slabs come from
+        malloc and are cut into objects; free objects are threaded into a
+        singly linked list through their first 8 bytes, so get and put are
+        a pop and a push. Like regions, the first 8 bytes of a slab link
+        to the previous slab so that destroy can free them all.
+   --Heap profiling(mm_prof_*):
+        Every thread counts down the bytes it allocates; only when the
+        count runs out does an allocation leave the fast path, to draw
+        the next exponentially distributed gap and capture its stack
+        with backtrace(). The sampled block gets bit 1 of its header and
+        footer set and a record in a hash table keyed by its address, so
+        free only looks further for blocks with that bit. Stacks and
+        records are kept in mmap'd tables outside the heap.
+   --Guard pages(mm_guard_*):
+        GWP-ASan style: about one allocation per guard_rate bytes gets
+        a page of its own out of a fixed mmap'd pool where every other
+        page is PROT_NONE, its payload ending right at the next guard
+        page. On free the page is protected and dropped(MADV_DONTNEED),
+        and the slot goes to the back of a FIFO quarantine, to be reused
+        as late as possible. A SIGSEGV inside the pool is reported with
+        the stacks of the malloc and free of the nearest slot. The
+        profiler's byte countdown also counts down to the next guarded
+        block, so unsampled mallocs pay one decrement for both; free
+        tests whether the pointer lies in the pool, one compare.
+   --Heap maps(mm_dump_heapmap):
+        A snapshot of every block(offset, size, free, seg list) and one
+        byte per page: resident or not(mincore), and whether the page is
+        wholly inside the unused middle of a free block. Those pages are
+        the ones a purge could hand back; nothing purges them yet. The
+        dump is written under the heap lock through stack buffers, so it
+        can run at any point of a trace without perturbing the heap.
+   --NUMA(mm_numa_*):
+        With more than one node, the heap starts with a set of seg list
+        heads per node, and a byte per heap page(kept outside the heap)
+        says which node the page is bound to. Every extension ends on a
+        page boundary, goes to the extending thread's node and is bound
+        there with mbind. A block is on the node of its payload's first
+        page; blocks of two nodes are never coalesced, so none straddles
+        nodes. malloc searches its thread's node's lists, then extends,
+        and takes another node's block only when the heap is exhausted.
+        free puts a block back on its own node's lists, whichever thread
+        frees it. A thread's node is its CPU's(looked at again every
+        NUMARECHECK calls) or the one mm_numa_set_node gave it. On one
+        node there is one set of lists and the layout is as before. Only
+        the MM_THREADSAFE build looks for nodes: without it the heap has
+        one thread and one node, and numa_nnodes is the constant 1, so
+        the node lookups in malloc, free and coalesce compile away.
+   --Caches(mm_cpucache_*):
+        Once started, malloc of up to MM_CACHEMAXSIZE bytes and free of
+        a block that small first try a cache: for each of the
+        CACHECLASSES block sizes, a stack of up to cache_cap blocks that
+        stay allocated as far as the heap is concerned. Every CPU has
+        one, pushed and popped in rseq critical sections(rseq_pop and
+        rseq_push: read the CPU's count, move the pointer, store the new
+        count last; the kernel sends a thread that is preempted or
+        moved before that store to the abort handler, which starts it
+        over), so the fast path takes no lock and no atomic instruction
+        and the caches cost a table per CPU however many threads run.
+        Without rseq every thread gets a table instead, handed on to a
+        new thread when its own exits. A malloc that finds its stack
+        empty takes half a stack's worth under the lock; a free that
+        finds it full gives half of it back with the block.
+   --Threads:
+        Built with -DMM_THREADSAFE, one heap lock is held for the whole of
+        every public malloc/free/realloc/calloc/memalign call. The public
+        functions only take the lock and call their do_* counterparts,
+        which assume it is held, so that realloc can call do_malloc and
+        do_free. Regions and pools are not shared: each one must be used
+        by one thread at a time(their chunks still come from the locked
+        heap).
+   --Fork:
+        The thread-safe build registers pthread_atfork handlers at the
+        first mm_init. Before a fork the forking thread takes the heap
+        lock, so no other thread is half way through changing the heap
+        when it is copied; the parent then drops the lock and the child,
+        where the thread that held it may not exist, makes a fresh one.
+        All heap state is behind that one lock, so the child handler
+        only touches the lock, its own thread's sampling state and the
+        thread caches: those of threads the child does not have are
+        handed on, blocks and all, to its next new threads. A CPU cache
+        copied half way through a push or pop is whole, as neither
+        takes effect before its last store. No heap page is written, and
+        the child shares them all with the parent until one of them
+        changes a block.
  */
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <pthread.h>
+#include <signal.h>
+#ifdef __x86_64__
+#include <linux/rseq.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
@@ -124,6 +230,7 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define memalign mm_memalign
 #endif /* def DRIVER */
 
 
@@ -137,9 +244,41 @@
 #define MINSEGLISTSIZE 32     /* For seg list, this is the min block size*/
 #define SEGLISTS 27         /* This contains the number of segmented lists
 * ranging from 2^4 to 2^32 with increments by power of 2*/
-
+#define REGIONCHUNKSIZE (1<<12) /* Default bytes taken per region chunk */
+#define POOLSLABSIZE (1<<12)    /* Bytes taken per pool slab... */
+#define POOLSLABOBJS 8          /* ...but at least room for these many objs */
+#ifndef MM_BUILD_ID
+#define MM_BUILD_ID "unknown"   /* set by the Makefile */
+#endif
+#if SEGLISTS + 1 != MM_SIZECLASSES
+#error "MM_SIZECLASSES in mm.h must match the number of seg lists"
+#endif
+
+
+#define CHECKLOGSIZE 64         /* Blocks mm_check remembers between calls */
+#define CHECKMAXTHREADS 64      /* Most threads a full check uses */
+#define PROFMAXDEPTH 32         /* Most frames kept per sampled stack */
+#define SAMPLERECHECK (1<<26)   /* Bytes between looks at whether the
+                                   profiler or guard sampling was
+                                   started, per thread */
+#define GUARDMAXDEPTH 16        /* Frames kept per guarded malloc/free */
+#define GUARDSLACK 0xab         /* Fills a guarded page past the payload */
+#define NUMAMAXNODES 64         /* Most NUMA nodes(one word of mbind mask) */
+#define NUMAMAXCPUS 4096        /* Most CPUs mapped to their nodes */
+#define NUMARECHECK 1024        /* Calls between looks at a thread's CPU */
+#define NUMAMAPPAGES (1UL<<24)  /* Heap pages the node map can cover */
+#define NUMA_MPOL_PREFERRED 1   /* MPOL_PREFERRED of <numaif.h> */
+#define CACHECLASSES 31         /* Block sizes a cache holds: 24, 32..264 */
+#define CACHESLOTS 64           /* Most blocks of one size in a cache */
+#define CACHESLOTSHIFT 6        /* log2 of CACHESLOTS */
+#define CACHEMAXBLOCK (MINBLOCKSIZE + (CACHECLASSES-1)*DSIZE)
+#define RSEQSIG 0x53053053      /* Signature before an rseq abort handler */
+#if CACHEMAXBLOCK != MM_CACHEMAXSIZE + DSIZE
+#error "MM_CACHEMAXSIZE in mm.h must match the largest cached block"
+#endif
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
 
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc)  ((size) | (alloc))
@@ -158,6 +297,9 @@
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p)  (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+/* Bit 1 of an allocated block's header and footer: the profiler has a
+   record of it(see prof_record) */
+#define SAMPLED 0x2
 
 /* Given block ptr bp, compute where its next and previous free ptrs are*/
 #define NXTFP(bp)       ((char **)(bp))
@@ -182,6 +324,17 @@
 /* rounds up to the nearest multiple of ALIGNMENT */
 #define ALIGN(p) (((size_t)(p) + (ALIGNMENT-1)) & ~0x7)
 
+/* Take and drop the heap lock(no-ops unless built with MM_THREADSAFE) */
+#ifdef MM_THREADSAFE
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+#define LOCK_HEAP()    pthread_mutex_lock(&heap_lock)
+#define UNLOCK_HEAP()  pthread_mutex_unlock(&heap_lock)
+#else
+#define LOCK_HEAP()
+#define UNLOCK_HEAP()
+#endif
+
 
 /* Global variables */
 static char *heap_listp = 0;  /* Pointer to first block */
@@ -190,17 +343,208 @@ static char *segListHeadPtr = 0;
 /* segListHeadPtr-Pointer to the set of seglists' starting address */
 static char *epilogueAddress = 0;
 /* epilogueAddress-Pointer to the set of seglists' starting address */
+static struct mm_stats stats;
+/* stats-Counters of mm_stats; class_free is only filled in on request */
+static char *check_log[CHECKLOGSIZE];
+static int check_nlog = 0;
+static int check_logging = 0;
+/* check_log-Blocks changed since the last mm_check, once check_logging
+   is set by an incremental check; check_nlog > CHECKLOGSIZE means that
+   too many were changed and the next check has to be a full one */
+
+/* Note a block for the next incremental mm_check */
+#define CHECK_TOUCH(bp) \
+    do { if (check_logging) check_touch(bp); } while (0)
+
+/*
+ * Heap profiler state. Each thread counts down the bytes it allocates;
+ * only when its countdown goes below zero does it look at the rest.
+ * The tables live in their own mmap'd memory, never in the heap.
+ */
+typedef struct
+{
+    uint64_t inuse_count;   /* sampled blocks of this stack still live... */
+    uint64_t inuse_bytes;   /* ...and their requested bytes */
+    uint64_t alloc_count;   /* every block sampled at this stack... */
+    uint64_t alloc_bytes;   /* ...and its requested bytes */
+    uint64_t hash;
+    int depth;
+    void *pc[PROFMAXDEPTH];
+} prof_stack_t;
+
+typedef struct
+{
+    char *bp;               /* sampled block, NULL if the slot is empty */
+    uint32_t stack;         /* index in prof_stacks */
+    uint64_t size;          /* bytes asked for */
+} prof_block_t;
+
+static size_t prof_period = 0;    /* mean bytes between samples, 0: off;
+                                     read by sample_take without the lock */
+static prof_stack_t *prof_stacks; /* every stack seen so far... */
+static size_t prof_nstacks, prof_maxstacks;
+static int32_t *prof_stackidx;    /* ...hashed into this(-1: empty) */
+static size_t prof_stackmask;
+static prof_block_t *prof_blocks; /* live sampled blocks by address */
+static size_t prof_blockmask, prof_nblocks;
+static __thread int64_t sample_countdown; /* bytes left to the next look */
+static __thread int64_t sample_armed;   /* ...what it was set to then */
+static __thread int64_t prof_left;      /* bytes to the next profiler... */
+static __thread int64_t guard_left;     /* ...and guard sample, as of then */
+static __thread uint64_t sample_rng;    /* this thread's random state */
+static __thread int prof_busy;          /* in backtrace(), don't sample */
+
+/*
+ * Guard page state. Slot i is the page at guard_lo + (2i+1)*pagesize;
+ * the pages around it stay PROT_NONE. The pool and the slot table are
+ * mmap'd once by the first mm_guard_start and never given back, so a
+ * pointer into the pool always stays valid to test and report on.
+ */
+enum { GUARD_UNUSED, GUARD_LIVE, GUARD_FREED };
+typedef struct
+{
+    char *ptr;              /* payload */
+    size_t size;            /* bytes asked for */
+    int state;
+    int alloc_depth, free_depth;
+    pid_t alloc_tid, free_tid;
+    void *alloc_pc[GUARDMAXDEPTH];
+    void *free_pc[GUARDMAXDEPTH];
+} guard_slot_t;
+
+static size_t guard_rate = 0;     /* mean bytes between samples, 0: off;
+                                     read by sample_take without the lock */
+static char *guard_lo;            /* the pool, NULL until started... */
+static size_t guard_bytes;        /* ...and its length */
+static size_t guard_pagesize;
+static guard_slot_t *guard_slots;
+static size_t guard_nslots;
+static size_t guard_nfresh;       /* slots[nfresh..] were never used */
+static size_t *guard_quarantine;  /* FIFO of freed slots... */
+static size_t guard_qhead, guard_qlen;  /* ...oldest first */
+static struct sigaction guard_oldsegv;  /* SIGSEGV handler before ours */
+
+/*
+ * NUMA state, set up once by the first mm_init. numa_map has a byte
+ * for each heap page: the node(index into numa_ids) it belongs to.
+ */
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+#ifdef MM_THREADSAFE
+static int numa_nnodes = 1;       /* 1: no NUMA, nothing else is used */
+#else
+static const int numa_nnodes = 1; /* one thread: no NUMA, ever */
+#endif
+static int numa_fake;             /* topology from MM_NUMA_FAKE: no mbind */
+static int numa_ids[NUMAMAXNODES];          /* kernel's number of node i */
+static signed char numa_cpu_node[NUMAMAXCPUS]; /* node of a CPU, -1: ? */
+static unsigned char *numa_map;
+static uintptr_t numa_base;       /* first heap page number */
+static int numa_pageshift;
+static __thread int numa_node;          /* this thread's node... */
+static __thread int numa_pinned;        /* ...set by mm_numa_set_node... */
+static __thread int numa_countdown;     /* ...or calls to the next look */
+
+/* Seg lists in all, and the first head of node n's */
+#define NLISTS         ((SEGLISTS+1) * numa_nnodes)
+#define NODE_HEADS(n)  (segListHeadPtr + (n)*(SEGLISTS+1)*DSIZE)
+/* The node of block bp, and of the calling thread */
+#define NODE_OF(bp)    (numa_nnodes == 1 ? 0 : \
+    numa_map[((uintptr_t)(bp) >> numa_pageshift) - numa_base])
+#define NUMA_NODE()    (numa_nnodes == 1 ? 0 : numa_current())
+/* May blocks a and b be coalesced? */
+#define SAME_NODE(a, b) (numa_nnodes == 1 || NODE_OF(a) == NODE_OF(b))
+
+/*
+ * Small-block caches(see Caches). A CPU's cache is at cache_cpus +
+ * cpu*cache_stride and only changed in rseq critical sections; thread
+ * caches are on the cache_threads list, owned by one thread at a time.
+ */
+typedef struct cache
+{
+    uint32_t count[CACHECLASSES+1]; /* blocks in slot[c]; the rseq code
+                                       finds them at offset 0 */
+    uint64_t nmalloc;               /* mallocs served... */
+    uint64_t nfree;                 /* ...and frees kept */
+    struct cache *next;             /* next thread cache */
+    int owned;                      /* a thread uses this thread cache */
+    void *slot[CACHECLASSES][CACHESLOTS];
+} cache_t;
+
+enum { CACHE_UNSET, CACHE_CPU, CACHE_THREAD, CACHE_NONE };
+
+static size_t cache_bytes = 0;    /* bytes of blocks per cache, 0: off */
+static uint32_t cache_cap[CACHECLASSES];  /* most blocks of each size */
+static char *cache_cpus;          /* CPU caches(NULL if none)... */
+static size_t cache_stride;       /* ...this far apart... */
+static uint32_t cache_ncpus;      /* ...and this many */
+static cache_t *cache_threads;    /* every thread cache */
+static int cache_keyed;           /* cache_key was created */
+static pthread_key_t cache_key;   /* runs cache_thread_exit */
+static __thread int cache_mode;   /* which cache this thread uses... */
+static __thread cache_t *cache_mine;      /* ...its thread cache... */
+#ifdef __x86_64__
+static __thread struct rseq *cache_rseq;  /* ...or its rseq area */
+static __thread struct rseq rseq_own;     /* ours, if libc has none */
+extern const ptrdiff_t __rseq_offset __attribute__((weak));
+extern const unsigned int __rseq_size __attribute__((weak));
+#endif
+
+/* Do malloc(size) and free(bp) go through the caches? */
+#define CACHE_TAKES(size) (cache_bytes != 0 && (size) - 1 < MM_CACHEMAXSIZE)
+#define CACHE_KEEPS(bp)   (cache_bytes != 0 && \
+    GET_SIZE(HDRP(bp)) <= CACHEMAXBLOCK && !(GET(HDRP(bp)) & SAMPLED))
+#define CACHE_CLASS(asize) (((asize) - MINBLOCKSIZE) / DSIZE)
+/* Bump a counter of the cache in use without a locked instruction; of
+   two bumps on one CPU at once, one may be lost */
+#define CACHE_COUNT(field) \
+    do { cache_t *tc_ = cache_here(); if (tc_ != NULL) \
+        __atomic_store_n(&tc_->field, __atomic_load_n(&tc_->field, \
+                         __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED); } while (0)
+
+/* Is ptr in the guard pool? Free and realloc ask this first */
+#define GUARD_OWNS(ptr) \
+    ((uintptr_t)(ptr) - (uintptr_t)guard_lo < guard_bytes)
+/* Count size off this thread's sampling countdown; only when it runs
+   out does sample_take look at the profiler and guard sampling. Gives a
+   guarded block or NULL, and sets depth if the stack was captured */
+#define SAMPLE(size, align, pc, depth) \
+    (((sample_countdown -= (size)) < 0 && sample_take(pc, &(depth))) ? \
+     guard_alloc(size, align) : NULL)
+
+/* Bookkeeping for a region; stored inside the region's first chunk */
+struct mm_region
+{
+    char *chunks;       /* Most recently taken chunk(head of chunk chain) */
+    char *cur;          /* Next free byte in the current chunk */
+    char *end;          /* End of the current chunk's payload */
+    size_t chunksize;   /* Bytes asked for every regular chunk */
+};
+
+/* Bookkeeping for a fixed-size object pool */
+struct mm_pool
+{
+    char *freelist;     /* First free object(NULL if none are left) */
+    char *slabs;        /* Most recently taken slab(head of slab chain) */
+    size_t objsize;     /* Distance between objects in a slab */
+    size_t align;       /* Alignment of every object */
+    size_t slabsize;    /* Bytes asked for every slab */
+};
 
 
 /* Function prototypes for internal helper routines */
-static void *extend_heap(size_t words);
+static void *do_malloc(size_t size);
+static void do_free(void *bp);
+static void *do_realloc(void *ptr, size_t size);
+static void *do_memalign(size_t alignment, size_t size);
+/* do_* do the work of the public functions; the heap lock must be held */
+static void *extend_heap(size_t words, int node);
 static void place(void *bp, size_t asize);
-static void *find_fit(size_t asize);
+static void *find_fit(size_t asize, int node);
+static void search_done(uint64_t steps);
+/* search_done records the length of one fit search */
 static void *coalesce(void *bp);
 static int find_seg_list(size_t asize);
 /* find_seg_list gives the seg list number for a specific size */
-static int find_max_range(int blockNum);
-/* find_max_range gives the max limit for a seg lists' block number */
 static char *find_seg_list_address(void *bp);
 /* This gives the seg list address for a specific size */
 static void remove_from_seg_list(void *bp);
@@ -211,19 +555,114 @@ static int isLastBlockFree();
 /* isLastBlockFree tells if the last block is free or not*/
 static int sizeOfLastFreeBlock();
 /* sizeOfLastFreeBlock tells the size of the last block if free */
+static size_t adjust_size(size_t size);
+/* adjust_size gives the block size malloc uses for a request */
+static int pool_grow(mm_pool_t *pool);
+/* pool_grow cuts a new slab into free objects for a pool */
+static int sample_take(void **pc, int *depth);
+/* sample_take profiles or guards an allocation when the countdown ran out */
+static void prof_record(void *bp, size_t size, void **pc, int depth);
+/* prof_record keeps a sampled block in the profiler's tables */
+static void prof_keep(void *bp, size_t size, int stack, int fresh);
+/* prof_keep puts a block in the profiler's tables under a stack */
+static int prof_stack_of(void *bp);
+/* prof_stack_of finds the stack a sampled block was recorded under */
+static void prof_drop(void *bp);
+/* prof_drop forgets a sampled block that is being freed */
+static void prof_reset_blocks(void);
+/* prof_reset_blocks forgets every block when the heap starts over */
+static void *prof_mmap(size_t bytes);
+/* prof_mmap gets zeroed memory for the profiler's tables */
+static uint64_t sample_rand(void);
+/* sample_rand draws from this thread's random numbers */
+static void *guard_alloc(size_t size, size_t align);
+/* guard_alloc puts a block in a free guard slot */
+static void guard_free(void *ptr);
+/* guard_free protects a guarded block's slot and quarantines it */
+static void *guard_realloc(void *ptr, size_t size, void *newptr);
+/* guard_realloc is realloc when a guarded block is involved */
+static void guard_reset(void);
+/* guard_reset empties every slot when the heap starts over */
+static void guard_segv(int sig, siginfo_t *info, void *uctx);
+/* guard_segv reports faults in the guard pool */
+static int write_all(int fd, const void *buf, size_t len);
+static void numa_setup(void);
+/* numa_setup finds the nodes and their CPUs, once */
+static int numa_parse_cpus(const char *list, int node);
+/* numa_parse_cpus maps the CPUs of a cpulist to a node */
+static int numa_current(void);
+/* numa_current gives the calling thread's node */
+static void numa_give(char *lo, char *hi, int node);
+/* numa_give makes the heap pages of [lo, hi) node's */
+static void *cache_malloc(size_t size);
+/* cache_malloc is malloc through this thread's cache */
+static void cache_free(void *bp);
+/* cache_free is free through this thread's cache */
+static void *cache_pop(int c);
+/* cache_pop takes a block of class c from this thread's cache */
+static int cache_push(int c, void *bp);
+/* cache_push puts a block in this thread's cache if there is room */
+static cache_t *cache_here(void);
+/* cache_here gives the cache this thread uses just now */
+static void cache_setup(void);
+/* cache_setup picks a thread's cache at its first cached call */
+static void cache_thread_exit(void *arg);
+/* cache_thread_exit gives back an exiting thread's cache */
+static cache_t *cache_walk(cache_t *tc);
+/* cache_walk goes through every CPU and thread cache */
+static void cache_empty(cache_t *tc);
+/* cache_empty frees the blocks of one cache */
+static void cache_reset(void);
+/* cache_reset forgets every cached block when the heap starts over */
+static void cache_totals(int reset);
+/* cache_totals adds the caches' counters up into stats */
+#ifdef __x86_64__
+static void cache_cpus_setup(void);
+/* cache_cpus_setup maps the CPU caches if there is rseq */
+static struct rseq *rseq_area(void);
+/* rseq_area finds(or registers) the calling thread's rseq area */
+static void *rseq_pop(int c);
+/* rseq_pop takes a block of class c from this CPU's cache */
+static int rseq_push(int c, void *bp);
+/* rseq_push puts a block in this CPU's cache if there is room */
+#endif
+#ifdef MM_THREADSAFE
+static void fork_register(void);
+/* fork_register installs the pthread_atfork handlers, once */
+static void fork_prepare(void);
+static void fork_parent(void);
+static void fork_child(void);
+/* fork_* hold the heap lock across fork and renew it in the child */
+#endif
 
 
 
 void mm_checkheap(int verbose);
 /* The following functions are helper functions for checkheap */
 static void printblock(void *bp);
-static void header_footer_chk(void *bp);
-/* Checks if the header and footer of all the blocks are consistent or not*/
-static void seg_list_freeness_consistency(void *bp);
-/* Checks if all the blocks in a particular segmented list are free or not*/
-static void seg_list_size_consistency(void *bp,int blockNum);
-/* Checks if blocks in segmented list follow the size constraint*/
 static void print_seg_list();
+static int check_fail(mm_check_error_t *err, int code, void *bp, int blockNum);
+/* check_fail records the first problem a check finds */
+static int check_in_heap(const char *bp);
+/* check_in_heap tells if a free list link can point at a block */
+static int check_block(char *bp, mm_check_error_t *err);
+/* Checks one block, and its place in its seg list if it is free */
+static int check_list(int blockNum, size_t *count, mm_check_error_t *err);
+/* Checks one seg list: no loops, only free blocks of its size range */
+static int check_full(int nthreads, mm_check_error_t *err);
+/* Checks every block and seg list, the heap walk split over threads */
+static int check_incremental(mm_check_error_t *err);
+/* Checks the blocks changed since the last mm_check */
+static void check_touch(void *bp);
+/* check_touch notes a block for the next incremental check... */
+static void check_untouch(void *bp);
+/* ...and check_untouch forgets one that was merged away */
+static void *check_part(void *arg);
+/* check_part is one thread of a full check */
+static uint64_t class_free_bytes(int blockNum);
+/* class_free_bytes adds up the free blocks of one seg list */
+static void heap_totals(void);
+/* heap_totals works out heap_bytes and live_bytes */
 
 /*
  * mm_init - Initialize the memory manager
@@ -235,24 +674,37 @@ static void print_seg_list();
 int mm_init(void)
 {
     int i;
+#ifdef MM_THREADSAFE
+    pthread_once(&fork_once, fork_register);
+#endif
+    pthread_once(&numa_once, numa_setup);
     heap_listp = 0;
     heap_freelistp = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.numa_nodes = numa_nnodes;
+    prof_reset_blocks();
+    guard_reset();
+    cache_reset();
+    check_nlog = CHECKLOGSIZE + 1;
 
     // The initial heap is set-up to hold all the seglist' pointers
-    if ((heap_listp = mem_sbrk(4*WSIZE+((1+SEGLISTS)*DSIZE))) == (void *)-1)
+    if ((heap_listp = mem_sbrk(4*WSIZE+(NLISTS*DSIZE))) == (void *)-1)
         return -1;
 
     segListHeadPtr=heap_listp;
+    numa_base = (uintptr_t)segListHeadPtr >> numa_pageshift;
 
-    /* The following sets up the initial empty heap with all seglist ptrs*/
-    for(i=0; i<=SEGLISTS; i++)
+    /* The following sets up the initial empty heap with all seglist ptrs
+     * (one set of them per NUMA node)
+     */
+    for(i=0; i<NLISTS; i++)
     {
         /*Position 0 corresponds to sizes from 0 to 2^5 with 2^5 included
          *Similarly, position i corresponds to 2^(4+i) to 2^(4+i+1)
          */
         PUT2W(segListHeadPtr + (i*DSIZE), 0);
     }
-    heap_listp=heap_listp+ ((1+SEGLISTS)*DSIZE);
+    heap_listp=heap_listp+ (NLISTS*DSIZE);
     PUT(heap_listp, 0);                          /* Alignment padding */
     PUT(heap_listp+ (1*WSIZE), PACK(DSIZE, 1)); /* Prologue header */
     PUT(heap_listp + (2*WSIZE), PACK(DSIZE, 1)); /* Prologue footer */
@@ -263,7 +715,7 @@ int mm_init(void)
     heap_listp=heap_listp+(2*WSIZE) ;
 
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
-    if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
+    if (extend_heap(CHUNKSIZE/WSIZE, NUMA_NODE()) == NULL)
         return -1;
 
     return 0;
@@ -275,14 +727,37 @@ int mm_init(void)
 /*
  * mm_malloc - Allocate a block with at least size bytes of payload.
  * Returns the address of the block of specified size.
- * Reference: Most part taken from CSAPP textbook implementation
  */
 void *mm_malloc(size_t size)
+{
+    void *bp;
+    void *pc[PROFMAXDEPTH];
+    int depth = 0;
+
+    if ((bp = SAMPLE(size, ALIGNMENT, pc, depth)) != NULL)
+        return bp;
+    if (CACHE_TAKES(size) && depth == 0)
+        return cache_malloc(size);
+    LOCK_HEAP();
+    stats.nmalloc++;
+    bp = do_malloc(size);
+    if (depth > 0 && bp != NULL)
+        prof_record(bp, size, pc, depth);
+    UNLOCK_HEAP();
+    return bp;
+}
+
+/*
+ * do_malloc - mm_malloc with the heap lock held
+ * Reference: Most part taken from CSAPP textbook implementation
+ */
+static void *do_malloc(size_t size)
 {
     size_t asize;      /* Adjusted block size */
     size_t extendsize; /* Amount to extend heap if no fit */
     void *bp;
     int sizeOfLastBlock;
+    int node, n;
 
     if (heap_listp == 0)
     {
@@ -293,13 +768,10 @@ void *mm_malloc(size_t size)
     if (size == 0)
         return NULL;
 
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= (2*DSIZE))
-        asize = 3*DSIZE;
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+    asize = adjust_size(size);
+    node = NUMA_NODE();
     /* Search the free list for a fit */
-    if ((bp = find_fit(asize)) != NULL)
+    if ((bp = find_fit(asize, node)) != NULL)
     {
 
         place(bp, asize);
@@ -310,8 +782,10 @@ void *mm_malloc(size_t size)
      *Rationale: To not extend un-neccessarily
      *The last block is checked if free or not
      *If last block is free, then only get the rest that is needed
+     *(if it is this thread's node's; blocks of two nodes do not merge)
      */
-    if(isLastBlockFree())
+    if(isLastBlockFree() &&
+       NODE_OF(epilogueAddress + WSIZE - sizeOfLastFreeBlock()) == node)
     {
         sizeOfLastBlock=sizeOfLastFreeBlock();
         extendsize=asize-sizeOfLastBlock;
@@ -325,8 +799,16 @@ void *mm_malloc(size_t size)
 
 
     /* No fit found. Get more memory and place the block */
-    if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
-        return NULL;
+    if ((bp = extend_heap(extendsize/WSIZE, node)) == NULL)
+    {
+        /* Out of heap: the other nodes' memory is better than none */
+        for (n = 0; n < numa_nnodes && bp == NULL; n++)
+            if (n != node)
+                bp = find_fit(asize, n);
+        if (bp == NULL)
+            return NULL;
+        stats.remote_fits++;
+    }
 
     place(bp, asize);
     return bp;
@@ -336,10 +818,32 @@ void *mm_malloc(size_t size)
 /*
  * mm_free - Free a block
  * Returns nothing.
+ */
+void mm_free(void *bp)
+{
+    if (GUARD_OWNS(bp))
+    {
+        guard_free(bp);
+        return;
+    }
+    if (bp != 0 && CACHE_KEEPS(bp))
+    {
+        cache_free(bp);
+        return;
+    }
+    LOCK_HEAP();
+    if (bp != 0)
+        stats.nfree++;
+    do_free(bp);
+    UNLOCK_HEAP();
+}
+
+/*
+ * do_free - mm_free with the heap lock held
  * Calls coalesce in the process too.
  * Reference: Taken from CSAPP textbook implementation
  */
-void mm_free(void *bp)
+static void do_free(void *bp)
 {
     if (bp == 0)
         return;
@@ -349,6 +853,10 @@ void mm_free(void *bp)
     {
         mm_init();
     }
+    if (GET(HDRP(bp)) & SAMPLED)
+        prof_drop(bp);
+    if (NODE_OF(bp) != NUMA_NODE())
+        stats.remote_frees++;
 
     PUT(HDRP(bp), PACK(size, 0));
     PUT(FTRP(bp), PACK(size, 0));
@@ -366,13 +874,28 @@ void mm_free(void *bp)
 static void *coalesce(void *bp)
 {
     //Coalesce also ensures that free block gets into the correct free list
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    //A neighbour on another NUMA node counts as allocated
+    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))) ||
+                        !SAME_NODE(PREV_BLKP(bp), bp);
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))) ||
+                        !SAME_NODE(NEXT_BLKP(bp), bp);
     size_t size = GET_SIZE(HDRP(bp));
 
+    if (!prev_alloc || !next_alloc)
+        stats.ncoalesce++;
+
+    if (check_logging)
+    {
+        if (!next_alloc)
+            check_untouch(NEXT_BLKP(bp));
+        if (!prev_alloc)
+            check_untouch(bp);
+    }
+
     if (prev_alloc && next_alloc)              /* Case 1 */
     {
         add_to_seg_list(bp);
+        CHECK_TOUCH(bp);
         return bp;
     }
 
@@ -383,6 +906,7 @@ static void *coalesce(void *bp)
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size,0));
         add_to_seg_list(bp);
+        CHECK_TOUCH(bp);
         return(bp);
     }
 
@@ -394,6 +918,7 @@ static void *coalesce(void *bp)
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size,0));
         add_to_seg_list(bp);
+        CHECK_TOUCH(bp);
         return(bp);
 
     }
@@ -408,6 +933,7 @@ static void *coalesce(void *bp)
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size,0));
         add_to_seg_list(bp);
+        CHECK_TOUCH(bp);
         return(bp);
 
     }
@@ -416,9 +942,34 @@ static void *coalesce(void *bp)
 
 /*
 * mm_realloc - Naive implementation of realloc
-* Reference: CSAPP 3e textbook
 */
 void *mm_realloc(void *ptr, size_t size)
+{
+    void *newptr = NULL;
+    void *pc[PROFMAXDEPTH];
+    int depth = 0, stack = -1;
+
+    if (GUARD_OWNS(ptr) || (newptr = SAMPLE(size, ALIGNMENT, pc, depth)) != NULL)
+        return guard_realloc(ptr, size, newptr);
+    LOCK_HEAP();
+    stats.nrealloc++;
+    /* A sampled block keeps its sample, at its new place and size */
+    if (depth == 0 && ptr != NULL && (GET(HDRP(ptr)) & SAMPLED))
+        stack = prof_stack_of(ptr);
+    newptr = do_realloc(ptr, size);
+    if (depth > 0 && newptr != NULL)
+        prof_record(newptr, size, pc, depth);
+    else if (stack >= 0 && newptr != NULL)
+        prof_keep(newptr, size, stack, 0);
+    UNLOCK_HEAP();
+    return newptr;
+}
+
+/*
+* do_realloc - mm_realloc with the heap lock held
+* Reference: CSAPP 3e textbook
+*/
+static void *do_realloc(void *ptr, size_t size)
 {
     size_t oldsize;
     void *newptr;
@@ -426,17 +977,25 @@ void *mm_realloc(void *ptr, size_t size)
     /* If size == 0 then this is just free, and we return NULL. */
     if(size == 0)
     {
-        mm_free(ptr);
+        do_free(ptr);
         return 0;
     }
 
     /* If oldptr is NULL, then this is just malloc. */
     if(ptr == NULL)
     {
-        return mm_malloc(size);
+        return do_malloc(size);
+    }
+
+    /* Keep the block if malloc would have handed out this very size */
+    oldsize = GET_SIZE(HDRP(ptr));
+    if(adjust_size(size) <= oldsize &&
+       (oldsize - adjust_size(size)) < MINBLOCKSIZE)
+    {
+        return ptr;
     }
 
-    newptr = mm_malloc(size);
+    newptr = do_malloc(size);
 
     /* If realloc() fails the original block is left untouched  */
     if(!newptr)
@@ -445,499 +1004,3039 @@ void *mm_realloc(void *ptr, size_t size)
     }
 
     /* Copy the old data. */
-    oldsize = GET_SIZE(HDRP(ptr));
+    oldsize = mm_malloc_usable_size(ptr);
     if(size < oldsize) oldsize = size;
     memcpy(newptr, ptr, oldsize);
 
     /* Free the old block. */
-    mm_free(ptr);
+    do_free(ptr);
 
     return newptr;
 }
 
 
 /*
- * extend_heap - Extend heap with free block and return its block pointer
+ * mm_malloc_usable_size - Number of payload bytes the block really has
+ * This is at least what was asked for; the rest is rounding plus any
+ * remainder that was too small to split off. All of it may be used.
+ * Returns 0 for NULL.
  */
-static void *extend_heap(size_t words)
+size_t mm_malloc_usable_size(void *ptr)
 {
-    void *bp;
-    size_t size;
-
-
-    /* Allocate an even number of words to maintain alignment */
-    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((long)(bp = mem_sbrk(size)) == -1)
-        return NULL;
-
-    /* Initialize free block header/footer,
-     * next Free, previous Free and the epilogue header */
-
-    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* Free block header */
+    if (ptr == NULL)
+        return 0;
+    if (GUARD_OWNS(ptr))
+        return guard_slots[((char *)ptr - guard_lo) / (2*guard_pagesize)].size;
+    return GET_SIZE(HDRP(ptr)) - DSIZE;
+}
 
-    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
-    epilogueAddress=HDRP(NEXT_BLKP(bp));
 
-    /* Coalesce if the previous block was free */
-    return coalesce(bp);
+/*
+ * mm_good_size - Payload size that a request of size bytes rounds up to
+ * Growing containers can ask for this much right away, since malloc(size)
+ * gives at least this many usable bytes anyway.
+ * Returns the rounded payload size.
+ */
+size_t mm_good_size(size_t size)
+{
+    return adjust_size(size) - DSIZE;
 }
 
 /*
- * calloc - you may want to look at mm-naive.c
- * This function is not tested by mdriver, but it is
- * needed to run the traces.
- *
- * Reference: mm-naive.c
+ * mm_build_id - Which mm.c this is, for benchmark reports
  */
-void *mm_calloc (size_t nmemb, size_t size)
+const char *mm_build_id(void)
 {
-    size_t bytes = nmemb * size;
-    void *newptr;
-
-    newptr = malloc(bytes);
-    memset(newptr, 0, bytes);
-
-    return newptr;
+#ifdef MM_THREADSAFE
+    return MM_BUILD_ID "-mt";
+#else
+    return MM_BUILD_ID;
+#endif
 }
 
-
 /*
- * mm_checkheap - Check the heap for correctness
- The following functions are helper functions for checkheap
-static void printblock(void *bp);
-static void header_footer_chk(void *bp);
-static void seg_list_freeness_consistency(void *bp);
-static void seg_list_size_consistency(void *bp,int blockNum);
-static void print_seg_list();
-
-    CheckHeap Description:
-   To check heap, the following avenues were made:
-   1. Printing the blocks:  Printing the blocks were by far, the most useful
-      debugging tool. It prints out all the blocks in the heap.
-   2. Check if header and footer of each block matches:
-            header_footer_chk(void *block) ensures that check
-   3. Check that, for a particular segregated list, it only contains the
-      free blocks of a certain size: seg_list_size_consistency ensures it
-   4. Check that, for a particular segregated list, it only contains the
-      free blocks: seg_list_freeness_consistency ensures that constraint.
-   5. Loop detected: Not done because manually looking into them by
-      printing them was better for me personally.
-
+ * mm_freeinfo - Sum up the free blocks of every seg list. Sizes are
+ *               whole block sizes, header and footer included.
  */
-void mm_checkheap(int verbose)
+void mm_freeinfo(mm_freeinfo_t *info)
 {
-    int blockNum;
-    int i=1*verbose;
-    verbose=i;
-    char *bp = heap_listp;
-
-    print_seg_list();
-    // This prints the segregated list pointers along with their locations.
+    int i;
+    char *bp;
+    size_t size;
 
-    for (blockNum=0; blockNum <= SEGLISTS; blockNum = blockNum+ 1)
+    memset(info, 0, sizeof(*info));
+    LOCK_HEAP();
+    info->heap_bytes = epilogueAddress + WSIZE - segListHeadPtr;
+    for (i = 0; i < NLISTS; i++)
     {
-        bp = (segListHeadPtr+(blockNum*8));
-        seg_list_freeness_consistency(bp);
-        seg_list_size_consistency(bp,blockNum);
+        for (bp = GET2W(segListHeadPtr + (i*DSIZE)); bp != NULL;
+             bp = GET2W(NXTFREE_BLKP(bp)))
+        {
+            size = GET_SIZE(HDRP(bp));
+            info->class_free[i % (SEGLISTS+1)] += size;
+            info->free_bytes += size;
+            info->free_blocks++;
+            if (size > info->largest_free)
+                info->largest_free = size;
+        }
     }
+    UNLOCK_HEAP();
+}
 
 
-    //Now print out the heap blocks
-    printf("Heap (%p):\n", heap_listp);
-
+/*
+ * mm_stats - Copy out the counters, with the free bytes of every class
+ */
+void mm_stats(struct mm_stats *st)
+{
+    int i;
 
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+    LOCK_HEAP();
+    heap_totals();
+    cache_totals(0);
+    *st = stats;
+    if (heap_listp != 0)
     {
-        printblock(bp);
-        header_footer_chk(bp);
-
+        for (i = 0; i <= SEGLISTS; i++)
+            st->class_free[i] = class_free_bytes(i);
     }
-
-    printblock(bp);
-    if ((GET_SIZE(HDRP(bp)) != 0) || !(GET_ALLOC(HDRP(bp))))
-        printf("Bad epilogue header\n");
+    UNLOCK_HEAP();
 }
 
+
 /*
- * The remaining routines are internal helper routines
+ * heap_totals - Bring heap_bytes and live_bytes up to date: whatever is
+ *               not free is allocated, except for the seg list heads,
+ *               the alignment padding, the prologue and the epilogue
  */
-
-/* printblock:
- *   Prints the description of a block-i.e. its header, footer,
- *   allocation information and if free, also its next pointer
- *   previous pointer.
- * Parameter: bp contains the address of a specific block to be printed
- * Returns nothing
-*/
-static void printblock(void *bp)
+static void heap_totals(void)
 {
-    size_t hsize, halloc, fsize, falloc;
+    if (heap_listp == 0)
+        return;
+    stats.heap_bytes = epilogueAddress + WSIZE - segListHeadPtr;
+    stats.live_bytes = stats.heap_bytes - stats.free_bytes
+                       - (NLISTS*DSIZE + 4*WSIZE);
+}
 
 
-    hsize = GET_SIZE(HDRP(bp));
-    halloc = GET_ALLOC(HDRP(bp));
-    fsize = GET_SIZE(FTRP(bp));
-    falloc = GET_ALLOC(FTRP(bp));
+/* Names mm_ctl knows under "stats.", and where they are in mm_stats */
+static const struct
+{
+    const char *name;
+    size_t offset;
+} ctl_stats[] =
+{
+    { "heap_bytes",    offsetof(struct mm_stats, heap_bytes) },
+    { "live_bytes",    offsetof(struct mm_stats, live_bytes) },
+    { "free_bytes",    offsetof(struct mm_stats, free_bytes) },
+    { "free_blocks",   offsetof(struct mm_stats, free_blocks) },
+    { "nmalloc",       offsetof(struct mm_stats, nmalloc) },
+    { "nfree",         offsetof(struct mm_stats, nfree) },
+    { "nrealloc",      offsetof(struct mm_stats, nrealloc) },
+    { "ncoalesce",     offsetof(struct mm_stats, ncoalesce) },
+    { "nsplit",        offsetof(struct mm_stats, nsplit) },
+    { "nextend",       offsetof(struct mm_stats, nextend) },
+    { "extend_bytes",  offsetof(struct mm_stats, extend_bytes) },
+    { "nsearch",       offsetof(struct mm_stats, nsearch) },
+    { "search_steps",  offsetof(struct mm_stats, search_steps) },
+    { "search_max",    offsetof(struct mm_stats, search_max) },
+    { "search_misses", offsetof(struct mm_stats, search_misses) },
+    { "numa_nodes",    offsetof(struct mm_stats, numa_nodes) },
+    { "remote_frees",  offsetof(struct mm_stats, remote_frees) },
+    { "remote_fits",   offsetof(struct mm_stats, remote_fits) },
+    { "cache_mallocs", offsetof(struct mm_stats, cache_mallocs) },
+    { "cache_frees",   offsetof(struct mm_stats, cache_frees) },
+    { "cache_bytes",   offsetof(struct mm_stats, cache_bytes) },
+    { "cache_tables",  offsetof(struct mm_stats, cache_tables) },
+};
 
-    if (hsize == 0)
+/*
+ * mm_ctl - Read or set one value by name(see mm.h)
+ * Only the value asked for is computed, so reading a single counter
+ * does not walk the seg lists.
+ */
+int mm_ctl(const char *name, void *oldp, size_t *oldlenp,
+           void *newp, size_t newlen)
+{
+    const char *id;
+    uint64_t value;
+    size_t i;
+    int blockNum;
+    int len = -1;
+
+    if (strcmp(name, "stats.reset") == 0)
     {
-        printf("%p: EOL\n", bp);
-        return;
+        if (newp == NULL)
+            return EPERM;   /* write-only */
+        (void)newlen;
+        LOCK_HEAP();
+        stats.nmalloc = stats.nfree = stats.nrealloc = 0;
+        stats.ncoalesce = stats.nsplit = 0;
+        stats.nextend = stats.extend_bytes = 0;
+        stats.nsearch = stats.search_steps = 0;
+        stats.search_max = stats.search_misses = 0;
+        stats.remote_frees = stats.remote_fits = 0;
+        cache_totals(1);
+        UNLOCK_HEAP();
+        return 0;
     }
+    if (newp != NULL)
+        return EPERM;       /* everything else is read-only */
 
-    printf("%p: header: [%ld:%c] footer: [%ld:%c]\n", bp,
-           hsize, (halloc ? 'a' : 'f'),
-           fsize, (falloc ? 'a' : 'f'));
-    if(halloc==0)
+    if (strcmp(name, "build_id") == 0)
     {
-        printf("%p: FreeNext: [%p] FreePrev: [%p]\n",
-                bp,GET2W(NXTFREE_BLKP(bp)), GET2W(PRVFREE_BLKP(bp)));
+        if (oldlenp == NULL || *oldlenp != sizeof(id))
+            return EINVAL;
+        id = mm_build_id();
+        if (oldp != NULL)
+            memcpy(oldp, &id, sizeof(id));
+        return 0;
     }
-}
 
+    if (strncmp(name, "stats.", 6) != 0)
+        return ENOENT;
+    name += 6;
 
-/* header_footer_chk:
- *   This checks if the header and footer
- *   of a block given as input is consistent
- * Parameter: bp contains the address of a specific block
- * Returns nothing
-*/
-static void header_footer_chk(void *bp)
-{
-    //Runs silently unless there is a mismatch between header and footer
-    size_t hsize, halloc, fsize, falloc;
-    hsize = GET_SIZE(HDRP(bp));
-    halloc = GET_ALLOC(HDRP(bp));
-    fsize = GET_SIZE(FTRP(bp));
-    falloc = GET_ALLOC(FTRP(bp));
-
-    if(hsize!=fsize ||(falloc!=halloc))
+    LOCK_HEAP();
+    sscanf(name, "class.%d.free_bytes%n", &blockNum, &len);
+    if (len > 0 && name[len] == '\0')
     {
-        printf("\n Inconsistent header and footer. Recheck block %p\n",bp);
+        if (blockNum < 0 || blockNum > SEGLISTS)
+        {
+            UNLOCK_HEAP();
+            return ENOENT;
+        }
+        value = (heap_listp != 0) ? class_free_bytes(blockNum) : 0;
     }
-}
-
-
-
-/* seg_list_freeness_consistency:
- *   This checks if all the blocks in a particular segmented list
- *   are free
- * Parameter: bp contains the address of a specific segmented list's
- *  first node address
- * Returns nothing
-*/
-static void seg_list_freeness_consistency(void *bp)
-{
-    size_t halloc;
-    //Check for freeness consistency within a specific seg list
-    for (; bp != NULL; bp = GET2W(NXTFREE_BLKP(bp)))
+    else
     {
-        halloc = GET_ALLOC(HDRP(bp));
-        if(halloc!=0)
+        for (i = 0; i < sizeof(ctl_stats)/sizeof(ctl_stats[0]); i++)
+            if (strcmp(name, ctl_stats[i].name) == 0)
+                break;
+        if (i == sizeof(ctl_stats)/sizeof(ctl_stats[0]))
         {
-            printf("\n Error: There is an allocated block ");
-            printf("in the segmented free list area-[%p]\n", bp);
+            UNLOCK_HEAP();
+            return ENOENT;
         }
-
+        heap_totals();
+        cache_totals(0);
+        value = *(uint64_t *)((char *)&stats + ctl_stats[i].offset);
     }
+    UNLOCK_HEAP();
+
+    if (oldlenp == NULL || *oldlenp != sizeof(value))
+        return EINVAL;
+    if (oldp != NULL)
+        memcpy(oldp, &value, sizeof(value));
+    return 0;
 }
 
 
+/*
+ * mm_prof_start - Start sampling about one allocation per sample_bytes
+ * The gaps between samples are exponentially distributed, so that every
+ * allocated byte is equally likely to be picked and a block of s bytes
+ * is sampled with probability 1 - exp(-s/sample_bytes). Other threads
+ * notice within SAMPLERECHECK bytes of their own allocations.
+ * Returns 0, or -1 if sample_bytes is 0.
+ */
+int mm_prof_start(size_t sample_bytes)
+{
+    void *pc[1];
 
+    if (sample_bytes == 0)
+        return -1;
+    backtrace(pc, 1);   /* loads the unwinder now, not while sampling */
+    LOCK_HEAP();
+    __atomic_store_n(&prof_period, sample_bytes, __ATOMIC_RELAXED);
+    UNLOCK_HEAP();
+    /* Sample this thread's next allocation */
+    prof_left = 0;
+    sample_armed -= sample_countdown;
+    sample_countdown = 0;
+    return 0;
+}
 
-/* seg_list_size_consistency:
- *   This checks if all the blocks in a particular segmented list
- *   adhere to the size constraint
- * Parameter: bp contains the address of a specific segmented list's
- *  first node address
- * Returns nothing
-*/
-static void seg_list_size_consistency(void *bp,int blockNum)
+
+/*
+ * mm_prof_stop - Stop taking samples
+ * Blocks sampled so far stay in the profile until they are freed.
+ */
+void mm_prof_stop(void)
 {
-    size_t hsize;
-    size_t maxSegSize; //Max size for a give seg list
+    LOCK_HEAP();
+    __atomic_store_n(&prof_period, 0, __ATOMIC_RELAXED);
+    UNLOCK_HEAP();
+}
 
-    maxSegSize=(size_t)find_max_range(blockNum);
 
-    //Check for size consistency within a specific seg list
-    for (; bp != NULL; bp = GET2W(NXTFREE_BLKP(bp)))
+/*
+ * mm_guard_start - Put about one allocation per sample_bytes allocated
+ * on a guarded page, with at most nslots such pages(live or quarantined)
+ * at a time
+ * Like the profiler's, the gaps are counted in bytes, so that both share
+ * one countdown; a block of s bytes is picked with probability of about
+ * s/sample_bytes. Only blocks up to a page are guarded; the rest, and any
+ * sampled while every slot is live, take the normal path. The pool is
+ * set up by the first call; later calls only change the rate. Other
+ * threads notice within SAMPLERECHECK bytes of their own allocations.
+ * Returns 0, or -1 if sample_bytes or nslots is 0 or the pool or the
+ * SIGSEGV handler could not be set up.
+ */
+int mm_guard_start(size_t sample_bytes, size_t nslots)
+{
+    struct sigaction sa;
+    void *pc[1];
+    char *lo;
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t bytes = (2*nslots + 1) * pagesize;
+
+    if (sample_bytes == 0 || nslots == 0)
+        return -1;
+    backtrace(pc, 1);   /* loads the unwinder now, not while sampling */
+    LOCK_HEAP();
+    if (guard_lo == NULL)
     {
-        hsize = GET_SIZE(HDRP(bp));
-        if(hsize>maxSegSize ||(hsize<(maxSegSize/2)))
+        lo = mmap(NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS |
+                  MAP_NORESERVE, -1, 0);
+        guard_slots = prof_mmap(nslots * sizeof(*guard_slots));
+        guard_quarantine = prof_mmap(nslots * sizeof(*guard_quarantine));
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = guard_segv;
+        sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&sa.sa_mask);
+        if (lo == MAP_FAILED || guard_slots == NULL ||
+            guard_quarantine == NULL ||
+            sigaction(SIGSEGV, &sa, &guard_oldsegv) < 0)
         {
-            printf("\n Error: There is a block in the wrong");
-            printf( "segmented free list-[%p]\n", bp);
+            if (lo != MAP_FAILED)
+                munmap(lo, bytes);
+            if (guard_slots != NULL)
+                munmap(guard_slots, nslots * sizeof(*guard_slots));
+            if (guard_quarantine != NULL)
+                munmap(guard_quarantine, nslots * sizeof(*guard_quarantine));
+            guard_slots = NULL;
+            guard_quarantine = NULL;
+            UNLOCK_HEAP();
+            return -1;
         }
+        guard_pagesize = pagesize;
+        guard_nslots = nslots;
+        guard_bytes = bytes;
+        guard_lo = lo;
     }
+    __atomic_store_n(&guard_rate, sample_bytes, __ATOMIC_RELAXED);
+    UNLOCK_HEAP();
+    /* Guard this thread's next allocation */
+    guard_left = 0;
+    sample_armed -= sample_countdown;
+    sample_countdown = 0;
+    return 0;
 }
 
 
-
-/* print_seg_list:
- *   This prints all the seg list pointers along with their locations.
- * Parameter: None
- * Returns nothing
-*/
-static void print_seg_list()
+/*
+ * mm_guard_stop - Stop putting allocations on guarded pages
+ * Guarded blocks already handed out stay guarded until they are freed,
+ * and faults in the pool are still reported.
+ */
+void mm_guard_stop(void)
 {
-    int blockNum;
-    char *bp = heap_listp;
-    printf("\n---- Printing out the initial seg list blocks!---------");
-    for (blockNum=0; blockNum <= SEGLISTS; blockNum = blockNum+ 1)
-    {
-        printf("The block Number %d which is located at",blockNum);
-        printf("%p has the address : [%p] \n",bp,GET2W((bp)));
-    }
-
+    LOCK_HEAP();
+    __atomic_store_n(&guard_rate, 0, __ATOMIC_RELAXED);
+    UNLOCK_HEAP();
 }
 
 
-/* isLastBlockFree:
- *   This tells if the last block is free or not
- * Parameter: None
- * Returns 1 if true, 0 if false
-*/
-static int isLastBlockFree()
+/*
+ * mm_guard_owns - Whether ptr lies in the guard page pool
+ */
+int mm_guard_owns(const void *ptr)
 {
-    char *blockBeforeEpilogue;
-    blockBeforeEpilogue=epilogueAddress-WSIZE;
-    if(GET_ALLOC(blockBeforeEpilogue)==0)
-    {
-        return(1);
-    }
-    else
-    {
-        return(0);
-    }
+    return GUARD_OWNS(ptr);
 }
 
 
-
-/* sizeOfLastFreeBlock:
- *   This tells the size of the last block if free
- * Parameter: None
- * Returns size of last block
- * Precondition: There must be a last block and it has to be free
-*/
-static int sizeOfLastFreeBlock()
+/*
+ * mm_numa_nodes - How many NUMA nodes have seg lists of their own;
+ * 1 on a machine with one node, where there is nothing NUMA to do
+ */
+int mm_numa_nodes(void)
 {
-    char *blockBeforeEpilogue;
-    blockBeforeEpilogue=epilogueAddress-WSIZE;
-    return(GET_SIZE(blockBeforeEpilogue));
+    pthread_once(&numa_once, numa_setup);
+    return numa_nnodes;
 }
 
 
 /*
- * place - Place block of asize bytes at start of free block bp
- *         and split if remainder would be at least minimum block size
- *
- * Parameter: None
- * Returns Nothing
+ * mm_numa_set_node - Make the calling thread's mallocs take node's
+ * blocks and pages from now on, whatever CPU it runs on; -1 makes them
+ * follow its CPU again.
+ * Returns 0, or -1 if there is no such node.
  */
-static void place(void *bp, size_t asize)
-/* $end mmplace-proto */
+int mm_numa_set_node(int node)
 {
-
+    pthread_once(&numa_once, numa_setup);
+    if (node < -1 || node >= numa_nnodes)
+        return -1;
+    numa_pinned = (node >= 0);
+    numa_node = numa_pinned ? node : 0;
+    numa_countdown = 0;
+    return 0;
+}
+
+
+/*
+ * mm_cpucache_start - Put a cache of up to about bytes of small blocks in
+ * front of the seg lists for every CPU(or, without rseq, every thread)
+ * The caches are set up by the first call; later calls only change
+ * their size. Each thread picks its cache at its first cached call.
+ * Returns 1 for CPU caches, 0 for thread caches, -1 if bytes is 0.
+ */
+int mm_cpucache_start(size_t bytes)
+{
+    int c;
+
+    if (bytes == 0)
+        return -1;
+    LOCK_HEAP();
+    if (!cache_keyed && pthread_key_create(&cache_key, cache_thread_exit) != 0)
+    {
+        UNLOCK_HEAP();
+        return -1;
+    }
+    cache_keyed = 1;
+#ifdef __x86_64__
+    if (cache_cpus == NULL)
+        cache_cpus_setup();
+#endif
+    for (c = 0; c < CACHECLASSES; c++)
+        cache_cap[c] = MIN(CACHESLOTS, MAX(1, bytes / CACHECLASSES /
+                                              (MINBLOCKSIZE + c*DSIZE)));
+    cache_bytes = bytes;
+    UNLOCK_HEAP();
+    return cache_cpus != NULL;
+}
+
+
+/*
+ * mm_cpucache_stop - Stop caching and free every cached block
+ * No other thread may be in the allocator meanwhile.
+ */
+void mm_cpucache_stop(void)
+{
+    cache_t *tc;
+
+    LOCK_HEAP();
+    cache_bytes = 0;
+    for (tc = cache_walk(NULL); tc != NULL; tc = cache_walk(tc))
+        cache_empty(tc);
+    UNLOCK_HEAP();
+}
+
+
+/* write_all - write(2) all of buf; returns 0, or -1 on error */
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    ssize_t n;
+
+    while (len > 0)
+    {
+        if ((n = write(fd, p, len)) <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * mm_prof_dump - Write the sampled stacks to fd as a legacy pprof heap
+ * profile("heap_v2", as written by gperftools), followed by the memory
+ * map so that pprof can symbolize the addresses:
+ *     pprof --text ./program heap.prof
+ * Counts are of the sampled blocks; pprof scales them up by the
+ * sampling probability. Nothing is allocated from the heap.
+ * Returns 0, or -1 if the profiler was never started.
+ */
+int mm_prof_dump(int fd)
+{
+    char buf[128 + PROFMAXDEPTH * 20];
+    uint64_t inuse_count = 0, inuse_bytes = 0;
+    uint64_t alloc_count = 0, alloc_bytes = 0;
+    prof_stack_t *st;
+    size_t i, period;
+    int j, len, maps;
+    ssize_t n;
+
+    LOCK_HEAP();
+    if (prof_stacks == NULL && prof_period == 0)
+    {
+        UNLOCK_HEAP();
+        return -1;
+    }
+    for (i = 0; i < prof_nstacks; i++)
+    {
+        inuse_count += prof_stacks[i].inuse_count;
+        inuse_bytes += prof_stacks[i].inuse_bytes;
+        alloc_count += prof_stacks[i].alloc_count;
+        alloc_bytes += prof_stacks[i].alloc_bytes;
+    }
+    period = prof_period;
+    len = snprintf(buf, sizeof(buf),
+                   "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%zu\n",
+                   (unsigned long long)inuse_count,
+                   (unsigned long long)inuse_bytes,
+                   (unsigned long long)alloc_count,
+                   (unsigned long long)alloc_bytes, period);
+    write_all(fd, buf, len);
+
+    for (i = 0; i < prof_nstacks; i++)
+    {
+        st = &prof_stacks[i];
+        len = snprintf(buf, sizeof(buf), "%llu: %llu [%llu: %llu] @",
+                       (unsigned long long)st->inuse_count,
+                       (unsigned long long)st->inuse_bytes,
+                       (unsigned long long)st->alloc_count,
+                       (unsigned long long)st->alloc_bytes);
+        for (j = 0; j < st->depth; j++)
+            len += snprintf(buf + len, sizeof(buf) - len, " %p", st->pc[j]);
+        buf[len++] = '\n';
+        write_all(fd, buf, len);
+    }
+    UNLOCK_HEAP();
+
+    write_all(fd, "\nMAPPED_LIBRARIES:\n", 19);
+    if ((maps = open("/proc/self/maps", O_RDONLY)) >= 0)
+    {
+        while ((n = read(maps, buf, sizeof(buf))) > 0)
+            write_all(fd, buf, n);
+        close(maps);
+    }
+    return 0;
+}
+
+
+/*
+ * mm_dump_heapmap - Write a map of the heap to fd(format in mm.h)
+ * Every block is listed with its seg list if free. Each page records
+ * whether it is resident and whether it lies wholly in the part of a
+ * free block that holds nothing(past the list links, before the
+ * footer), i.e. could be given back to the kernel. Nothing is
+ * allocated: records go out through a buffer on the stack.
+ * Returns 0, or -1 if a write failed.
+ */
+int mm_dump_heapmap(int fd)
+{
+    mm_heapmap_hdr_t hdr;
+    mm_heapmap_block_t recs[256];
+    unsigned char pages[4096];
+    char *base = mem_heap_lo();
+    char *bp;
+    char *first = NULL;
+    char *lo;
+    char *hi;
+    size_t pagesize = mem_pagesize();
+    size_t i, n, nrecs, page, npages, chunk;
+    int ret = 0;
+
+    LOCK_HEAP();
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MM_HEAPMAP_MAGIC, sizeof(hdr.magic));
+    hdr.version = MM_HEAPMAP_VERSION;
+    hdr.page_size = pagesize;
+    hdr.heap_base = (uintptr_t)base;
+    hdr.heap_bytes = mem_heapsize();
+    if (heap_listp != 0)
+    {
+        first = NEXT_BLKP(heap_listp);
+        for (bp = first; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+            hdr.nblocks++;
+    }
+    npages = hdr.npages = (hdr.heap_bytes + pagesize - 1) / pagesize;
+    if (write_all(fd, &hdr, sizeof(hdr)) < 0)
+        ret = -1;
+
+    /* The blocks */
+    nrecs = 0;
+    for (bp = first; ret == 0 && bp != NULL && GET_SIZE(HDRP(bp)) > 0;
+         bp = NEXT_BLKP(bp))
+    {
+        recs[nrecs].offset = HDRP(bp) - base;
+        recs[nrecs].size = GET_SIZE(HDRP(bp));
+        recs[nrecs].is_free = !GET_ALLOC(HDRP(bp));
+        recs[nrecs].list = recs[nrecs].is_free ?
+                           find_seg_list(recs[nrecs].size) : 0xff;
+        recs[nrecs].pad = 0;
+        if (++nrecs == sizeof(recs)/sizeof(recs[0]))
+        {
+            ret = write_all(fd, recs, sizeof(recs));
+            nrecs = 0;
+        }
+    }
+    if (ret == 0 && nrecs > 0)
+        ret = write_all(fd, recs, nrecs * sizeof(recs[0]));
+
+    /*
+     * The pages, a chunk at a time: mincore fills in residency, then the
+     * free blocks that reach into the chunk mark their unused pages.
+     * bp follows along in address order, so the heap is walked once.
+     */
+    bp = first;
+    for (page = 0; ret == 0 && page < npages; page += chunk)
+    {
+        chunk = MIN(sizeof(pages), npages - page);
+        if (mincore(base + page*pagesize, chunk*pagesize, pages) < 0)
+            memset(pages, 0, chunk);
+        for (i = 0; i < chunk; i++)
+            pages[i] &= MM_PAGE_RESIDENT;
+
+        for (; bp != NULL && GET_SIZE(HDRP(bp)) > 0 &&
+             (size_t)(HDRP(bp) - base) < (page + chunk)*pagesize;
+             bp = NEXT_BLKP(bp))
+        {
+            if (!GET_ALLOC(HDRP(bp)))
+            {
+                lo = (char *)bp + 2*DSIZE;
+                hi = FTRP(bp);
+                n = MAX((lo - base + pagesize - 1) / pagesize, page);
+                for (; n < page + chunk && (n + 1)*pagesize <=
+                       (size_t)(hi - base); n++)
+                    pages[n - page] |= MM_PAGE_FREE;
+            }
+            /* Leave a block that runs on into the next chunk for it */
+            if ((size_t)(HDRP(NEXT_BLKP(bp)) - base) > (page + chunk)*pagesize)
+                break;
+        }
+        ret = write_all(fd, pages, chunk);
+    }
+    UNLOCK_HEAP();
+    return ret;
+}
+
+
+/*
+ * extend_heap - Extend heap with free block and return its block pointer
+ * With NUMA nodes the new pages are node's, and the heap ends on a page
+ * boundary so that the next extension may go to another node.
+ */
+static void *extend_heap(size_t words, int node)
+{
+    void *bp;
+    size_t size;
+
+
+    /* Allocate an even number of words to maintain alignment */
+    if (words > INT_MAX / WSIZE - 1)
+        return NULL;    /* more than mem_sbrk or a header can take */
+    size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
+    if (numa_nnodes > 1)
+    {
+        size += -(uintptr_t)(epilogueAddress + WSIZE + size) &
+                ((1UL << numa_pageshift) - 1);
+        if (((uintptr_t)(epilogueAddress + WSIZE + size) >> numa_pageshift)
+            - numa_base > NUMAMAPPAGES)
+            return NULL;
+    }
+    if ((long)(bp = mem_sbrk(size)) == -1)
+        return NULL;
+    stats.nextend++;
+    stats.extend_bytes += size;
+    if (numa_nnodes > 1)
+        numa_give(bp, (char *)bp + size, node);
+
+    /* Initialize free block header/footer,
+     * next Free, previous Free and the epilogue header */
+
+    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
+    PUT(FTRP(bp), PACK(size, 0));         /* Free block header */
+
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+    epilogueAddress=HDRP(NEXT_BLKP(bp));
+
+    /* Coalesce if the previous block was free */
+    return coalesce(bp);
+}
+
+/*
+ * calloc - you may want to look at mm-naive.c
+ * This function is not tested by mdriver, but it is
+ * needed to run the traces.
+ *
+ * Only the part of the block that may have been written before is
+ * cleared: memory at or above mem_fresh_lo() (read before malloc, which
+ * may extend the heap) still reads as zero, except for the free list
+ * links that malloc itself wrote in the first 2*DSIZE bytes of the block.
+ * A big calloc on freshly extended heap thus does not touch its pages.
+ *
+ * Reference: mm-naive.c
+ */
+void *mm_calloc (size_t nmemb, size_t size)
+{
+    size_t bytes;
+    size_t dirty;
+    char *newptr;
+    char *fresh;
+    void *pc[PROFMAXDEPTH];
+    int depth = 0;
+
+    /* nmemb * size must not overflow */
+    if (nmemb != 0 && size > SIZE_MAX / nmemb)
+        return NULL;
+    bytes = nmemb * size;
+
+    /* Guarded pages are fresh from the kernel, hence zero */
+    if ((newptr = SAMPLE(bytes, ALIGNMENT, pc, depth)) != NULL)
+        return newptr;
+    LOCK_HEAP();
+    stats.nmalloc++;
+    fresh = mem_fresh_lo();
+    newptr = do_malloc(bytes);
+    if (depth > 0 && newptr != NULL)
+        prof_record(newptr, bytes, pc, depth);
+    UNLOCK_HEAP();
+    if (newptr == NULL)
+        return NULL;
+
+    dirty = (newptr < fresh) ? (size_t)(fresh - newptr) : 0;
+    dirty = MAX(dirty, 2*DSIZE);
+    if (dirty > bytes)
+        dirty = bytes;
+    memset(newptr, 0, dirty);
+
+    return newptr;
+}
+
+
+/*
+ * mm_memalign - Allocate a block whose payload is aligned to alignment
+ * A block with enough slack is taken with malloc. The part in front of
+ * the aligned payload is split off as a free block(at least MINBLOCKSIZE
+ * so that it can hold a free block) and so is any big enough tail.
+ * Free the result with free as usual.
+ * Returns the aligned payload, NULL if alignment is not a power of 2,
+ * size is 0 or out of memory.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    void *abp;
+    void *pc[PROFMAXDEPTH];
+    int depth = 0;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+        return NULL;
+    if ((abp = SAMPLE(size, alignment, pc, depth)) != NULL)
+        return abp;
+    LOCK_HEAP();
+    stats.nmalloc++;
+    abp = do_memalign(alignment, size);
+    if (depth > 0 && abp != NULL)
+        prof_record(abp, size, pc, depth);
+    UNLOCK_HEAP();
+    return abp;
+}
+
+/*
+ * do_memalign - mm_memalign with the heap lock held
+ * alignment is a power of 2 here. A size so big that the slack added
+ * to it would wrap around gets NULL.
+ */
+static void *do_memalign(size_t alignment, size_t size)
+{
+    size_t asize;
+    size_t csize;
+    size_t lead;
+    char *bp;
+    char *abp;
+
+    if (alignment <= ALIGNMENT)
+        return do_malloc(size);
+    if (size == 0 || size > SIZE_MAX - alignment - MINBLOCKSIZE - 2*DSIZE)
+        return NULL;
+
+    asize = adjust_size(size);
+    if ((bp = do_malloc(asize - DSIZE + alignment + MINBLOCKSIZE)) == NULL)
+        return NULL;
+    csize = GET_SIZE(HDRP(bp));
+
+    abp = (char *)(((size_t)bp + alignment - 1) & ~(alignment - 1));
+    if (abp != bp)
+    {
+        while ((size_t)(abp - bp) < MINBLOCKSIZE)
+            abp += alignment;
+
+        /* Give the leading part back as a free block */
+        lead = abp - bp;
+        csize -= lead;
+        PUT(HDRP(abp), PACK(csize, 1));
+        PUT(FTRP(abp), PACK(csize, 1));
+        CHECK_TOUCH(abp);
+        PUT(HDRP(bp), PACK(lead, 0));
+        PUT(FTRP(bp), PACK(lead, 0));
+        coalesce(bp);
+    }
+
+    /* Same for the tail, if it can make a block */
+    if ((csize - asize) >= MINBLOCKSIZE)
+    {
+        PUT(HDRP(abp), PACK(asize, 1));
+        PUT(FTRP(abp), PACK(asize, 1));
+        CHECK_TOUCH(abp);
+        bp = NEXT_BLKP(abp);
+        PUT(HDRP(bp), PACK(csize - asize, 0));
+        PUT(FTRP(bp), PACK(csize - asize, 0));
+        coalesce(bp);
+    }
+    return abp;
+}
+
+
+/*
+ * mm_region_create - Create an empty region
+ * Parameter: chunksize- bytes taken from the heap per chunk(0 for default)
+ * Returns the region, or NULL if chunksize is too big to align or the
+ * heap could not supply a chunk.
+ */
+mm_region_t *mm_region_create(size_t chunksize)
+{
+    char *chunk;
+    mm_region_t *region;
+
+    if (chunksize == 0)
+        chunksize = REGIONCHUNKSIZE;
+    if (chunksize > SIZE_MAX - (ALIGNMENT-1))
+        return NULL;
+    chunksize = MAX(ALIGN(chunksize), 4*DSIZE + ALIGN(sizeof(mm_region_t)));
+
+    if ((chunk = malloc(chunksize)) == NULL)
+        return NULL;
+
+    /* The region record sits right after the first chunk's link */
+    region = (mm_region_t *)(chunk + DSIZE);
+    region->chunks = chunk;
+    region->cur = chunk + DSIZE + ALIGN(sizeof(mm_region_t));
+    region->end = chunk + mm_malloc_usable_size(chunk);
+    region->chunksize = chunksize;
+    return region;
+}
+
+
+/*
+ * mm_region_alloc - Bump-allocate size bytes from a region
+ * Objects carry no header, so they can not be freed on their own;
+ * everything goes away with mm_region_destroy.
+ * Returns the address of the object, NULL if size is 0, so big that
+ * aligning it or adding a chunk link would wrap around, or out of memory.
+ */
+void *mm_region_alloc(mm_region_t *region, size_t size)
+{
+    char *bp;
+    char *chunk;
+
+    if (size == 0 || size > SIZE_MAX - DSIZE - (ALIGNMENT-1))
+        return NULL;
+    size = ALIGN(size);
+
+    /* Common case: the object fits in the current chunk */
+    if (size <= (size_t)(region->end - region->cur))
+    {
+        bp = region->cur;
+        region->cur += size;
+        return bp;
+    }
+
+    /*
+     * Big objects get a chunk of their own, linked in behind the current
+     * chunk, so that the space left in the current chunk is not wasted.
+     */
+    if (size > region->chunksize/4)
+    {
+        if ((chunk = malloc(DSIZE + size)) == NULL)
+            return NULL;
+        PUT2W(chunk, GET2W(region->chunks));
+        PUT2W(region->chunks, chunk);
+        return chunk + DSIZE;
+    }
+
+    if ((chunk = malloc(region->chunksize)) == NULL)
+        return NULL;
+    PUT2W(chunk, region->chunks);
+    region->chunks = chunk;
+    region->end = chunk + mm_malloc_usable_size(chunk);
+
+    bp = chunk + DSIZE;
+    region->cur = bp + size;
+    return bp;
+}
+
+
+/*
+ * mm_region_destroy - Release every object of a region at once
+ * Each chunk is freed(and so coalesced back into the seg lists) in turn;
+ * the chunk holding the region record is the last one in the chain.
+ * Returns nothing.
+ */
+void mm_region_destroy(mm_region_t *region)
+{
+    char *chunk;
+    char *prevChunk;
+
+    if (region == NULL)
+        return;
+
+    for (chunk = region->chunks; chunk != NULL; chunk = prevChunk)
+    {
+        prevChunk = GET2W(chunk);
+        free(chunk);
+    }
+}
+
+
+/*
+ * mm_pool_create - Create a pool of objects of a single size
+ * Parameter: obj_size- size of every object
+ *            align- required alignment(power of 2, 0 for default)
+ * Returns the pool, NULL on bad arguments or if out of memory.
+ */
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{
+    mm_pool_t *pool;
+
+    if (align == 0)
+        align = ALIGNMENT;
+    if (obj_size == 0 || (align & (align - 1)) != 0)
+        return NULL;
+
+    if ((pool = malloc(sizeof(mm_pool_t))) == NULL)
+        return NULL;
+
+    /* Every object must be able to hold the free list link */
+    pool->align = MAX(align, DSIZE);
+    pool->objsize = (MAX(obj_size, DSIZE) + pool->align - 1)
+                    & ~(pool->align - 1);
+    pool->slabsize = MAX(POOLSLABSIZE,
+                         DSIZE + pool->align + POOLSLABOBJS*pool->objsize);
+    pool->freelist = NULL;
+    pool->slabs = NULL;
+    return pool;
+}
+
+
+/*
+ * mm_pool_get - Take an object from a pool
+ * Returns the object, NULL if a new slab was needed and out of memory.
+ */
+void *mm_pool_get(mm_pool_t *pool)
+{
+    char *obj;
+
+    if (pool->freelist == NULL && pool_grow(pool) < 0)
+        return NULL;
+
+    obj = pool->freelist;
+    pool->freelist = GET2W(obj);
+    return obj;
+}
+
+
+/*
+ * mm_pool_put - Give an object back to the pool it was taken from
+ * Returns nothing.
+ */
+void mm_pool_put(mm_pool_t *pool, void *obj)
+{
+    if (obj == NULL)
+        return;
+
+    PUT2W(obj, pool->freelist);
+    pool->freelist = obj;
+}
+
+
+/*
+ * mm_pool_destroy - Free a pool and all of its slabs
+ * Objects still taken from the pool become invalid.
+ * Returns nothing.
+ */
+void mm_pool_destroy(mm_pool_t *pool)
+{
+    char *slab;
+    char *prevSlab;
+
+    if (pool == NULL)
+        return;
+
+    for (slab = pool->slabs; slab != NULL; slab = prevSlab)
+    {
+        prevSlab = GET2W(slab);
+        free(slab);
+    }
+    free(pool);
+}
+
+
+/*
+ * mm_check - Check the heap for consistency(see mm.h)
+ *
+    What is checked:
+   1. The prologue and epilogue blocks are intact.
+   2. Every block lies inside the heap, has an aligned payload, is at
+      least MINBLOCKSIZE and has the same header and footer.
+   3. No two free blocks are next to each other(they should have been
+      coalesced).
+   4. Every free block is linked into the seg list of its size, and its
+      neighbours in the list link back to it.
+   5. Every seg list holds only free blocks of its size range, its prev
+      links match its next links and it does not loop(Floyd's cycle
+      finding, so no memory is needed).
+   6. As many free blocks are on the seg lists as are in the heap.
+   The incremental mode does 1(epilogue only), 2, 3 and 4 for the blocks
+   that place, coalesce and memalign wrote since the last call, which is
+   usually one or two per malloc or free.
+ * Returns the MM_CHECK_* code of the first problem, MM_CHECK_OK if none.
+ */
+int mm_check(int mode, int nthreads, mm_check_error_t *err)
+{
+    mm_check_error_t myerr;
+    int code;
+
+    if (err == NULL)
+        err = &myerr;
+    err->code = MM_CHECK_OK;
+    err->bp = NULL;
+    err->list = -1;
+
+    LOCK_HEAP();
+    if (heap_listp == 0)
+        code = MM_CHECK_OK;
+    else if (mode == MM_CHECK_INCREMENTAL)
+        code = check_incremental(err);
+    else
+        code = check_full(nthreads, err);
+    UNLOCK_HEAP();
+    return code;
+}
+
+
+/*
+ * mm_check_strerror - Describe a MM_CHECK_* code
+ */
+const char *mm_check_strerror(int code)
+{
+    static const char *msgs[MM_CHECK_NCODES] =
+    {
+        "heap is consistent",
+        "prologue block is damaged",
+        "epilogue is damaged or misplaced",
+        "block lies outside the heap",
+        "payload is not aligned",
+        "block is below the minimum size",
+        "header and footer differ",
+        "free blocks next to each other",
+        "allocated block on a free list",
+        "free block on the wrong seg list",
+        "free list links disagree",
+        "free list loops",
+        "free blocks in the heap and on the lists differ",
+    };
+
+    if (code < 0 || code >= MM_CHECK_NCODES)
+        return "unknown error";
+    return msgs[code];
+}
+
+
+/*
+ * mm_checkheap - Print the heap(verbose > 1) and any problem mm_check
+ *                finds in it
+ */
+void mm_checkheap(int verbose)
+{
+    mm_check_error_t err;
+    char *bp;
+
+    if (verbose > 1)
+    {
+        LOCK_HEAP();
+        print_seg_list();
+        // This prints the segregated list pointers along with their locations.
+
+        //Now print out the heap blocks
+        printf("Heap (%p):\n", heap_listp);
+        for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+        {
+            printblock(bp);
+        }
+        printblock(bp);
+        UNLOCK_HEAP();
+    }
+
+    if (mm_check(MM_CHECK_FULL, 1, &err) != MM_CHECK_OK)
+        printf("Heap check: %s at %p(seg list %d)\n",
+               mm_check_strerror(err.code), err.bp, err.list);
+}
+
+/*
+ * The remaining routines are internal helper routines
+ */
+
+/* printblock:
+ *   Prints the description of a block-i.e. its header, footer,
+ *   allocation information and if free, also its next pointer
+ *   previous pointer.
+ * Parameter: bp contains the address of a specific block to be printed
+ * Returns nothing
+*/
+static void printblock(void *bp)
+{
+    size_t hsize, halloc, fsize, falloc;
+
+
+    hsize = GET_SIZE(HDRP(bp));
+    halloc = GET_ALLOC(HDRP(bp));
+    fsize = GET_SIZE(FTRP(bp));
+    falloc = GET_ALLOC(FTRP(bp));
+
+    if (hsize == 0)
+    {
+        printf("%p: EOL\n", bp);
+        return;
+    }
+
+    printf("%p: header: [%ld:%c] footer: [%ld:%c]\n", bp,
+           hsize, (halloc ? 'a' : 'f'),
+           fsize, (falloc ? 'a' : 'f'));
+    if(halloc==0)
+    {
+        printf("%p: FreeNext: [%p] FreePrev: [%p]\n",
+                bp,GET2W(NXTFREE_BLKP(bp)), GET2W(PRVFREE_BLKP(bp)));
+    }
+}
+
+
+/* print_seg_list:
+ *   This prints all the seg list pointers along with their locations.
+ * Parameter: None
+ * Returns nothing
+*/
+static void print_seg_list()
+{
+    int blockNum;
+    char *bp;
+    printf("\n---- Printing out the initial seg list blocks!---------\n");
+    for (blockNum=0; blockNum < NLISTS; blockNum = blockNum+ 1)
+    {
+        bp = segListHeadPtr + (blockNum*DSIZE);
+        printf("The block Number %d which is located at",blockNum);
+        printf("%p has the address : [%p] \n",bp,GET2W((bp)));
+    }
+
+}
+
+
+/* check_fail:
+ *   Records a problem, unless one was found before
+ * Parameter: err, code, bp- block, blockNum- seg list(-1 if none)
+ * Returns code
+*/
+static int check_fail(mm_check_error_t *err, int code, void *bp, int blockNum)
+{
+    if (err->code == MM_CHECK_OK)
+    {
+        err->code = code;
+        err->bp = bp;
+        err->list = blockNum;
+    }
+    return code;
+}
+
+
+/* check_in_heap:
+ *   Tells whether bp could be the payload of a block: aligned, after
+ *   the prologue and before the epilogue
+ * Parameter: bp
+ * Returns 1 if so, 0 if not
+*/
+static int check_in_heap(const char *bp)
+{
+    return bp > heap_listp && bp < epilogueAddress &&
+           ((size_t)bp % ALIGNMENT) == 0;
+}
+
+
+/* check_block:
+ *   Checks points 2-4 of mm_check for one block. The block is known to
+ *   start where bp says; its size is checked before anything is read
+ *   through it.
+ * Parameter: bp, err
+ * Returns the MM_CHECK_* code
+*/
+static int check_block(char *bp, mm_check_error_t *err)
+{
+    size_t size;
+    char *prev;
+    char *next;
+    int blockNum;
+
+    if (bp <= heap_listp || bp >= epilogueAddress)
+        return check_fail(err, MM_CHECK_BOUNDS, bp, -1);
+    if ((size_t)bp % ALIGNMENT != 0)
+        return check_fail(err, MM_CHECK_ALIGNMENT, bp, -1);
+    size = GET_SIZE(HDRP(bp));
+    if (size < MINBLOCKSIZE)
+        return check_fail(err, MM_CHECK_SIZE, bp, -1);
+    if (HDRP(bp) + size > epilogueAddress)
+        return check_fail(err, MM_CHECK_BOUNDS, bp, -1);
+    if (GET(HDRP(bp)) != GET(FTRP(bp)))
+        return check_fail(err, MM_CHECK_HDR_FTR, bp, -1);
+    if (GET_ALLOC(HDRP(bp)))
+        return MM_CHECK_OK;
+
+    /* A free block: coalesced with both neighbours(of its node)... */
+    if ((!GET_ALLOC(HDRP(bp) - WSIZE) && SAME_NODE(PREV_BLKP(bp), bp)) ||
+        (!GET_ALLOC(HDRP(NEXT_BLKP(bp))) && SAME_NODE(NEXT_BLKP(bp), bp)))
+        return check_fail(err, MM_CHECK_COALESCE, bp, -1);
+
+    /* ...and linked into the right seg list */
+    blockNum = (find_seg_list_address(bp) - segListHeadPtr) / DSIZE;
+    prev = GET2W(PRVFREE_BLKP(bp));
+    next = GET2W(NXTFREE_BLKP(bp));
+    if (prev == NULL)
+    {
+        if (GET2W(segListHeadPtr + (blockNum*DSIZE)) != bp)
+            return check_fail(err, MM_CHECK_LIST_LINKS, bp, blockNum);
+    }
+    else if (!check_in_heap(prev) || GET2W(NXTFREE_BLKP(prev)) != bp)
+    {
+        return check_fail(err, MM_CHECK_LIST_LINKS, bp, blockNum);
+    }
+    if (next != NULL &&
+        (!check_in_heap(next) || GET2W(PRVFREE_BLKP(next)) != bp))
+        return check_fail(err, MM_CHECK_LIST_LINKS, bp, blockNum);
+    return MM_CHECK_OK;
+}
+
+
+/* check_list:
+ *   Checks point 5 of mm_check for one seg list
+ * Parameter: blockNum, count- gets the list length added, err
+ * Returns the MM_CHECK_* code
+*/
+static int check_list(int blockNum, size_t *count, mm_check_error_t *err)
+{
+    char *head = GET2W(segListHeadPtr + (blockNum*DSIZE));
+    char *slow;
+    char *fast;
+    char *prev;
+    char *bp;
+
+    /* fast takes two steps for every one of slow; in a loop they meet */
+    for (slow = fast = head; fast != NULL; )
+    {
+        if (!check_in_heap(fast) ||
+            (fast = GET2W(NXTFREE_BLKP(fast))) == NULL ||
+            !check_in_heap(fast))
+            break;
+        fast = GET2W(NXTFREE_BLKP(fast));
+        slow = GET2W(NXTFREE_BLKP(slow));
+        if (slow == fast)
+            return check_fail(err, MM_CHECK_LIST_CYCLE, slow, blockNum);
+    }
+
+    for (prev = NULL, bp = head; bp != NULL;
+         prev = bp, bp = GET2W(NXTFREE_BLKP(bp)))
+    {
+        if (!check_in_heap(bp))
+            return check_fail(err, MM_CHECK_BOUNDS, bp, blockNum);
+        if (GET_ALLOC(HDRP(bp)))
+            return check_fail(err, MM_CHECK_LIST_ALLOC, bp, blockNum);
+        if ((find_seg_list_address(bp) - segListHeadPtr) / DSIZE != blockNum)
+            return check_fail(err, MM_CHECK_LIST_CLASS, bp, blockNum);
+        if (GET2W(PRVFREE_BLKP(bp)) != prev)
+            return check_fail(err, MM_CHECK_LIST_LINKS, bp, blockNum);
+        (*count)++;
+    }
+    return MM_CHECK_OK;
+}
+
+
+/* One thread's share of a full check */
+typedef struct
+{
+    char *from;             /* first block of its part of the heap... */
+    char *to;               /* ...and the block after its last one */
+    int list;               /* first seg list it checks... */
+    int step;               /* ...and then every step'th one */
+    size_t heap_free;       /* free blocks it met in the heap... */
+    size_t list_free;       /* ...and on its seg lists */
+    mm_check_error_t err;   /* first problem it found */
+} check_part_t;
+
+/* check_part:
+ *   Thread body of a full check: checks the blocks and seg lists of one
+ *   part
+ * Parameter: arg- the check_part_t
+ * Returns NULL
+*/
+static void *check_part(void *arg)
+{
+    check_part_t *part = arg;
+    char *bp;
+    int blockNum;
+
+    for (bp = part->from; bp < part->to; bp = NEXT_BLKP(bp))
+    {
+        if (check_block(bp, &part->err) != MM_CHECK_OK)
+            break;
+        if (!GET_ALLOC(HDRP(bp)))
+            part->heap_free++;
+    }
+    for (blockNum = part->list; blockNum < NLISTS &&
+         part->err.code == MM_CHECK_OK; blockNum += part->step)
+        check_list(blockNum, &part->list_free, &part->err);
+    return NULL;
+}
+
+/* check_full:
+ *   Checks all of mm_check's points. One pass hops from header to
+ *   header, which is all that can not be split up, and notes where each
+ *   of nthreads equal parts of the heap starts; the threads then check
+ *   their parts' blocks(footers, neighbours, list links) and every
+ *   nthreads'th seg list.
+ * Parameter: nthreads, err
+ * Returns the MM_CHECK_* code
+*/
+static int check_full(int nthreads, mm_check_error_t *err)
+{
+    check_part_t parts[CHECKMAXTHREADS];
+    pthread_t tids[CHECKMAXTHREADS];
+    int started[CHECKMAXTHREADS];
+    char *bp;
+    char *prev = NULL;
+    char *end = epilogueAddress + WSIZE;
+    size_t size, heap_free = 0, list_free = 0;
+    int j;
+
+    check_nlog = 0;
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > CHECKMAXTHREADS)
+        nthreads = CHECKMAXTHREADS;
+    if (nthreads > NLISTS)
+        nthreads = NLISTS;
+
+    if (GET(HDRP(heap_listp)) != PACK(DSIZE, 1) ||
+        GET(FTRP(heap_listp)) != PACK(DSIZE, 1))
+        return check_fail(err, MM_CHECK_PROLOGUE, heap_listp, -1);
+    if (GET(epilogueAddress) != PACK(0, 1))
+        return check_fail(err, MM_CHECK_EPILOGUE, end, -1);
+
+    memset(parts, 0, nthreads * sizeof(*parts));
+    parts[0].from = NEXT_BLKP(heap_listp);
+    for (j = 1; j < nthreads; j++)
+        parts[j].from = end;
+    for (bp = parts[0].from, j = 1; HDRP(bp) < epilogueAddress;
+         prev = bp, bp = NEXT_BLKP(bp))
+    {
+        /* A bad size most likely comes from a damaged block before */
+        size = GET_SIZE(HDRP(bp));
+        if ((size < MINBLOCKSIZE || HDRP(bp) + size > epilogueAddress) &&
+            prev != NULL && GET(HDRP(prev)) != GET(FTRP(prev)))
+            return check_fail(err, MM_CHECK_HDR_FTR, prev, -1);
+        if (size < MINBLOCKSIZE)
+            return check_fail(err, MM_CHECK_SIZE, bp, -1);
+        if (HDRP(bp) + size > epilogueAddress)
+            return check_fail(err, MM_CHECK_BOUNDS, bp, -1);
+        while (j < nthreads &&
+               bp >= heap_listp + (end - heap_listp) / nthreads * j)
+            parts[j++].from = bp;
+    }
+
+    for (j = 0; j < nthreads; j++)
+    {
+        parts[j].to = (j + 1 < nthreads) ? parts[j + 1].from : end;
+        parts[j].list = j;
+        parts[j].step = nthreads;
+        parts[j].err.list = -1;
+        started[j] = j > 0 &&
+            pthread_create(&tids[j], NULL, check_part, &parts[j]) == 0;
+    }
+    for (j = 0; j < nthreads; j++)
+        if (!started[j])
+            check_part(&parts[j]);
+    for (j = 1; j < nthreads; j++)
+        if (started[j])
+            pthread_join(tids[j], NULL);
+
+    /* The first problem in heap order wins */
+    for (j = 0; j < nthreads; j++)
+    {
+        if (parts[j].err.code != MM_CHECK_OK)
+        {
+            *err = parts[j].err;
+            return err->code;
+        }
+        heap_free += parts[j].heap_free;
+        list_free += parts[j].list_free;
+    }
+    if (heap_free != list_free)
+        return check_fail(err, MM_CHECK_FREE_COUNT, NULL, -1);
+    return MM_CHECK_OK;
+}
+
+
+/* check_incremental:
+ *   Checks the blocks in check_log and the epilogue; the first call,
+ *   and any after check_log overflowed, does a full check instead
+ * Parameter: err
+ * Returns the MM_CHECK_* code
+*/
+static int check_incremental(mm_check_error_t *err)
+{
+    char *next;
+    int i, code;
+
+    if (!check_logging || check_nlog > CHECKLOGSIZE)
+    {
+        check_logging = 1;
+        return check_full(1, err);
+    }
+
+    if (GET(epilogueAddress) != PACK(0, 1))
+        return check_fail(err, MM_CHECK_EPILOGUE, epilogueAddress + WSIZE, -1);
+    for (i = 0; i < check_nlog; i++)
+    {
+        if ((code = check_block(check_log[i], err)) != MM_CHECK_OK)
+            break;
+
+        /* A damaged neighbour would throw the next full walk off */
+        next = NEXT_BLKP(check_log[i]);
+        if (HDRP(next) < epilogueAddress &&
+            (code = check_block(next, err)) != MM_CHECK_OK)
+            break;
+    }
+    check_nlog = 0;
+    return err->code;
+}
+
+
+/* check_touch:
+ *   Adds a block to check_log(once), or marks it overflowed
+ * Parameter: bp
+ * Returns Nothing
+*/
+static void check_touch(void *bp)
+{
+    int i;
+
+    if (check_nlog > CHECKLOGSIZE)
+        return;
+    for (i = 0; i < check_nlog; i++)
+        if (check_log[i] == bp)
+            return;
+    if (check_nlog == CHECKLOGSIZE)
+        check_nlog = CHECKLOGSIZE + 1;
+    else
+        check_log[check_nlog++] = bp;
+}
+
+
+/* check_untouch:
+ *   Takes a block out of check_log: it is being merged into the block
+ *   in front of it, so bp is no longer where a block starts
+ * Parameter: bp
+ * Returns Nothing
+*/
+static void check_untouch(void *bp)
+{
+    int i;
+
+    if (check_nlog > CHECKLOGSIZE)
+        return;
+    for (i = 0; i < check_nlog; i++)
+    {
+        if (check_log[i] == bp)
+        {
+            check_log[i] = check_log[--check_nlog];
+            return;
+        }
+    }
+}
+
+
+/* isLastBlockFree:
+ *   This tells if the last block is free or not
+ * Parameter: None
+ * Returns 1 if true, 0 if false
+*/
+static int isLastBlockFree()
+{
+    char *blockBeforeEpilogue;
+    blockBeforeEpilogue=epilogueAddress-WSIZE;
+    if(GET_ALLOC(blockBeforeEpilogue)==0)
+    {
+        return(1);
+    }
+    else
+    {
+        return(0);
+    }
+}
+
+
+
+/* sizeOfLastFreeBlock:
+ *   This tells the size of the last block if free
+ * Parameter: None
+ * Returns size of last block
+ * Precondition: There must be a last block and it has to be free
+*/
+static int sizeOfLastFreeBlock()
+{
+    char *blockBeforeEpilogue;
+    blockBeforeEpilogue=epilogueAddress-WSIZE;
+    return(GET_SIZE(blockBeforeEpilogue));
+}
+
+
+/* adjust_size:
+ *   This adjusts a request to include overhead and alignment reqs.
+ *   A size that would wrap around gets the largest aligned size, which
+ *   no fit search or heap extension can satisfy.
+ * Parameter: size- the payload size asked for
+ * Returns the block size(asize) that malloc looks for
+*/
+static size_t adjust_size(size_t size)
+{
+    if (size <= (2*DSIZE))
+        return 3*DSIZE;
+    if (size > SIZE_MAX - 2*DSIZE)
+        return SIZE_MAX & ~(size_t)(DSIZE-1);
+    return DSIZE * ((size + (DSIZE) + (DSIZE-1)) / DSIZE);
+}
+
+
+/* pool_grow:
+ *   This takes a new slab from the heap and threads all of its objects
+ *   into the pool's free list, lowest address first.
+ * Parameter: pool
+ * Returns 0 on success, -1 if the heap could not supply a slab
+ * Precondition: The pool's free list is empty
+*/
+static int pool_grow(mm_pool_t *pool)
+{
+    char *slab;
+    char *obj;
+    char *first;
+    char *end;
+
+    if ((slab = malloc(pool->slabsize)) == NULL)
+        return -1;
+    PUT2W(slab, pool->slabs);
+    pool->slabs = slab;
+
+    first = (char *)(((size_t)slab + DSIZE + pool->align - 1)
+                     & ~(pool->align - 1));
+    end = slab + mm_malloc_usable_size(slab);
+
+    /* Thread from the back so that the lowest object ends up in front */
+    obj = first + ((size_t)(end - first) / pool->objsize - 1) * pool->objsize;
+    for (; obj >= first; obj -= pool->objsize)
+    {
+        PUT2W(obj, pool->freelist);
+        pool->freelist = obj;
+    }
+    return 0;
+}
+
+
+/*
+ * place - Place block of asize bytes at start of free block bp
+ *         and split if remainder would be at least minimum block size
+ *
+ * Parameter: None
+ * Returns Nothing
+ */
+static void place(void *bp, size_t asize)
+/* $end mmplace-proto */
+{
+
+    size_t csize = GET_SIZE(HDRP(bp));
+    if ((csize - asize) >= (MINBLOCKSIZE))
+    {
+        /*Here the first part is allocated to the user and
+        the latter part is added to the appropriate free list*/
+
+        remove_from_seg_list(bp);
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        stats.nsplit++;
+        CHECK_TOUCH(bp);
+
+        bp = NEXT_BLKP(bp);
+        PUT(HDRP(bp), PACK(csize-asize, 0));
+        PUT(FTRP(bp), PACK(csize-asize, 0));
+        add_to_seg_list(bp);
+        CHECK_TOUCH(bp);
+        // Ensure that the rest of the block is put into appropriate SEGLIST
+    }
+    else
+    {
+        PUT(HDRP(bp), PACK(csize, 1));
+        PUT(FTRP(bp), PACK(csize, 1));
+        remove_from_seg_list(bp);
+        CHECK_TOUCH(bp);
+
+    }
+
+}
+
+
+/* sizeOfLastFreeBlock:
+ *   This adds the block to the appropriate segList at the front.
+ * Parameter: bp, which is the block to be added to list
+ * Returns Nothing
+ * Precondition: Coalescing is done before
+*/
+static void add_to_seg_list(void *bp)
+{
+
+    char *currentSegListHead;
+    char *segListPointsTo;
+
+    stats.free_bytes += GET_SIZE(HDRP(bp));
+    stats.free_blocks++;
+    PUT2W(PRVFREE_BLKP(bp),0);
+    currentSegListHead=find_seg_list_address(bp);
+    // This gets the addressof the seg list
+    segListPointsTo=GET2W((currentSegListHead));
+    // Gets the location where the seg list first points to
+
+    if(segListPointsTo==0)
+    {
+        // There are no other elements in SEGLIST- THis would be the first one
+        PUT2W(NXTFREE_BLKP(bp),0);
+    }
+    else
+    {
+        /* There is an node that it points to . Do 2 things:
+         * 1. Update next pointer of bp.
+         * 2.Update previous pointer of the previous first block
+         */
+        PUT2W(NXTFREE_BLKP(bp),segListPointsTo);
+        PUT2W(PRVFREE_BLKP(segListPointsTo),bp);
+    }
+    PUT2W(currentSegListHead,bp);
+}
+
+
+/* remove_from_seg_list:
+ *   This removes the block from appropriate SEGLIST and ensures consistency
+ * Parameter: bp, which is the block to be removed from list
+ * Returns Nothing
+*/
+static void remove_from_seg_list(void *bp)
+{
+    char *nextFreePtr;
+    char *prevFreePtr;
+    char *currentSegListHead;
+
+    stats.free_bytes -= GET_SIZE(HDRP(bp));
+    stats.free_blocks--;
+    nextFreePtr=GET2W(NXTFREE_BLKP(bp));
+    // Give the address of next free block
+    prevFreePtr=GET2W(PRVFREE_BLKP(bp));
+    // Gives the address of the previous free block
+
+    if(prevFreePtr==0)
+    {
+        //Block's specific header is NULL-i.e.this is the 1st element in list
+        currentSegListHead=find_seg_list_address(bp);
+        PUT2W(currentSegListHead,nextFreePtr);
+        if(nextFreePtr!=0)
+        {
+            //If next isnt NULL, ensure it's previous pointer points to NULL
+            PUT2W(PRVFREE_BLKP(nextFreePtr),0);
+        }
+    }
+    else
+    {
+        // The block's previous pointer is not NULL- there is a node before it
+        PUT2W(NXTFREE_BLKP(prevFreePtr),nextFreePtr);
+        if(nextFreePtr!=0)
+        {
+            PUT2W(PRVFREE_BLKP(nextFreePtr),prevFreePtr);
+        }
+    }
+}
+
+
+
+/* find_fit:
+ *   Find a fit for a block with asize bytes.
+ *
+ * Parameter: asize- the size for which block has to be found
+ * Returns address for block if present. NULL if none could be found.
+*/
+static void *find_fit(size_t asize, int node)
+{
+    /*Go through all the free lists in order from the correct size
+     *to the largest possible.
+     */
+    int blockNum;
+    void *bp;
+    uint64_t steps = 0;
+
+    stats.nsearch++;
+    if (find_seg_list(asize) < 0)
+    {
+        // Bigger than any seg list holds(only absurd requests)
+        stats.search_misses++;
+        return NULL;
+    }
+    for (blockNum=find_seg_list(asize);
+     blockNum <= SEGLISTS; blockNum = blockNum+ 1)
+    {
+        bp = (NODE_HEADS(node)+(blockNum*8));
+        if(GET2W(bp)==0)
+        {
+            // There are no blocks within the size limit at all
+
+        }
+        else
+        {
+            //Check within a specific seg list
+            for (bp = GET2W(bp); bp != NULL; bp = GET2W(NXTFREE_BLKP(bp)))
+            {
+                steps++;
+                if ( (asize <= (size_t)GET_SIZE(HDRP(bp))))
+                {
+                    search_done(steps);
+                    return bp;
+                }
+            }
+
+        }
+    }
+    search_done(steps);
+    stats.search_misses++;
+    return NULL; /* No fit */
+}
+
+
+
+
+/* search_done:
+ *  Counts the blocks one find_fit call looked at
+ * Parameter: steps
+ * Returns Nothing
+*/
+static void search_done(uint64_t steps)
+{
+    stats.search_steps += steps;
+    if (steps > stats.search_max)
+        stats.search_max = steps;
+}
+
+
+/* class_free_bytes:
+ *  Adds up the sizes of the free blocks in one seg list(of every node)
+ * Parameter: blockNum
+ * Returns the total, header and footer included
+*/
+static uint64_t class_free_bytes(int blockNum)
+{
+    char *bp;
+    uint64_t total = 0;
+    int node;
+
+    for (node = 0; node < numa_nnodes; node++)
+        for (bp = GET2W(NODE_HEADS(node) + (blockNum*DSIZE)); bp != NULL;
+             bp = GET2W(NXTFREE_BLKP(bp)))
+            total += GET_SIZE(HDRP(bp));
+    return total;
+}
+
+
+
+
+/* find_seg_list_address:
+ *  Gives the seg list address for any random block
+ *  For instance, for blocks between sizes 0  and 32(inclusive)
+ *  it returns the pointer for the 0th block(of the block's node)
+ * Parameter: bp
+ * Returns block address-seg list address for any random block
+*/
+static char *find_seg_list_address(void *bp)
+{
+    int segListNum;
     size_t csize = GET_SIZE(HDRP(bp));
-    if ((csize - asize) >= (MINBLOCKSIZE))
+    segListNum=find_seg_list(csize);
+    return((char *)NODE_HEADS(NODE_OF(bp))+(segListNum*DSIZE));
+}
+
+
+
+
+/* find_seg_list:
+ *  This gives the block number for a specific size
+ * Parameter: asize
+ * Returns integer that is a block number
+*/
+static int find_seg_list(size_t asize)
+{
+    int segListCounter;
+    size_t x;
+    x=MINSEGLISTSIZE;
+    for(segListCounter=0; segListCounter<=SEGLISTS; segListCounter+=1)
+    {
+        if(asize<=(x))
+        {
+            return(segListCounter);
+        }
+        x=x*2;
+    }
+    return(-1);
+}
+
+
+
+/* sample_take:
+ *  The slow path of every allocation whose thread's byte countdown ran
+ *  out. The bytes since the last look are taken off the gaps left to the
+ *  next profiler sample and the next guarded block; a gap that ran out
+ *  is drawn again and its sample taken. The profiler's gaps are
+ *  exponentially distributed with mean prof_period, the guard's uniform
+ *  in [0, 2*guard_rate). The countdown is then set to the shorter gap,
+ *  or to SAMPLERECHECK bytes if both are off.
+ * Parameter: pc- room for the stack, depth- set to the number of frames
+ *  in pc if profiling this allocation
+ * Returns 1 if this allocation is to be guarded
+*/
+static __attribute__((noinline)) int sample_take(void **pc, int *depth)
+{
+    size_t period = __atomic_load_n(&prof_period, __ATOMIC_RELAXED);
+    size_t rate = __atomic_load_n(&guard_rate, __ATOMIC_RELAXED);
+    int64_t used = sample_armed - sample_countdown;
+    int64_t next = SAMPLERECHECK;
+    int guard = 0;
+    int n;
+    double u;
+
+    /* backtrace() may allocate the first time; don't sample that */
+    if (prof_busy)
+        return 0;
+
+    if (period == 0)
+        prof_left = 0;
+    else if ((prof_left -= used) < 0)
+    {
+        u = (sample_rand() >> 11) * (1.0 / 9007199254740992.0);
+        prof_left = (int64_t)(-log(1 - u) * period);
+
+        prof_busy = 1;
+        n = backtrace(pc, PROFMAXDEPTH);
+        prof_busy = 0;
+
+        /* Leave out sample_take itself */
+        if (n > 1)
+            memmove(pc, pc + 1, (n - 1) * sizeof(*pc));
+        *depth = MAX(n - 1, 0);
+    }
+
+    if (rate == 0)
+        guard_left = 0;
+    else if ((guard_left -= used) < 0)
+    {
+        guard_left = sample_rand() % (2*rate);
+        guard = 1;
+    }
+
+    if (period != 0)
+        next = MIN(next, prof_left);
+    if (rate != 0)
+        next = MIN(next, guard_left);
+    sample_countdown = sample_armed = next;
+
+    return guard;
+}
+
+
+/* sample_rand:
+ *  xorshift64*, seeded from where this thread's state lives
+ * Returns 64 random bits
+*/
+static uint64_t sample_rand(void)
+{
+    if (sample_rng == 0)
+        sample_rng = (uint64_t)(uintptr_t)&sample_rng | 1;
+    sample_rng ^= sample_rng >> 12;
+    sample_rng ^= sample_rng << 25;
+    sample_rng ^= sample_rng >> 27;
+    return sample_rng * 0x2545f4914f6cdd1dULL;
+}
+
+
+/* prof_mmap:
+ *  Gets zeroed memory for the profiler's tables from the kernel
+ * Parameter: bytes
+ * Returns the memory, NULL if there is none
+*/
+static void *prof_mmap(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+
+/* Hash of a block address or of a stack's hash, for the profiler tables */
+static size_t prof_hash(uint64_t x)
+{
+    return (size_t)((x * 0x9e3779b97f4a7c15ULL) >> 24);
+}
+
+
+/* prof_find_stack:
+ *  Finds the stack in the stack table, adding it if it is new. Both
+ *  tables double when they fill up(the index at half full).
+ * Parameter: pc, depth
+ * Returns its index in prof_stacks, -1 if out of memory
+*/
+static int prof_find_stack(void **pc, int depth)
+{
+    prof_stack_t *stacks;
+    int32_t *idx;
+    uint64_t hash = depth;
+    size_t i, j, newmask;
+    int k;
+
+    for (k = 0; k < depth; k++)
+        hash = (hash ^ (uint64_t)(uintptr_t)pc[k]) * 0x100000001b3ULL;
+
+    if (prof_stackidx != NULL)
+    {
+        for (i = prof_hash(hash) & prof_stackmask; prof_stackidx[i] >= 0;
+             i = (i + 1) & prof_stackmask)
+        {
+            stacks = &prof_stacks[prof_stackidx[i]];
+            if (stacks->hash == hash && stacks->depth == depth &&
+                memcmp(stacks->pc, pc, depth * sizeof(*pc)) == 0)
+                return prof_stackidx[i];
+        }
+    }
+
+    if (prof_nstacks == prof_maxstacks)
+    {
+        j = prof_maxstacks ? 2*prof_maxstacks : 256;
+        if ((stacks = prof_mmap(j * sizeof(*stacks))) == NULL)
+            return -1;
+        if (prof_stacks != NULL)
+        {
+            memcpy(stacks, prof_stacks, prof_nstacks * sizeof(*stacks));
+            munmap(prof_stacks, prof_maxstacks * sizeof(*stacks));
+        }
+        prof_stacks = stacks;
+        prof_maxstacks = j;
+    }
+    if (2*(prof_nstacks + 1) > prof_stackmask + 1)
+    {
+        newmask = prof_stackidx ? 2*prof_stackmask + 1 : 511;
+        if ((idx = prof_mmap((newmask + 1) * sizeof(*idx))) == NULL)
+            return -1;
+        memset(idx, 0xff, (newmask + 1) * sizeof(*idx));
+        for (j = 0; j < prof_nstacks; j++)
+        {
+            for (i = prof_hash(prof_stacks[j].hash) & newmask; idx[i] >= 0;
+                 i = (i + 1) & newmask)
+                ;
+            idx[i] = j;
+        }
+        if (prof_stackidx != NULL)
+            munmap(prof_stackidx, (prof_stackmask + 1) * sizeof(*idx));
+        prof_stackidx = idx;
+        prof_stackmask = newmask;
+    }
+
+    stacks = &prof_stacks[prof_nstacks];
+    stacks->hash = hash;
+    stacks->depth = depth;
+    memcpy(stacks->pc, pc, depth * sizeof(*pc));
+    for (i = prof_hash(hash) & prof_stackmask; prof_stackidx[i] >= 0;
+         i = (i + 1) & prof_stackmask)
+        ;
+    prof_stackidx[i] = prof_nstacks;
+    return prof_nstacks++;
+}
+
+
+/* prof_add_block:
+ *  Puts a block into the block table, which doubles at half full
+ * Parameter: the block's record
+ * Returns 0, -1 if out of memory
+*/
+static int prof_add_block(const prof_block_t *rec)
+{
+    prof_block_t *blocks;
+    size_t i, j, newmask;
+
+    if (2*(prof_nblocks + 1) > prof_blockmask + 1)
+    {
+        newmask = prof_blocks ? 2*prof_blockmask + 1 : 1023;
+        if ((blocks = prof_mmap((newmask + 1) * sizeof(*blocks))) == NULL)
+            return -1;
+        for (j = 0; prof_blocks != NULL && j <= prof_blockmask; j++)
+        {
+            if (prof_blocks[j].bp == NULL)
+                continue;
+            for (i = prof_hash((uintptr_t)prof_blocks[j].bp) & newmask;
+                 blocks[i].bp != NULL; i = (i + 1) & newmask)
+                ;
+            blocks[i] = prof_blocks[j];
+        }
+        if (prof_blocks != NULL)
+            munmap(prof_blocks, (prof_blockmask + 1) * sizeof(*blocks));
+        prof_blocks = blocks;
+        prof_blockmask = newmask;
+    }
+
+    for (i = prof_hash((uintptr_t)rec->bp) & prof_blockmask;
+         prof_blocks[i].bp != NULL; i = (i + 1) & prof_blockmask)
+        ;
+    prof_blocks[i] = *rec;
+    prof_nblocks++;
+    return 0;
+}
+
+
+/* prof_record:
+ *  Keeps a newly sampled block in the tables under the stack in pc.
+ *  Called with the heap lock held.
+ * Parameter: bp- the block, size- bytes asked for, pc/depth- the stack
+ * Returns Nothing
+*/
+static void prof_record(void *bp, size_t size, void **pc, int depth)
+{
+    int stack;
+
+    if ((stack = prof_find_stack(pc, depth)) >= 0)
+        prof_keep(bp, size, stack, 1);
+}
+
+
+/* prof_keep:
+ *  Keeps a block in the tables and marks its header and footer, so that
+ *  freeing it finds the record. A block that was sampled already
+ *  (realloc in place) is recounted at its new size. Only a fresh sample
+ *  adds to the stack's allocation totals; a realloc'd one that keeps its
+ *  sample is the same allocation.
+ *  Called with the heap lock held.
+ * Parameter: bp- the block, size- bytes asked for, stack- its index in
+ *  prof_stacks, fresh- whether this is a new sample
+ * Returns Nothing
+*/
+static void prof_keep(void *bp, size_t size, int stack, int fresh)
+{
+    prof_block_t rec;
+
+    if (GET(HDRP(bp)) & SAMPLED)
+        prof_drop(bp);
+    rec.bp = bp;
+    rec.stack = stack;
+    rec.size = size;
+    if (prof_add_block(&rec) < 0)
+        return;
+
+    prof_stacks[stack].inuse_count++;
+    prof_stacks[stack].inuse_bytes += size;
+    if (fresh)
+    {
+        prof_stacks[stack].alloc_count++;
+        prof_stacks[stack].alloc_bytes += size;
+    }
+    PUT(HDRP(bp), GET(HDRP(bp)) | SAMPLED);
+    PUT(FTRP(bp), GET(FTRP(bp)) | SAMPLED);
+}
+
+
+/* prof_stack_of:
+ *  Looks a sampled block up in the block table
+ *  Called with the heap lock held.
+ * Parameter: bp
+ * Returns its stack's index in prof_stacks, -1 if it has no record
+*/
+static int prof_stack_of(void *bp)
+{
+    size_t i;
+
+    if (prof_blocks == NULL)
+        return -1;
+    for (i = prof_hash((uintptr_t)bp) & prof_blockmask;
+         prof_blocks[i].bp != bp; i = (i + 1) & prof_blockmask)
+    {
+        if (prof_blocks[i].bp == NULL)
+            return -1;
+    }
+    return prof_blocks[i].stack;
+}
+
+
+/* prof_drop:
+ *  Takes a block out of the block table(backward-shift deletion, no
+ *  tombstones) and out of its stack's in-use counts. The header bit is
+ *  left to the caller, who is rewriting the header anyway.
+ *  Called with the heap lock held.
+ * Parameter: bp
+ * Returns Nothing
+*/
+static void prof_drop(void *bp)
+{
+    size_t i, hole, home;
+
+    if (prof_blocks == NULL)
+        return;
+    for (i = prof_hash((uintptr_t)bp) & prof_blockmask;
+         prof_blocks[i].bp != bp; i = (i + 1) & prof_blockmask)
+    {
+        if (prof_blocks[i].bp == NULL)
+            return;
+    }
+    prof_stacks[prof_blocks[i].stack].inuse_count--;
+    prof_stacks[prof_blocks[i].stack].inuse_bytes -= prof_blocks[i].size;
+
+    hole = i;
+    for (i = (hole + 1) & prof_blockmask; prof_blocks[i].bp != NULL;
+         i = (i + 1) & prof_blockmask)
+    {
+        home = prof_hash((uintptr_t)prof_blocks[i].bp) & prof_blockmask;
+        if (((i - home) & prof_blockmask) >= ((i - hole) & prof_blockmask))
+        {
+            prof_blocks[hole] = prof_blocks[i];
+            hole = i;
+        }
+    }
+    prof_blocks[hole].bp = NULL;
+    prof_nblocks--;
+}
+
+
+/* prof_reset_blocks:
+ *  mm_init throws the heap away, and with it every sampled block; the
+ *  stacks keep their totals of all allocations
+ * Parameter: None
+ * Returns Nothing
+*/
+static void prof_reset_blocks(void)
+{
+    size_t i;
+
+    if (prof_blocks != NULL)
+        memset(prof_blocks, 0, (prof_blockmask + 1) * sizeof(*prof_blocks));
+    prof_nblocks = 0;
+    for (i = 0; i < prof_nstacks; i++)
+    {
+        prof_stacks[i].inuse_count = 0;
+        prof_stacks[i].inuse_bytes = 0;
+    }
+}
+
+
+/* guard_alloc:
+ *  Takes a never used slot if there is one left, else the one that has
+ *  been in quarantine longest, and places the payload at the end of its
+ *  page(rounded down to align). The bytes between the payload and the
+ *  guard page are filled with GUARDSLACK, to be checked on free.
+ * Parameter: size- bytes asked for, align- power of 2 payload alignment
+ * Returns the payload, NULL if the block can not be guarded
+*/
+static __attribute__((noinline)) void *guard_alloc(size_t size, size_t align)
+{
+    guard_slot_t *slot;
+    char *page;
+    size_t i;
+    void *pc[GUARDMAXDEPTH];
+    int depth;
+
+    align = MAX(align, ALIGNMENT);
+    if (size == 0 || size > guard_pagesize || align > guard_pagesize ||
+        (align & (align - 1)) != 0)
+        return NULL;
+    depth = backtrace(pc, GUARDMAXDEPTH);
+
+    LOCK_HEAP();
+    if (guard_nfresh < guard_nslots)
+        i = guard_nfresh++;
+    else if (guard_qlen > 0)
+    {
+        i = guard_quarantine[guard_qhead];
+        guard_qhead = (guard_qhead + 1) % guard_nslots;
+        guard_qlen--;
+    }
+    else
+    {
+        UNLOCK_HEAP();
+        return NULL;
+    }
+    slot = &guard_slots[i];
+    page = guard_lo + (2*i + 1) * guard_pagesize;
+    if (mprotect(page, guard_pagesize, PROT_READ | PROT_WRITE) < 0)
+    {
+        /* Leave the slot where it was found */
+        if (slot->state == GUARD_UNUSED)
+            guard_nfresh--;
+        else
+        {
+            guard_qhead = (guard_qhead + guard_nslots - 1) % guard_nslots;
+            guard_qlen++;
+        }
+        UNLOCK_HEAP();
+        return NULL;
+    }
+    slot->ptr = page + ((guard_pagesize - size) & ~(align - 1));
+    slot->size = size;
+    slot->state = GUARD_LIVE;
+    slot->alloc_tid = syscall(SYS_gettid);
+    slot->free_depth = 0;
+    /* Leave out guard_alloc itself */
+    slot->alloc_depth = MAX(depth - 1, 0);
+    memcpy(slot->alloc_pc, pc + 1, slot->alloc_depth * sizeof(*pc));
+    memset(slot->ptr + size, GUARDSLACK, page + guard_pagesize -
+           (slot->ptr + size));
+    stats.nmalloc++;
+    UNLOCK_HEAP();
+    return slot->ptr;
+}
+
+
+/* guard_report:
+ *  Writes what went wrong at addr, and the stacks of the block in slot,
+ *  to stderr. Runs in the SIGSEGV handler too, so it only formats into
+ *  a buffer on the stack and writes.
+ * Parameter: what- kind of bug, addr- the bad address, slot- nearest slot
+ * Returns Nothing
+*/
+static void guard_report(const char *what, const void *addr,
+                         const guard_slot_t *slot)
+{
+    char buf[256];
+    long off;
+    int n;
+
+    off = (const char *)addr - slot->ptr;
+    if (off >= 0 && (size_t)off >= slot->size)
+        n = snprintf(buf, sizeof(buf), "mm guard: %s at %p, %ld bytes past "
+                     "the %zu byte block at %p\n", what, addr,
+                     off - (long)slot->size, slot->size, slot->ptr);
+    else if (off < 0)
+        n = snprintf(buf, sizeof(buf), "mm guard: %s at %p, %ld bytes before "
+                     "the %zu byte block at %p\n", what, addr, -off,
+                     slot->size, slot->ptr);
+    else
+        n = snprintf(buf, sizeof(buf), "mm guard: %s at %p, byte %ld of the "
+                     "%zu byte block at %p\n", what, addr, off, slot->size,
+                     slot->ptr);
+    write_all(STDERR_FILENO, buf, MIN((size_t)n, sizeof(buf) - 1));
+    n = snprintf(buf, sizeof(buf), "allocated by thread %d at:\n",
+                 (int)slot->alloc_tid);
+    write_all(STDERR_FILENO, buf, n);
+    backtrace_symbols_fd((void *const *)slot->alloc_pc, slot->alloc_depth,
+                         STDERR_FILENO);
+    if (slot->state == GUARD_FREED)
+    {
+        n = snprintf(buf, sizeof(buf), "freed by thread %d at:\n",
+                     (int)slot->free_tid);
+        write_all(STDERR_FILENO, buf, n);
+        backtrace_symbols_fd((void *const *)slot->free_pc, slot->free_depth,
+                             STDERR_FILENO);
+    }
+}
+
+
+/* guard_free:
+ *  Frees a guarded block: reports and aborts on a double or invalid
+ *  free or on writes past the payload, else protects the page, gives
+ *  its memory back and puts the slot at the end of the quarantine
+ * Parameter: ptr- in the guard pool
+ * Returns Nothing
+*/
+static __attribute__((noinline)) void guard_free(void *ptr)
+{
+    guard_slot_t *slot;
+    char *page;
+    char *p;
+    size_t i;
+    void *pc[GUARDMAXDEPTH];
+    int depth;
+
+    depth = backtrace(pc, GUARDMAXDEPTH);
+    i = ((char *)ptr - guard_lo) / (2*guard_pagesize);
+    slot = &guard_slots[i];
+    page = guard_lo + (2*i + 1) * guard_pagesize;
+
+    LOCK_HEAP();
+    if (slot->state != GUARD_LIVE || ptr != slot->ptr)
+    {
+        guard_report(slot->state == GUARD_FREED && ptr == slot->ptr ?
+                     "double free" : "invalid free", ptr, slot);
+        abort();
+    }
+    for (p = slot->ptr + slot->size; p < page + guard_pagesize; p++)
+    {
+        if (*(unsigned char *)p != GUARDSLACK)
+        {
+            guard_report("buffer overflow(found on free)", p, slot);
+            abort();
+        }
+    }
+    slot->state = GUARD_FREED;
+    slot->free_tid = syscall(SYS_gettid);
+    slot->free_depth = MAX(depth - 1, 0);
+    memcpy(slot->free_pc, pc + 1, slot->free_depth * sizeof(*pc));
+    mprotect(page, guard_pagesize, PROT_NONE);
+    madvise(page, guard_pagesize, MADV_DONTNEED);
+    guard_quarantine[(guard_qhead + guard_qlen) % guard_nslots] = i;
+    guard_qlen++;
+    stats.nfree++;
+    UNLOCK_HEAP();
+}
+
+
+/* guard_realloc:
+ *  realloc where the old block is guarded or the new one is: anything
+ *  not yet allocated comes from mm_malloc and the old block is freed
+ * Parameter: ptr- old block, size- new size, newptr- guarded new block
+ *  or NULL
+ * Returns the new block, NULL if size is 0 or out of memory
+*/
+static void *guard_realloc(void *ptr, size_t size, void *newptr)
+{
+    size_t oldsize;
+
+    if (size == 0)
+    {
+        mm_free(ptr);
+        return NULL;
+    }
+    if (newptr == NULL && (newptr = mm_malloc(size)) == NULL)
+        return NULL;
+    oldsize = mm_malloc_usable_size(ptr);
+    memcpy(newptr, ptr, MIN(oldsize, size));
+    mm_free(ptr);
+    return newptr;
+}
+
+
+/* guard_reset:
+ *  mm_init throws the heap away; guarded blocks go with it
+ * Parameter: None
+ * Returns Nothing
+*/
+static void guard_reset(void)
+{
+    if (guard_lo == NULL)
+        return;
+    mprotect(guard_lo, guard_bytes, PROT_NONE);
+    madvise(guard_lo, guard_bytes, MADV_DONTNEED);
+    memset(guard_slots, 0, guard_nslots * sizeof(*guard_slots));
+    guard_nfresh = 0;
+    guard_qhead = 0;
+    guard_qlen = 0;
+}
+
+
+/* guard_segv:
+ *  SIGSEGV handler. A fault in the pool is reported against the slot it
+ *  hit or, on a guard page, the nearer of the two slots beside it: past
+ *  the end of the one before(overflow) or in front of the one after
+ *  (underflow). Then the old handler is put back and the access is
+ *  left to fault again; faults elsewhere go straight to the old handler.
+ * Parameter: the usual
+ * Returns Nothing
+*/
+static void guard_segv(int sig, siginfo_t *info, void *uctx)
+{
+    char *addr = info->si_addr;
+    const guard_slot_t *slot;
+    const guard_slot_t *before, *after;
+    size_t page;
+    const char *what;
+
+    if (GUARD_OWNS(addr))
+    {
+        page = (addr - guard_lo) / guard_pagesize;
+        if (page % 2 == 1)
+        {
+            slot = &guard_slots[page / 2];
+            what = slot->state == GUARD_FREED ? "use after free" :
+                   "wild access";
+        }
+        else
+        {
+            before = page > 0 ? &guard_slots[page/2 - 1] : NULL;
+            after = page/2 < guard_nslots ? &guard_slots[page/2] : NULL;
+            if (before != NULL && before->state == GUARD_UNUSED)
+                before = NULL;
+            if (after != NULL && after->state == GUARD_UNUSED)
+                after = NULL;
+            if (before != NULL && (after == NULL || addr - (before->ptr +
+                before->size) <= after->ptr - addr))
+            {
+                slot = before;
+                what = "buffer overflow";
+            }
+            else
+            {
+                slot = after;
+                what = "buffer underflow";
+            }
+        }
+        if (slot != NULL && slot->state != GUARD_UNUSED)
+            guard_report(what, addr, slot);
+        else
+        {
+            what = "mm guard: wild access in the pool\n";
+            write_all(STDERR_FILENO, what, strlen(what));
+        }
+    }
+    else if (guard_oldsegv.sa_flags & SA_SIGINFO)
     {
-        /*Here the first part is allocated to the user and
-        the latter part is added to the appropriate free list*/
-
-        remove_from_seg_list(bp);
-        PUT(HDRP(bp), PACK(asize, 1));
-        PUT(FTRP(bp), PACK(asize, 1));
+        guard_oldsegv.sa_sigaction(sig, info, uctx);
+        return;
+    }
+    else if (guard_oldsegv.sa_handler != SIG_DFL &&
+             guard_oldsegv.sa_handler != SIG_IGN)
+    {
+        guard_oldsegv.sa_handler(sig);
+        return;
+    }
+    sigaction(SIGSEGV, &guard_oldsegv, NULL);
+}
 
-        bp = NEXT_BLKP(bp);
-        PUT(HDRP(bp), PACK(csize-asize, 0));
-        PUT(FTRP(bp), PACK(csize-asize, 0));
-        add_to_seg_list(bp);
-        // Ensure that the rest of the block is put into appropriate SEGLIST
+/* numa_setup:
+ *  Finds the NUMA nodes and which node each CPU is on: from
+ *  MM_NUMA_FAKE if it is set, else from sysfs. With fewer than two
+ *  nodes(or no room for the page map, or in a build without
+ *  MM_THREADSAFE) numa_nnodes stays 1.
+ *  Runs once, through numa_once.
+ * Parameter: None
+ * Returns Nothing
+*/
+static void numa_setup(void)
+{
+    char path[64];
+    char buf[4096];
+    const char *fake = getenv("MM_NUMA_FAKE");
+    void *map;
+    ssize_t len;
+    int fd, id, n = 0, used;
+
+    numa_pageshift = __builtin_ctzl(sysconf(_SC_PAGESIZE));
+    memset(numa_cpu_node, -1, sizeof(numa_cpu_node));
+#ifndef MM_THREADSAFE
+    return;
+#endif
+    if (fake != NULL)
+    {
+        /* One whitespace-separated cpulist per node */
+        numa_fake = 1;
+        while (n < NUMAMAXNODES &&
+               sscanf(fake, " %4095s%n", buf, &used) == 1)
+        {
+            if (numa_parse_cpus(buf, n) < 0)
+            {
+                fprintf(stderr, "mm: bad MM_NUMA_FAKE cpulist %s\n", buf);
+                return;
+            }
+            numa_ids[n] = n;
+            n++;
+            fake += used;
+        }
     }
     else
     {
-        PUT(HDRP(bp), PACK(csize, 1));
-        PUT(FTRP(bp), PACK(csize, 1));
-        remove_from_seg_list(bp);
-
+        /* Node numbers may have gaps; each present one gets an index */
+        for (id = 0; id < NUMAMAXNODES; id++)
+        {
+            snprintf(path, sizeof(path),
+                     "/sys/devices/system/node/node%d/cpulist", id);
+            if ((fd = open(path, O_RDONLY)) < 0)
+                continue;
+            len = read(fd, buf, sizeof(buf) - 1);
+            close(fd);
+            buf[len > 0 ? len : 0] = '\0';
+            if (numa_parse_cpus(buf, n) < 0)
+                return;
+            numa_ids[n++] = id;
+        }
     }
+    if (n < 2)
+        return;
 
+    map = mmap(NULL, NUMAMAPPAGES, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED)
+        return;
+    numa_map = map;
+#ifdef MM_THREADSAFE
+    numa_nnodes = n;
+#endif
 }
 
+/* numa_parse_cpus:
+ *  Reads a cpulist as sysfs writes them("0-3,8,10-11") and puts its
+ *  CPUs on node. An empty list(a node with memory only) is fine.
+ * Parameter: list, node- an index into numa_ids
+ * Returns 0, or -1 if list is not a cpulist
+*/
+static int numa_parse_cpus(const char *list, int node)
+{
+    char *end;
+    long lo, hi;
 
-/* sizeOfLastFreeBlock:
- *   This adds the block to the appropriate segList at the front.
- * Parameter: bp, which is the block to be added to list
- * Returns Nothing
- * Precondition: Coalescing is done before
+    while (*list != '\0' && *list != '\n')
+    {
+        lo = hi = strtol(list, &end, 10);
+        if (end == list || lo < 0)
+            return -1;
+        if (*end == '-')
+        {
+            list = end + 1;
+            hi = strtol(list, &end, 10);
+            if (end == list || hi < lo)
+                return -1;
+        }
+        for (; lo <= hi && lo < NUMAMAXCPUS; lo++)
+            numa_cpu_node[lo] = node;
+        list = end;
+        if (*list == ',')
+            list++;
+        else if (*list != '\0' && *list != '\n')
+            return -1;
+    }
+    return 0;
+}
+
+/* numa_current:
+ *  The calling thread's node: the one mm_numa_set_node gave it, or that
+ *  of the CPU it was on when it last looked. Looking costs a system
+ *  call, so it is done every NUMARECHECK calls; a thread that moves to
+ *  another node is not wrong for long, and its blocks are still good.
+ * Parameter: None
+ * Returns the node's index
 */
-static void add_to_seg_list(void *bp)
+static int numa_current(void)
 {
+    unsigned int cpu;
+
+    if (numa_pinned || --numa_countdown > 0)
+        return numa_node;
+    numa_countdown = NUMARECHECK;
+    if (syscall(SYS_getcpu, &cpu, NULL, NULL) == 0 &&
+        cpu < NUMAMAXCPUS && numa_cpu_node[cpu] >= 0)
+        numa_node = numa_cpu_node[cpu];
+    return numa_node;
+}
 
-    char *currentSegListHead;
-    char *segListPointsTo;
+/* numa_give:
+ *  Makes the heap pages that [lo, hi) touches node's in numa_map, and
+ *  asks the kernel to take them from node's memory when they are first
+ *  touched. A page already in memory stays where it is; if the node has
+ *  no free memory the kernel uses another, which is still correct.
+ * Parameter: lo, hi, node
+ * Returns Nothing
+*/
+static void numa_give(char *lo, char *hi, int node)
+{
+    uintptr_t first = (uintptr_t)lo >> numa_pageshift;
+    uintptr_t last = ((uintptr_t)hi - 1) >> numa_pageshift;
+    unsigned long mask;
 
-    PUT2W(PRVFREE_BLKP(bp),0);
-    currentSegListHead=find_seg_list_address(bp);
-    // This gets the addressof the seg list
-    segListPointsTo=GET2W((currentSegListHead));
-    // Gets the location where the seg list first points to
+    memset(numa_map + (first - numa_base), node, last - first + 1);
+    if (numa_fake)
+        return;
+    mask = 1UL << numa_ids[node];
+    syscall(SYS_mbind, first << numa_pageshift,
+            (last - first + 1) << numa_pageshift, NUMA_MPOL_PREFERRED,
+            &mask, 8*sizeof(mask) + 1, 0);
+}
 
-    if(segListPointsTo==0)
+/* cache_malloc:
+ *  malloc of a small size through this thread's cache. On a miss it
+ *  takes half a stack's worth of blocks under one lock, keeps the rest
+ *  for the next calls and gives back those that do not fit
+ * Parameter: size- at most MM_CACHEMAXSIZE
+ * Returns the block, NULL if out of memory
+*/
+static void *cache_malloc(size_t size)
+{
+    void *bp[CACHESLOTS/2 + 1];
+    size_t asize = adjust_size(size);
+    int c = CACHE_CLASS(asize);
+    int i, j, n, want;
+
+    if (cache_mode == CACHE_UNSET)
+        cache_setup();
+    if (cache_mode != CACHE_NONE && (bp[0] = cache_pop(c)) != NULL)
     {
-        // There are no other elements in SEGLIST- THis would be the first one
-        PUT2W(NXTFREE_BLKP(bp),0);
+        CACHE_COUNT(nmalloc);
+        return bp[0];
     }
-    else
+
+    want = (cache_mode == CACHE_NONE) ? 1 : cache_cap[c]/2 + 1;
+    LOCK_HEAP();
+    stats.nmalloc++;
+    for (n = 0; n < want && (bp[n] = do_malloc(size)) != NULL; n++)
+        ;
+    UNLOCK_HEAP();
+    if (n == 0)
+        return NULL;
+
+    /* A block too big to split exactly is not of this class */
+    for (i = j = 1; i < n; i++)
+        if (GET_SIZE(HDRP(bp[i])) != asize || !cache_push(c, bp[i]))
+            bp[j++] = bp[i];
+    if (j > 1)
     {
-        /* There is an node that it points to . Do 2 things:
-         * 1. Update next pointer of bp.
-         * 2.Update previous pointer of the previous first block
-         */
-        PUT2W(NXTFREE_BLKP(bp),segListPointsTo);
-        PUT2W(PRVFREE_BLKP(segListPointsTo),bp);
+        LOCK_HEAP();
+        for (i = 1; i < j; i++)
+            do_free(bp[i]);
+        UNLOCK_HEAP();
     }
-    PUT2W(currentSegListHead,bp);
+    return bp[0];
 }
 
-
-/* remove_from_seg_list:
- *   This removes the block from appropriate SEGLIST and ensures consistency
- * Parameter: bp, which is the block to be removed from list
+/* cache_free:
+ *  free of a small block through this thread's cache. If the cache has
+ *  no room, half its blocks of this size go back with bp, so that the
+ *  next frees find room
+ * Parameter: bp- an allocated block of at most CACHEMAXBLOCK bytes
  * Returns Nothing
 */
-static void remove_from_seg_list(void *bp)
+static void cache_free(void *bp)
 {
-    char *nextFreePtr;
-    char *prevFreePtr;
-    char *currentSegListHead;
-
-    nextFreePtr=GET2W(NXTFREE_BLKP(bp));
-    // Give the address of next free block
-    prevFreePtr=GET2W(PRVFREE_BLKP(bp));
-    // Gives the address of the previous free block
+    void *out[CACHESLOTS/2];
+    int c = CACHE_CLASS(GET_SIZE(HDRP(bp)));
+    int n = 0;
 
-    if(prevFreePtr==0)
-    {
-        //Block's specific header is NULL-i.e.this is the 1st element in list
-        currentSegListHead=find_seg_list_address(bp);
-        PUT2W(currentSegListHead,nextFreePtr);
-        if(nextFreePtr!=0)
-        {
-            //If next isnt NULL, ensure it's previous pointer points to NULL
-            PUT2W(PRVFREE_BLKP(nextFreePtr),0);
-        }
-    }
-    else
+    if (cache_mode == CACHE_UNSET)
+        cache_setup();
+    if (cache_mode != CACHE_NONE && cache_push(c, bp))
     {
-        // The block's previous pointer is not NULL- there is a node before it
-        PUT2W(NXTFREE_BLKP(prevFreePtr),nextFreePtr);
-        if(nextFreePtr!=0)
-        {
-            PUT2W(PRVFREE_BLKP(nextFreePtr),prevFreePtr);
-        }
+        CACHE_COUNT(nfree);
+        return;
     }
+
+    if (cache_mode != CACHE_NONE)
+        while (n < (int)cache_cap[c]/2 && (out[n] = cache_pop(c)) != NULL)
+            n++;
+    LOCK_HEAP();
+    stats.nfree++;
+    do_free(bp);
+    while (n > 0)
+        do_free(out[--n]);
+    UNLOCK_HEAP();
 }
 
+/* cache_pop:
+ *  Takes the block last put in this thread's cache for class c
+ * Parameter: c
+ * Returns the block, NULL if there is none
+*/
+static void *cache_pop(int c)
+{
+    cache_t *tc = cache_mine;
 
+#ifdef __x86_64__
+    if (cache_mode == CACHE_CPU)
+        return rseq_pop(c);
+#endif
+    if (tc->count[c] == 0)
+        return NULL;
+    return tc->slot[c][--tc->count[c]];
+}
 
-/* find_fit:
- *   Find a fit for a block with asize bytes.
- *
- * Parameter: asize- the size for which block has to be found
- * Returns address for block if present. NULL if none could be found.
+/* cache_push:
+ *  Puts a block of class c in this thread's cache
+ * Parameter: c, bp
+ * Returns 1, or 0 if the cache has no room for it
 */
-static void *find_fit(size_t asize)
+static int cache_push(int c, void *bp)
 {
-    /*Go through all the free lists in order from the correct size
-     *to the largest possible.
-     */
-    int blockNum;
-    void *bp;
-    for (blockNum=find_seg_list(asize);
-     blockNum <= SEGLISTS; blockNum = blockNum+ 1)
-    {
-        bp = (segListHeadPtr+(blockNum*8));
-        if(GET2W(bp)==0)
-        {
-            // There are no blocks within the size limit at all
+    cache_t *tc = cache_mine;
 
-        }
-        else
-        {
-            //Check within a specific seg list
-            for (bp = GET2W(bp); bp != NULL; bp = GET2W(NXTFREE_BLKP(bp)))
-            {
-                if ( (asize <= (size_t)GET_SIZE(HDRP(bp))))
-                {
-                    return bp;
-                }
-            }
+#ifdef __x86_64__
+    if (cache_mode == CACHE_CPU)
+        return rseq_push(c, bp);
+#endif
+    if (tc->count[c] >= cache_cap[c])
+        return 0;
+    tc->slot[c][tc->count[c]++] = bp;
+    return 1;
+}
 
-        }
+/* cache_here:
+ *  The cache this thread uses: its CPU's(which may have changed by the
+ *  time the caller looks) or its own
+ * Parameter: None
+ * Returns the cache, NULL if it has none
+*/
+static cache_t *cache_here(void)
+{
+#ifdef __x86_64__
+    uint32_t cpu;
+
+    if (cache_mode == CACHE_CPU)
+    {
+        cpu = __atomic_load_n(&cache_rseq->cpu_id, __ATOMIC_RELAXED);
+        if (cpu >= cache_ncpus)
+            return NULL;
+        return (cache_t *)(cache_cpus + cpu*cache_stride);
     }
-    return NULL; /* No fit */
+#endif
+    return cache_mine;
 }
 
+/* cache_setup:
+ *  Picks the calling thread's cache: its CPU's if there are CPU caches
+ *  and it has rseq, else a thread cache no thread owns, else a new one
+ * Parameter: None
+ * Returns Nothing
+*/
+static void cache_setup(void)
+{
+    cache_t *tc;
 
+#ifdef __x86_64__
+    if (cache_cpus != NULL &&
+        (cache_rseq != NULL || (cache_rseq = rseq_area()) != NULL))
+    {
+        cache_mode = CACHE_CPU;
+        return;
+    }
+#endif
+    LOCK_HEAP();
+    for (tc = cache_threads; tc != NULL && tc->owned; tc = tc->next)
+        ;
+    if (tc == NULL && (tc = prof_mmap(sizeof(*tc))) != NULL)
+    {
+        tc->next = cache_threads;
+        cache_threads = tc;
+    }
+    if (tc != NULL)
+        tc->owned = 1;
+    UNLOCK_HEAP();
+    if (tc != NULL)
+        pthread_setspecific(cache_key, tc);
+    cache_mine = tc;
+    cache_mode = (tc != NULL) ? CACHE_THREAD : CACHE_NONE;
+}
 
+/* cache_thread_exit:
+ *  pthread_key destructor of a thread with a thread cache: frees its
+ *  blocks and leaves the cache for the next new thread. Destructors of
+ *  other keys may still malloc and free in this thread afterwards;
+ *  they take the locked path, as the cache may be another thread's
+ * Parameter: arg- the thread cache
+ * Returns Nothing
+*/
+static void cache_thread_exit(void *arg)
+{
+    cache_t *tc = arg;
+
+    cache_mine = NULL;
+    cache_mode = CACHE_NONE;
+    LOCK_HEAP();
+    cache_empty(tc);
+    tc->owned = 0;
+    UNLOCK_HEAP();
+}
 
-/* find_seg_list_address:
- *  Gives the seg list address for any random block
- *  For instance, for blocks between sizes 0  and 32(inclusive)
- *  it returns the pointer for the 0th block
- * Parameter: bp
- * Returns block address-seg list address for any random block
+/* cache_walk:
+ *  Steps through the CPU caches, then the thread caches
+ * Parameter: tc- the cache before, NULL to start
+ * Returns the next cache, NULL after the last
 */
-static char *find_seg_list_address(void *bp)
+static cache_t *cache_walk(cache_t *tc)
 {
-    int segListNum;
-    size_t csize = GET_SIZE(HDRP(bp));
-    segListNum=find_seg_list(csize);
-    return((char *)segListHeadPtr+(segListNum*DSIZE));
+    char *p = (char *)tc;
+    char *end = cache_cpus + cache_ncpus*cache_stride;
+
+    if (cache_cpus != NULL && (p == NULL || (p >= cache_cpus && p < end)))
+    {
+        p = (p == NULL) ? cache_cpus : p + cache_stride;
+        return (p < end) ? (cache_t *)p : cache_threads;
+    }
+    return (tc == NULL) ? cache_threads : tc->next;
 }
 
+/* cache_empty:
+ *  Frees every block of a cache; with the heap lock held, and for a CPU
+ *  cache only while no thread can be using it
+ * Parameter: tc
+ * Returns Nothing
+*/
+static void cache_empty(cache_t *tc)
+{
+    int c;
 
+    for (c = 0; c < CACHECLASSES; c++)
+        while (tc->count[c] > 0)
+            do_free(tc->slot[c][--tc->count[c]]);
+}
 
+/* cache_reset:
+ *  Empties every cache without freeing: the blocks were in the heap
+ *  mm_init is starting over
+ * Parameter: None
+ * Returns Nothing
+*/
+static void cache_reset(void)
+{
+    cache_t *tc;
 
-/* find_seg_list:
- *  This gives the block number for a specific size
- * Parameter: asize
- * Returns integer that is a block number
+    for (tc = cache_walk(NULL); tc != NULL; tc = cache_walk(tc))
+    {
+        memset(tc->count, 0, sizeof(tc->count));
+        tc->nmalloc = tc->nfree = 0;
+    }
+}
+
+/* cache_totals:
+ *  Sets the cache_* counters of stats from the caches. Other threads
+ *  may be using their caches meanwhile, so the sums are about right
+ * Parameter: reset- zero the caches' counters too
+ * Returns Nothing
 */
-static int find_seg_list(size_t asize)
+static void cache_totals(int reset)
 {
-    int segListCounter;
-    size_t x;
-    x=MINSEGLISTSIZE;
-    for(segListCounter=0; segListCounter<=SEGLISTS; segListCounter+=1)
+    cache_t *tc;
+    uint32_t n;
+    int c;
+
+    stats.cache_mallocs = stats.cache_frees = stats.cache_bytes = 0;
+    stats.cache_tables = (cache_cpus != NULL) ? cache_ncpus*cache_stride : 0;
+    for (tc = cache_walk(NULL); tc != NULL; tc = cache_walk(tc))
     {
-        if(asize<=(x))
+        if (reset)
+            tc->nmalloc = tc->nfree = 0;
+        stats.cache_mallocs += tc->nmalloc;
+        stats.cache_frees += tc->nfree;
+        for (c = 0; c < CACHECLASSES; c++)
         {
-            return(segListCounter);
+            n = __atomic_load_n(&tc->count[c], __ATOMIC_RELAXED);
+            stats.cache_bytes += (uint64_t)n * (MINBLOCKSIZE + c*DSIZE);
         }
-        x=x*2;
+        if ((char *)tc < cache_cpus ||
+            (char *)tc >= cache_cpus + cache_ncpus*cache_stride)
+            stats.cache_tables += sizeof(*tc);
     }
-    return(-1);
 }
 
+#ifdef __x86_64__
+/* cache_cpus_setup:
+ *  Maps a cache for every CPU that may come online, unless the calling
+ *  thread has no rseq or MM_RSEQ=0 asks for thread caches. Pages of
+ *  CPUs that never run a cached call are never touched
+ * Parameter: None
+ * Returns Nothing
+*/
+static void cache_cpus_setup(void)
+{
+    const char *env = getenv("MM_RSEQ");
+    long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    size_t stride = (sizeof(cache_t) + 63) & ~(size_t)63;
+    void *p;
 
+    if ((env != NULL && strcmp(env, "0") == 0) || ncpus <= 0 ||
+        (cache_rseq == NULL && (cache_rseq = rseq_area()) == NULL))
+        return;
+    p = mmap(NULL, ncpus * stride, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+        return;
+    cache_stride = stride;
+    cache_ncpus = ncpus;
+    cache_cpus = p;
+}
 
-/* find_max_range:
- *  This gives the max limit for a block number(i.e. specific seg list)
- * Parameter: blockNum
- * Returns integer that is the max limit for a block number
+/* rseq_area:
+ *  The calling thread's rseq area: the one the C library registered
+ *  (glibc 2.35 and up, at __rseq_offset from the thread pointer), or
+ *  else rseq_own, registered now
+ * Parameter: None
+ * Returns the area, NULL if the kernel has no rseq
 */
-static int find_max_range(int blockNum)
+static struct rseq *rseq_area(void)
 {
-    int segListCounter;
-    size_t x;
-    x=MINSEGLISTSIZE;
-    for(segListCounter=0; segListCounter<=blockNum; segListCounter+=1)
+    char *tp;
+
+    if (&__rseq_size != NULL && __rseq_size != 0)
     {
-        x=x*2;
+        __asm__ ("movq %%fs:0, %0" : "=r" (tp));
+        return (struct rseq *)(tp + __rseq_offset);
     }
-    return((int)x);
+    if (syscall(SYS_rseq, &rseq_own, sizeof(rseq_own), 0, RSEQSIG) == 0)
+        return &rseq_own;
+    return NULL;
+}
+
+/*
+ * The rseq critical sections. Each one points the thread's rseq_cs at
+ * its descriptor(3:), which gives the section [1:, 2:) and the abort
+ * handler 4:; the handler, preceded by the RSEQSIG signature the
+ * kernel checks, starts the section over from 6:. Everything up to the
+ * count store that ends the section may be redone, so nothing before
+ * it changes what another thread can see.
+ */
+#define RSEQ_START \
+    ".pushsection __rseq_cs, \"aw\"\n\t" \
+    ".balign 32\n" \
+    "3:\n\t" \
+    ".long 0, 0\n\t" \
+    ".quad 1f, 2f - 1f, 4f\n\t" \
+    ".popsection\n" \
+    "6:\n\t" \
+    "leaq 3b(%%rip), %%rax\n\t" \
+    "movq %%rax, 8(%[rs])\n" \
+    "1:\n\t"
+#define RSEQ_END \
+    "2:\n\t" \
+    ".pushsection __rseq_failure, \"ax\"\n\t" \
+    ".byte 0x0f, 0xb9, 0x3d\n\t" \
+    ".long 0x53053053\n" \
+    "4:\n\t" \
+    "jmp 6b\n\t" \
+    ".popsection\n"
+
+/* rseq_pop:
+ *  Takes the block last put in this CPU's cache for class c: %rax is
+ *  the cache, %ecx its count
+ * Parameter: c
+ * Returns the block, NULL if there is none
+*/
+static void *rseq_pop(int c)
+{
+    void *bp;
+
+    __asm__ __volatile__ (
+        RSEQ_START
+        "xorl %k[bp], %k[bp]\n\t"
+        "movl 4(%[rs]), %%eax\n\t"          /* rseq cpu_id */
+        "cmpl %[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[cpus], %%rax\n\t"
+        "movl (%%rax,%[c],4), %%ecx\n\t"
+        "testl %%ecx, %%ecx\n\t"
+        "jz 2f\n\t"
+        "decl %%ecx\n\t"
+        "movq %[c], %%rdx\n\t"
+        "shlq $%c[shift], %%rdx\n\t"
+        "addq %%rcx, %%rdx\n\t"
+        "movq %c[slot](%%rax,%%rdx,8), %[bp]\n\t"
+        "movl %%ecx, (%%rax,%[c],4)\n"      /* commit */
+        RSEQ_END
+        : [bp] "=&r" (bp)
+        : [rs] "r" (cache_rseq), [cpus] "r" (cache_cpus),
+          [stride] "r" (cache_stride), [ncpus] "r" (cache_ncpus),
+          [c] "r" ((uintptr_t)c), [shift] "i" (CACHESLOTSHIFT),
+          [slot] "i" (offsetof(cache_t, slot))
+        : "rax", "rcx", "rdx", "cc", "memory");
+    return bp;
+}
+
+/* rseq_push:
+ *  Puts a block in this CPU's cache for class c: %rax is the cache,
+ *  %ecx its count
+ * Parameter: c, bp
+ * Returns 1, or 0 if the cache has no room for it
+*/
+static int rseq_push(int c, void *bp)
+{
+    int ok;
+
+    __asm__ __volatile__ (
+        RSEQ_START
+        "xorl %[ok], %[ok]\n\t"
+        "movl 4(%[rs]), %%eax\n\t"          /* rseq cpu_id */
+        "cmpl %[ncpus], %%eax\n\t"
+        "jae 2f\n\t"
+        "imulq %[stride], %%rax\n\t"
+        "addq %[cpus], %%rax\n\t"
+        "movl (%%rax,%[c],4), %%ecx\n\t"
+        "cmpl %[cap], %%ecx\n\t"
+        "jae 2f\n\t"
+        "movq %[c], %%rdx\n\t"
+        "shlq $%c[shift], %%rdx\n\t"
+        "addq %%rcx, %%rdx\n\t"
+        "movq %[bp], %c[slot](%%rax,%%rdx,8)\n\t"
+        "incl %%ecx\n\t"
+        "movl $1, %[ok]\n\t"
+        "movl %%ecx, (%%rax,%[c],4)\n"      /* commit */
+        RSEQ_END
+        : [ok] "=&r" (ok)
+        : [rs] "r" (cache_rseq), [cpus] "r" (cache_cpus),
+          [stride] "r" (cache_stride), [ncpus] "r" (cache_ncpus),
+          [c] "r" ((uintptr_t)c), [cap] "r" (cache_cap[c]),
+          [bp] "r" (bp), [shift] "i" (CACHESLOTSHIFT),
+          [slot] "i" (offsetof(cache_t, slot))
+        : "rax", "rcx", "rdx", "cc", "memory");
+    return ok;
+}
+#endif
+
+#ifdef MM_THREADSAFE
+/* fork_register:
+ *  Installs the fork handlers; called once, by the first mm_init
+ * Parameter: None
+ * Returns Nothing
+*/
+static void fork_register(void)
+{
+    if (pthread_atfork(fork_prepare, fork_parent, fork_child) != 0)
+        fprintf(stderr, "mm: pthread_atfork failed; fork is not safe\n");
+}
+
+/* fork_prepare:
+ *  Runs in the forking thread before fork: waits for the heap to be
+ *  in one piece and keeps it that way until the fork is done
+ * Parameter: None
+ * Returns Nothing
+*/
+static void fork_prepare(void)
+{
+    LOCK_HEAP();
+}
+
+/* fork_parent:
+ *  Runs in the parent after fork
+ * Parameter: None
+ * Returns Nothing
+*/
+static void fork_parent(void)
+{
+    UNLOCK_HEAP();
 }
 
+/* fork_child:
+ *  Runs in the child after fork, which has only the forking thread.
+ *  The lock is made anew rather than unlocked, as a mutex copied while
+ *  held is only safe to use again once it is reinitialized. The
+ *  sampling random numbers get the child's pid, or the child would
+ *  sample the same calls as its parent. Nothing in the heap is
+ *  written(see Fork in the notes at the top)
+ * Parameter: None
+ * Returns Nothing
+*/
+static void fork_child(void)
+{
+    cache_t *tc;
+
+    pthread_mutex_init(&heap_lock, NULL);
+    sample_rng ^= (uint64_t)getpid() * 0x9e3779b97f4a7c15ULL;
+    for (tc = cache_threads; tc != NULL; tc = tc->next)
+        if (tc != cache_mine)
+            tc->owned = 0;
+}
+#endif
@@ -1,4 +1,12 @@
+#ifndef __MM_H_
+#define __MM_H_
+
 #include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 #ifdef DRIVER
 
@@ -7,6 +15,7 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
 
 #else
 
@@ -15,10 +24,201 @@ extern void *malloc (size_t size);
 extern void free (void *ptr);
 extern void *realloc(void *ptr, size_t size);
 extern void *calloc (size_t nmemb, size_t size);
+extern void *memalign(size_t alignment, size_t size);
 
 #endif
 
 extern int mm_init(void);
 
-/* This is largely for debugging. */
-extern void mm_checkheap(int lineno);
+/* Sizing hints: real capacity of a block, and what a request rounds to */
+extern size_t mm_malloc_usable_size(void *ptr);
+extern size_t mm_good_size(size_t size);
+
+/* Free space right now, by seg list size class, for fragmentation reports */
+#define MM_SIZECLASSES 28
+typedef struct {
+    size_t heap_bytes;    /* bytes from the heap start to the epilogue */
+    size_t free_bytes;    /* total size of the free blocks... */
+    size_t free_blocks;   /* ...how many there are... */
+    size_t largest_free;  /* ...and the biggest one */
+    size_t class_free[MM_SIZECLASSES]; /* free_bytes of each seg list */
+} mm_freeinfo_t;
+extern void mm_freeinfo(mm_freeinfo_t *info);
+
+/*
+ * Allocator health since mm_init, for metrics export. Byte counts are
+ * whole blocks, header and footer included. Everything but class_free
+ * and cache_* is kept up to date as the heap changes; class_free walks
+ * the lists, cache_* the CPU or thread caches(mm_cpucache_start). Blocks
+ * in a cache count as live, and the calls a cache served only as cache_*.
+ */
+struct mm_stats {
+    uint64_t heap_bytes;     /* bytes from the heap start to the epilogue */
+    uint64_t live_bytes;     /* allocated blocks */
+    uint64_t free_bytes;     /* free blocks... */
+    uint64_t free_blocks;    /* ...and how many there are */
+    uint64_t class_free[MM_SIZECLASSES]; /* free_bytes of each seg list */
+    uint64_t nmalloc;        /* malloc, calloc and memalign calls */
+    uint64_t nfree;          /* free calls(not counting free(NULL)) */
+    uint64_t nrealloc;       /* realloc calls */
+    uint64_t ncoalesce;      /* frees merged with a neighbouring block */
+    uint64_t nsplit;         /* free blocks split by place */
+    uint64_t nextend;        /* extend_heap calls... */
+    uint64_t extend_bytes;   /* ...and the bytes they added */
+    uint64_t nsearch;        /* find_fit calls... */
+    uint64_t search_steps;   /* ...free blocks they looked at... */
+    uint64_t search_max;     /* ...the most in one call... */
+    uint64_t search_misses;  /* ...and calls that found nothing */
+    uint64_t numa_nodes;     /* NUMA nodes with their own seg lists */
+    uint64_t remote_frees;   /* frees of a block of another node... */
+    uint64_t remote_fits;    /* ...and mallocs that had to take one */
+    uint64_t cache_mallocs;  /* mallocs a cache served(about: a few may */
+    uint64_t cache_frees;    /* be lost)... and frees it kept */
+    uint64_t cache_bytes;    /* blocks in the caches now */
+    uint64_t cache_tables;   /* bytes of the caches themselves */
+};
+extern void mm_stats(struct mm_stats *st);
+
+/*
+ * mallctl-like access by name: "stats.<field>" for every field above,
+ * "stats.class.<i>.free_bytes", and "build_id"(a const char *) are read
+ * through oldp and oldlenp; writing anything to "stats.reset" zeroes the
+ * counters. Returns 0, ENOENT for an unknown name, EINVAL if *oldlenp
+ * is not the size of the value, EPERM for writing a read-only name.
+ */
+extern int mm_ctl(const char *name, void *oldp, size_t *oldlenp,
+                  void *newp, size_t newlen);
+
+/*
+ * Sampling heap profiler: about one allocation per sample_bytes gets
+ * its stack recorded until it is freed. mm_prof_dump writes what is
+ * live(and all that was sampled) in pprof's legacy heap format.
+ */
+extern int mm_prof_start(size_t sample_bytes);
+extern void mm_prof_stop(void);
+extern int mm_prof_dump(int fd);
+
+/*
+ * Sampled guard pages: about one allocation per sample_bytes(of up to a
+ * page) gets a page to itself, ending at an inaccessible page; freed
+ * ones are made inaccessible and quarantined. Overflows and uses after
+ * free then fault and are reported with the malloc and free stacks.
+ * Unsampled calls only pay the decrement of the countdown they share
+ * with the profiler.
+ */
+extern int mm_guard_start(size_t sample_bytes, size_t nslots);
+extern void mm_guard_stop(void);
+extern int mm_guard_owns(const void *ptr);
+
+/*
+ * NUMA: on a machine with several nodes(/sys/devices/system/node, or
+ * MM_NUMA_FAKE set to one cpulist per node, e.g. "0-3 4-7") each node
+ * has its own seg lists, fed by heap pages bound to it. A thread
+ * allocates from the lists of its CPU's node, or of the node
+ * mm_numa_set_node gave it(-1 goes back to the CPU's); frees go to the
+ * lists of the block's node. mm_numa_nodes says how many there are;
+ * only a build with MM_THREADSAFE has more than one.
+ */
+extern int mm_numa_nodes(void);
+extern int mm_numa_set_node(int node);
+
+/*
+ * Small-block caches in front of the seg lists: mm_cpucache_start gives
+ * every CPU a cache of up to about bytes of blocks for requests of up to
+ * MM_CACHEMAXSIZE bytes, which malloc and free use without the heap
+ * lock(through rseq: a thread that is moved or preempted mid-way starts
+ * over). Its tables take the same memory however many threads there
+ * are. Without rseq(or with MM_RSEQ=0) each thread gets a cache instead.
+ * Returns 1 for CPU caches, 0 for thread caches, -1 if bytes is 0 or
+ * there is no memory for them. mm_cpucache_stop gives the cached blocks
+ * back to the seg lists; like mm_init, it must not run alongside any
+ * other call.
+ */
+#define MM_CACHEMAXSIZE 256
+extern int mm_cpucache_start(size_t bytes);
+extern void mm_cpucache_stop(void);
+
+/*
+ * Heap map for offline pictures of fragmentation: mm_dump_heapmap
+ * writes a mm_heapmap_hdr_t, nblocks mm_heapmap_block_t in address
+ * order, then one MM_PAGE_* byte for each page of the heap.
+ */
+#define MM_HEAPMAP_MAGIC    "MMHEAPMP"
+#define MM_HEAPMAP_VERSION  1
+#define MM_PAGE_RESIDENT    0x1  /* in memory(mincore) */
+#define MM_PAGE_FREE        0x2  /* inside the unused part of a free block */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint64_t heap_base;      /* address of the first heap byte */
+    uint64_t heap_bytes;
+    uint64_t nblocks;
+    uint64_t npages;
+} mm_heapmap_hdr_t;
+typedef struct {
+    uint64_t offset;         /* of the block header from heap_base */
+    uint32_t size;           /* whole block, header and footer included */
+    uint8_t is_free;
+    uint8_t list;            /* seg list of a free block, 0xff if allocated */
+    uint16_t pad;
+} mm_heapmap_block_t;
+extern int mm_dump_heapmap(int fd);
+
+/* Region (bump) allocation: many short-lived objects released at once */
+typedef struct mm_region mm_region_t;
+extern mm_region_t *mm_region_create(size_t chunksize);
+extern void *mm_region_alloc(mm_region_t *region, size_t size);
+extern void mm_region_destroy(mm_region_t *region);
+
+/* Fixed-size object pools: O(1) get/put for one object size */
+typedef struct mm_pool mm_pool_t;
+extern mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+extern void *mm_pool_get(mm_pool_t *pool);
+extern void mm_pool_put(mm_pool_t *pool, void *obj);
+extern void mm_pool_destroy(mm_pool_t *pool);
+
+/* Identifies the allocator build (hash of the mm.c source) in reports */
+extern const char *mm_build_id(void);
+
+/*
+ * Heap consistency checks. mm_check returns the first problem found
+ * (MM_CHECK_OK if none) and, if err is not NULL, where it was found.
+ * MM_CHECK_FULL checks every block and seg list, walking the heap with
+ * nthreads threads; MM_CHECK_INCREMENTAL only checks the blocks changed
+ * since the previous call(the first call is a full one).
+ */
+enum {
+    MM_CHECK_OK = 0,
+    MM_CHECK_PROLOGUE,     /* prologue block is damaged */
+    MM_CHECK_EPILOGUE,     /* epilogue is damaged or not where expected */
+    MM_CHECK_BOUNDS,       /* block lies(partly) outside the heap */
+    MM_CHECK_ALIGNMENT,    /* payload is not 8 byte aligned */
+    MM_CHECK_SIZE,         /* block is smaller than the minimum block */
+    MM_CHECK_HDR_FTR,      /* header and footer differ */
+    MM_CHECK_COALESCE,     /* two free blocks next to each other */
+    MM_CHECK_LIST_ALLOC,   /* allocated block on a free list */
+    MM_CHECK_LIST_CLASS,   /* free block on the wrong seg list */
+    MM_CHECK_LIST_LINKS,   /* next/prev links of a free list disagree */
+    MM_CHECK_LIST_CYCLE,   /* a free list loops */
+    MM_CHECK_FREE_COUNT,   /* free blocks in the heap != on the lists */
+    MM_CHECK_NCODES
+};
+#define MM_CHECK_FULL        0
+#define MM_CHECK_INCREMENTAL 1
+typedef struct {
+    int code;              /* one of MM_CHECK_* */
+    void *bp;              /* block where it was found, NULL if none */
+    int list;              /* seg list involved, -1 if none */
+} mm_check_error_t;
+extern int mm_check(int mode, int nthreads, mm_check_error_t *err);
+extern const char *mm_check_strerror(int code);
+
+/* Prints the heap(verbose > 1) and whatever mm_check finds wrong */
+extern void mm_checkheap(int verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MM_H_ */
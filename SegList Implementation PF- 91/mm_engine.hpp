@@ -0,0 +1,409 @@
+/*
+ * mm_engine.hpp - The seg list allocator as a compile-time configured template
+ *
+ * mm::engine<Policy> is the algorithm of mm.c(boundary tags, segregated
+ * explicit free lists, immediate coalescing, splitting) with every knob
+ * that mm.c hard-codes as a #define taken from the policy instead:
+ *
+ *   Policy::classes     size classes: index(asize) and nlists
+ *                       (pow2_classes, quarter_classes)
+ *   Policy::fit         how a list is searched(first_fit, best_of<K>)
+ *   Policy::growth      how much to mem_sbrk when nothing fits
+ *                       (tail_growth<Chunk>, chunk_growth<Chunk>)
+ *   Policy::tag         header/footer word: std::uint32_t or std::uint64_t
+ *   Policy::alignment   payload alignment, a power of 2 of at least 8
+ *
+ * They are all types and constants, so each instantiation is compiled
+ * on its own and inlined through; nothing looks at the configuration at
+ * run time. The heap comes from memlib like mm.c's. An engine is not
+ * thread-safe and, like mm.c, owns the whole memlib heap once init() is
+ * called.
+ *
+ * engine<default_policy> is not mm.c: it places every block where mm.c
+ * would, but it differs from it on purpose in these ways:
+ *
+ *   - The list heads are a member array, not the first 28*8 bytes of the
+ *     heap, and the heap starts with only a prologue footer and the
+ *     epilogue header rather than mm.c's padding word and 8-byte
+ *     prologue block. Each heap is thus 232 bytes smaller than mm.c's,
+ *     which shows in the utilization of small traces(malloc.rep: 86% vs
+ *     76%) and hardly in that of big ones.
+ *   - The last list takes every bigger size, where mm.c fails requests
+ *     beyond its last list(over 4 GB).
+ *   - Only malloc, free and realloc: no calloc, memalign, checker,
+ *     statistics, caches, sampling, NUMA, regions or pools.
+ *
+ * C entry points for a policy are stamped out with MM_ENGINE_ENTRY_POINTS
+ * (mm_variants.cc does this for the variants mdriver -a knows):
+ *
+ *     struct my_policy : mm::default_policy { using fit = mm::best_of<8>; };
+ *     MM_ENGINE_ENTRY_POINTS(my, my_policy)    // mm_my_init, mm_my_malloc...
+ */
+#ifndef __MM_ENGINE_HPP_
+#define __MM_ENGINE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "memlib.h"
+
+namespace mm {
+
+/*
+ * Size classes: list 0 holds blocks of up to Min bytes, list i those of
+ * up to Min << i; the last list takes everything bigger(mm.c's scheme)
+ */
+template <std::size_t Min, int NLists>
+struct pow2_classes
+{
+    static constexpr int nlists = NLists;
+
+    static int index(std::size_t asize)
+    {
+        int i;
+
+        if (asize <= Min)
+            return 0;
+        i = 64 - __builtin_clzll((asize - 1) / Min);
+        return i < NLists ? i : NLists - 1;
+    }
+};
+
+/*
+ * Size classes four to a power of two above 4*Min(so a list's blocks
+ * are within 25% of each other), one per multiple of Min below that
+ */
+template <std::size_t Min, int NLists>
+struct quarter_classes
+{
+    static constexpr int nlists = NLists;
+
+    static int index(std::size_t asize)
+    {
+        std::size_t q;
+        int lg, i;
+
+        if (asize <= Min)
+            return 0;
+        q = (asize - 1) / Min;
+        if (q < 4)
+            return q;
+        lg = 63 - __builtin_clzll(q);
+        i = 4*(lg - 1) + ((q >> (lg - 2)) & 3);
+        return i < NLists ? i : NLists - 1;
+    }
+};
+
+/* Take the first block that fits in the first list that has one */
+struct first_fit
+{
+    static constexpr int candidates = 1;
+};
+
+/* Look at up to K blocks that fit in a list and take the smallest */
+template <int K>
+struct best_of
+{
+    static constexpr int candidates = K;
+};
+
+/*
+ * Grow by what the free block at the end of the heap lacks, or by at
+ * least Chunk if the last block is allocated(mm.c's scheme)
+ */
+template <std::size_t Chunk>
+struct tail_growth
+{
+    static constexpr std::size_t initial = Chunk;
+
+    static std::size_t extend(std::size_t asize, std::size_t tail_free)
+    {
+        if (tail_free > 0)
+            return asize - tail_free;
+        return asize > Chunk ? asize : Chunk;
+    }
+};
+
+/* Always grow by at least Chunk, whatever is free at the end */
+template <std::size_t Chunk>
+struct chunk_growth
+{
+    static constexpr std::size_t initial = Chunk;
+
+    static std::size_t extend(std::size_t asize, std::size_t)
+    {
+        return asize > Chunk ? asize : Chunk;
+    }
+};
+
+/* mm.c's knobs(see above for how the engine still differs); derive
+   from it to change a knob or two */
+struct default_policy
+{
+    using classes = pow2_classes<32, 28>;
+    using fit = first_fit;
+    using growth = tail_growth<256>;
+    using tag = std::uint32_t;
+    static constexpr std::size_t alignment = 8;
+};
+
+template <typename Policy>
+class engine
+{
+public:
+    /* Start a new heap at memlib's break; returns -1 if out of memory */
+    int init()
+    {
+        char *p;
+        std::size_t pad;
+        int i;
+
+        for (i = 0; i < classes::nlists; i++)
+            heads_[i] = nullptr;
+        p = static_cast<char *>(mem_sbrk(0));
+        pad = -(std::uintptr_t)(p + first_payload) & (A - 1);
+        if ((p = static_cast<char *>(mem_sbrk(pad + first_payload))) ==
+            (char *)-1)
+            return -1;
+        epilogue_ = p + pad + first_payload;
+        tag_at(epilogue_ - 2*T) = 1;        /* prologue footer */
+        tag_at(epilogue_ - T) = 1;          /* epilogue header */
+        return extend(round(growth::initial)) == nullptr ? -1 : 0;
+    }
+
+    void *malloc(std::size_t size)
+    {
+        std::size_t asize, tail;
+        char *bp;
+
+        if (size == 0)
+            return nullptr;
+        asize = adjust(size);
+        if ((bp = find_fit(asize)) == nullptr)
+        {
+            tail = is_alloc_tag(tag_at(epilogue_ - 2*T)) ? 0 :
+                   size_of_tag(tag_at(epilogue_ - 2*T));
+            if ((bp = extend(round(growth::extend(asize, tail)))) == nullptr)
+                return nullptr;
+        }
+        place(bp, asize);
+        return bp;
+    }
+
+    void free(void *ptr)
+    {
+        char *bp = static_cast<char *>(ptr);
+
+        if (bp == nullptr)
+            return;
+        set(bp, block_size(bp), false);
+        coalesce(bp);
+    }
+
+    /* mm.c's realloc: keep the block if malloc would give this size */
+    void *realloc(void *ptr, std::size_t size)
+    {
+        std::size_t asize, oldsize;
+        void *newptr;
+
+        if (size == 0)
+        {
+            free(ptr);
+            return nullptr;
+        }
+        if (ptr == nullptr)
+            return malloc(size);
+
+        asize = adjust(size);
+        oldsize = block_size(static_cast<char *>(ptr));
+        if (asize <= oldsize && oldsize - asize < min_block)
+            return ptr;
+        if ((newptr = malloc(size)) == nullptr)
+            return nullptr;
+        oldsize = usable_size(ptr);
+        std::memcpy(newptr, ptr, size < oldsize ? size : oldsize);
+        free(ptr);
+        return newptr;
+    }
+
+    std::size_t usable_size(void *ptr) const
+    {
+        return ptr ? block_size(static_cast<char *>(ptr)) - 2*T : 0;
+    }
+
+private:
+    using classes = typename Policy::classes;
+    using fit = typename Policy::fit;
+    using growth = typename Policy::growth;
+    using word = typename Policy::tag;
+
+    static constexpr std::size_t A = Policy::alignment;
+    static constexpr std::size_t T = sizeof(word);
+    static_assert(A >= 8 && (A & (A - 1)) == 0,
+                  "alignment must be a power of 2 of at least 8");
+    static_assert(fit::candidates >= 1, "a fit must look at a block");
+
+    /* Prologue footer and epilogue header come before the first block */
+    static constexpr std::size_t first_payload = (2*T + A - 1) & ~(A - 1);
+    /* Header, next and prev links, footer */
+    static constexpr std::size_t min_block =
+        (2*T + 2*sizeof(char *) + A - 1) & ~(A - 1);
+
+    static std::size_t round(std::size_t n) { return (n + A - 1) & ~(A - 1); }
+
+    /* Tags: the size with the allocated bit in bit 0 */
+    static word &tag_at(char *p) { return *reinterpret_cast<word *>(p); }
+    static std::size_t size_of_tag(word w) { return w & ~word(7); }
+    static bool is_alloc_tag(word w) { return w & 1; }
+
+    static word &header(char *bp) { return tag_at(bp - T); }
+    static std::size_t block_size(char *bp) { return size_of_tag(header(bp)); }
+    static word &footer(char *bp) { return tag_at(bp + block_size(bp) - 2*T); }
+    static char *next_block(char *bp) { return bp + block_size(bp); }
+    static char *prev_block(char *bp)
+    {
+        return bp - size_of_tag(tag_at(bp - 2*T));
+    }
+    static void set(char *bp, std::size_t size, bool alloc)
+    {
+        header(bp) = size | alloc;
+        footer(bp) = size | alloc;
+    }
+
+    /* Free list links in the first two words of the payload */
+    static char *&next_free(char *bp) { return *reinterpret_cast<char **>(bp); }
+    static char *&prev_free(char *bp)
+    {
+        return *reinterpret_cast<char **>(bp + sizeof(char *));
+    }
+
+    static std::size_t adjust(std::size_t size)
+    {
+        std::size_t asize = round(size + 2*T);
+        return asize < min_block ? min_block : asize;
+    }
+
+    void insert(char *bp)
+    {
+        char **head = &heads_[classes::index(block_size(bp))];
+
+        next_free(bp) = *head;
+        prev_free(bp) = nullptr;
+        if (*head != nullptr)
+            prev_free(*head) = bp;
+        *head = bp;
+    }
+
+    void remove(char *bp)
+    {
+        if (prev_free(bp) != nullptr)
+            next_free(prev_free(bp)) = next_free(bp);
+        else
+            heads_[classes::index(block_size(bp))] = next_free(bp);
+        if (next_free(bp) != nullptr)
+            prev_free(next_free(bp)) = prev_free(bp);
+    }
+
+    char *find_fit(std::size_t asize)
+    {
+        char *bp, *best;
+        int i, found;
+
+        for (i = classes::index(asize); i < classes::nlists; i++)
+        {
+            best = nullptr;
+            found = 0;
+            for (bp = heads_[i]; bp != nullptr; bp = next_free(bp))
+            {
+                if (block_size(bp) < asize)
+                    continue;
+                if (best == nullptr || block_size(bp) < block_size(best))
+                    best = bp;
+                if (++found == fit::candidates)
+                    break;
+            }
+            if (best != nullptr)
+                return best;
+        }
+        return nullptr;
+    }
+
+    /* Take bytes more heap as a free block; returns it after coalescing */
+    char *extend(std::size_t bytes)
+    {
+        char *bp;
+
+        if ((bp = static_cast<char *>(mem_sbrk(bytes))) == (char *)-1)
+            return nullptr;
+        /* The old epilogue header becomes the new block's header */
+        set(bp, bytes, false);
+        epilogue_ = bp + bytes;
+        header(epilogue_) = 1;
+        return coalesce(bp);
+    }
+
+    char *coalesce(char *bp)
+    {
+        std::size_t size = block_size(bp);
+        bool prev_alloc = is_alloc_tag(tag_at(bp - 2*T));
+        bool next_alloc = is_alloc_tag(header(next_block(bp)));
+
+        if (!next_alloc)
+        {
+            remove(next_block(bp));
+            size += block_size(next_block(bp));
+        }
+        if (!prev_alloc)
+        {
+            bp = prev_block(bp);
+            remove(bp);
+            size += block_size(bp);
+        }
+        set(bp, size, false);
+        insert(bp);
+        return bp;
+    }
+
+    void place(char *bp, std::size_t asize)
+    {
+        std::size_t csize = block_size(bp);
+
+        remove(bp);
+        if (csize - asize >= min_block)
+        {
+            set(bp, asize, true);
+            set(bp + asize, csize - asize, false);
+            insert(bp + asize);
+        }
+        else
+            set(bp, csize, true);
+    }
+
+    char *heads_[classes::nlists];
+    char *epilogue_;    /* payload address of the epilogue pseudo-block */
+};
+
+} /* namespace mm */
+
+/* extern "C" mm_<name>_init/malloc/free/realloc on an engine<policy> */
+#define MM_ENGINE_ENTRY_POINTS(name, policy)                            \
+    static mm::engine<policy> mm_engine_##name;                         \
+    extern "C" int mm_##name##_init(void)                               \
+    {                                                                   \
+        return mm_engine_##name.init();                                 \
+    }                                                                   \
+    extern "C" void *mm_##name##_malloc(size_t size)                    \
+    {                                                                   \
+        return mm_engine_##name.malloc(size);                           \
+    }                                                                   \
+    extern "C" void mm_##name##_free(void *ptr)                         \
+    {                                                                   \
+        mm_engine_##name.free(ptr);                                     \
+    }                                                                   \
+    extern "C" void *mm_##name##_realloc(void *ptr, size_t size)        \
+    {                                                                   \
+        return mm_engine_##name.realloc(ptr, size);                     \
+    }
+
+#endif /* __MM_ENGINE_HPP_ */
@@ -0,0 +1,61 @@
+/*
+ * mm_pool.hpp - C++ wrapper around the fixed-size object pools in mm.c
+ *
+ * mm::pool<T> takes raw objects from an mm_pool_t and constructs T in
+ * place, so that a type that is churned at a high rate never goes
+ * through the general purpose find_fit.
+ *
+ *     mm::pool<session> sessions;
+ *     session *s = sessions.create(fd, peer);
+ *     ...
+ *     sessions.destroy(s);
+ */
+#ifndef __MM_POOL_HPP_
+#define __MM_POOL_HPP_
+
+#include <new>
+#include <utility>
+
+#include "mm.h"
+
+namespace mm {
+
+template <typename T>
+class pool
+{
+public:
+    pool() : pool_(mm_pool_create(sizeof(T), alignof(T))) {}
+    ~pool() { mm_pool_destroy(pool_); }
+
+    pool(const pool &) = delete;
+    pool &operator=(const pool &) = delete;
+
+    /* Returns false if the pool could not be created */
+    explicit operator bool() const { return pool_ != nullptr; }
+
+    /* Construct a T in a pooled object; nullptr if out of memory */
+    template <typename... Args>
+    T *create(Args &&... args)
+    {
+        void *obj = mm_pool_get(pool_);
+        if (obj == nullptr)
+            return nullptr;
+        return new (obj) T(std::forward<Args>(args)...);
+    }
+
+    /* Destroy a T made by create() and give its object back */
+    void destroy(T *obj)
+    {
+        if (obj == nullptr)
+            return;
+        obj->~T();
+        mm_pool_put(pool_, obj);
+    }
+
+private:
+    mm_pool_t *pool_;
+};
+
+} /* namespace mm */
+
+#endif /* __MM_POOL_HPP_ */
@@ -0,0 +1,168 @@
+/*
+ * mm_resource.hpp - Point C++ containers at the mm.c heap
+ *
+ * No global interpositioning is needed; only the containers that are
+ * handed one of these use the seg list heap:
+ *
+ *   mm::memory_resource   std::pmr::memory_resource on mm_malloc/mm_free
+ *                         (mm::heap_resource() returns a shared one)
+ *   mm::region_resource   monotonic std::pmr::memory_resource on a region:
+ *                         deallocate is a no-op, release() frees it all
+ *   mm::allocator<T>      stateless allocator for std::vector,
+ *                         std::unordered_map, ...
+ *
+ * Alignments above the heap's 8 bytes go through mm_memalign. Sized
+ * deallocation needs nothing extra: the block header knows the size.
+ */
+#ifndef __MM_RESOURCE_HPP_
+#define __MM_RESOURCE_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+#include "mm.h"
+
+namespace mm {
+
+/* Alignment of every payload mm_malloc returns */
+constexpr std::size_t heap_alignment = 8;
+
+/* Allocate bytes from the heap with the given alignment; throws if out */
+inline void *allocate_bytes(std::size_t bytes, std::size_t align)
+{
+    void *p;
+
+    if (bytes == 0)
+        bytes = 1;
+    if (align <= heap_alignment)
+        p = mm_malloc(bytes);
+    else
+        p = mm_memalign(align, bytes);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+class memory_resource : public std::pmr::memory_resource
+{
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        return allocate_bytes(bytes, align);
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t) override
+    {
+        mm_free(p);
+    }
+
+    /* Every instance hands out memory from the same heap */
+    bool do_is_equal(const std::pmr::memory_resource &other)
+        const noexcept override
+    {
+        return dynamic_cast<const memory_resource *>(&other) != nullptr;
+    }
+};
+
+inline memory_resource *heap_resource()
+{
+    static memory_resource resource;
+    return &resource;
+}
+
+class region_resource : public std::pmr::memory_resource
+{
+public:
+    /* chunksize is passed to mm_region_create(0 for its default) */
+    explicit region_resource(std::size_t chunksize = 0)
+        : chunksize_(chunksize), region_(nullptr) {}
+    ~region_resource() { release(); }
+
+    region_resource(const region_resource &) = delete;
+    region_resource &operator=(const region_resource &) = delete;
+
+    /* Free everything allocated so far; the resource stays usable */
+    void release()
+    {
+        mm_region_destroy(region_);
+        region_ = nullptr;
+    }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        char *p;
+
+        if (region_ == nullptr &&
+            (region_ = mm_region_create(chunksize_)) == nullptr)
+            throw std::bad_alloc();
+
+        if (bytes == 0)
+            bytes = 1;
+        if (align <= heap_alignment)
+            p = static_cast<char *>(mm_region_alloc(region_, bytes));
+        else
+            p = static_cast<char *>(
+                mm_region_alloc(region_, bytes + align - heap_alignment));
+        if (p == nullptr)
+            throw std::bad_alloc();
+
+        if (align > heap_alignment)
+            p = reinterpret_cast<char *>(
+                (reinterpret_cast<std::size_t>(p) + align - 1) & ~(align - 1));
+        return p;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other)
+        const noexcept override
+    {
+        return this == &other;
+    }
+
+private:
+    std::size_t chunksize_;
+    mm_region_t *region_;
+};
+
+template <typename T>
+class allocator
+{
+public:
+    using value_type = T;
+
+    allocator() noexcept = default;
+    template <typename U>
+    allocator(const allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+        return static_cast<T *>(allocate_bytes(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept
+    {
+        mm_free(p);
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const allocator<T> &, const allocator<U> &) noexcept
+{
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const allocator<T> &, const allocator<U> &) noexcept
+{
+    return false;
+}
+
+} /* namespace mm */
+
+#endif /* __MM_RESOURCE_HPP_ */
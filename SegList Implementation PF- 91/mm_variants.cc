@@ -0,0 +1,37 @@
+/*
+ * mm_variants.cc - The mm::engine instantiations that mdriver -a offers
+ *
+ * To try another configuration, add a policy here and a line to
+ * MM_VARIANTS in mm_variants.h.
+ */
+#include "mm_engine.hpp"
+#include "mm_variants.h"
+
+struct eng_policy : mm::default_policy
+{
+};
+
+struct eng_best8_policy : mm::default_policy
+{
+    using fit = mm::best_of<8>;
+};
+
+struct eng_quarter_policy : mm::default_policy
+{
+    using classes = mm::quarter_classes<32, 80>;
+};
+
+struct eng_chunk4k_policy : mm::default_policy
+{
+    using growth = mm::chunk_growth<4096>;
+};
+
+struct eng_a16_policy : mm::default_policy
+{
+    using tag = std::uint64_t;
+    static constexpr std::size_t alignment = 16;
+};
+
+#define MM_VARIANT_DEFINE(name, desc) \
+    MM_ENGINE_ENTRY_POINTS(name, name##_policy)
+MM_VARIANTS(MM_VARIANT_DEFINE)
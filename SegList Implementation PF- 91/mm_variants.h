@@ -0,0 +1,35 @@
+/*
+ * mm_variants.h - C entry points of the mm::engine instantiations
+ *
+ * Each X(name, description) in MM_VARIANTS has mm_<name>_init, _malloc,
+ * _free and _realloc, defined in mm_variants.cc from <name>_policy.
+ */
+#ifndef __MM_VARIANTS_H_
+#define __MM_VARIANTS_H_
+
+#include <stddef.h>
+
+#define MM_VARIANTS(X)                                                   \
+    X(eng, "mm::engine, default policy(pow2 lists, first fit)")          \
+    X(eng_best8, "same, best of 8 fits per list")                       \
+    X(eng_quarter, "same, 4 lists per power of 2")                       \
+    X(eng_chunk4k, "same, grows by 4 KB whatever is free at the end")   \
+    X(eng_a16, "same, 16 byte alignment and 8 byte tags")
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MM_VARIANT_DECLARE(name, desc)                                   \
+    int mm_##name##_init(void);                                          \
+    void *mm_##name##_malloc(size_t size);                               \
+    void mm_##name##_free(void *ptr);                                    \
+    void *mm_##name##_realloc(void *ptr, size_t size);
+MM_VARIANTS(MM_VARIANT_DECLARE)
+#undef MM_VARIANT_DECLARE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MM_VARIANTS_H_ */
@@ -0,0 +1,330 @@
+/*
+ * mmcap2rep.c - Convert a libmmcapture.so log into a trace
+ *
+ *     unix> ./mmcap2rep [-b] [-w <weight>] -o <out> <log>
+ *
+ * writes a .rep trace, or with -b a binary one (see trace.h). The log
+ * records are put back in call order and every block gets the next id
+ * when it is allocated, so ids are dense from 0. Frees and reallocs of
+ * blocks allocated before the capture started are left out, or turned
+ * into allocations, since the trace never saw those blocks. So are
+ * zero-byte allocations, which mm_malloc answers with NULL. A realloc's
+ * block leaves the address map at its CAP_MOVE record, so another
+ * thread's malloc that gets the old address before the realloc record
+ * is a block of its own.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mmcapture.h"
+#include "trace.h"
+
+/*
+ * Hash from live block addresses to their ids, with linear probing
+ * and backward-shift removal like idmap.c
+ */
+typedef struct {
+    uint64_t ptr;  /* 0 if the slot is empty */
+    int id;
+} ptrslot_t;
+
+static ptrslot_t *slots;
+static size_t mask, count;
+
+static size_t ptr_hash(uint64_t ptr)
+{
+    return ((ptr >> 3) * 0x9e3779b97f4a7c15ULL >> 20) & mask;
+}
+
+static ptrslot_t *ptr_find(uint64_t ptr)
+{
+    size_t i;
+
+    for (i = ptr_hash(ptr); slots[i].ptr != 0; i = (i + 1) & mask)
+        if (slots[i].ptr == ptr)
+            return &slots[i];
+    return NULL;
+}
+
+static void ptr_add(uint64_t ptr, int id)
+{
+    ptrslot_t *old = slots;
+    size_t i, j, oldslots = mask + 1;
+
+    if (2 * (count + 1) > mask + 1) {
+        if ((slots = calloc(2 * oldslots, sizeof(*slots))) == NULL) {
+            perror("mmcap2rep");
+            exit(1);
+        }
+        mask = 2 * oldslots - 1;
+        for (j = 0; j < oldslots; j++) {
+            if (old[j].ptr == 0)
+                continue;
+            for (i = ptr_hash(old[j].ptr); slots[i].ptr != 0;
+                 i = (i + 1) & mask)
+                ;
+            slots[i] = old[j];
+        }
+        free(old);
+    }
+    for (i = ptr_hash(ptr); slots[i].ptr != 0; i = (i + 1) & mask)
+        ;
+    slots[i].ptr = ptr;
+    slots[i].id = id;
+    count++;
+}
+
+static void ptr_remove(ptrslot_t *s)
+{
+    size_t hole = s - slots;
+    size_t i, home;
+
+    for (i = (hole + 1) & mask; slots[i].ptr != 0; i = (i + 1) & mask) {
+        home = ptr_hash(slots[i].ptr);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole].ptr = 0;
+    count--;
+}
+
+static int by_seq(const void *a, const void *b)
+{
+    uint64_t x = CAP_SEQ((const caprec_t *)a);
+    uint64_t y = CAP_SEQ((const caprec_t *)b);
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * find_seq - The record with sequence number seq in the sorted
+ *     recs[0..n), or NULL
+ */
+static caprec_t *find_seq(caprec_t *recs, size_t n, uint64_t seq)
+{
+    size_t lo = 0, hi = n, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (CAP_SEQ(&recs[mid]) < seq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return (lo < n && CAP_SEQ(&recs[lo]) == seq) ? &recs[lo] : NULL;
+}
+
+/*
+ * convert - Turn the sorted records into trace ops; returns the number
+ *     of ops and sets *num_ids. Each CAP_MOVE record is left holding
+ *     the id of the block it took out of the map, plus one(0: none),
+ *     in its old field for its CAP_REALLOC.
+ */
+static size_t convert(caprec_t *recs, size_t n, traceop_t *ops,
+                      int *num_ids)
+{
+    caprec_t *r, *m;
+    ptrslot_t *s;
+    size_t i, nops = 0;
+    int ids = 0;
+
+    mask = 1023;
+    count = 0;
+    if ((slots = calloc(mask + 1, sizeof(*slots))) == NULL) {
+        perror("mmcap2rep");
+        exit(1);
+    }
+
+    for (i = 0; i < n; i++) {
+        r = &recs[i];
+        switch (CAP_TYPE(r)) {
+        case CAP_FREE:
+            if ((s = ptr_find(r->ptr)) == NULL)
+                break;
+            ops[nops].type = FREE;
+            ops[nops].index = s->id;
+            ops[nops++].size = 0;
+            ptr_remove(s);
+            break;
+
+        case CAP_MOVE:
+            r->old = 0;
+            if ((s = ptr_find(r->ptr)) != NULL) {
+                r->old = (uint64_t)s->id + 1;
+                ptr_remove(s);
+            }
+            break;
+
+        case CAP_REALLOC:
+            m = (r->old != 0) ? find_seq(recs, i, r->old) : NULL;
+            if (m != NULL && CAP_TYPE(m) == CAP_MOVE && m->old != 0) {
+                ops[nops].index = m->old - 1;
+                if (r->ptr == 0 && r->size != 0) { /* failed: unchanged */
+                    ptr_add(m->ptr, ops[nops].index);
+                    break;
+                }
+                if (r->ptr == 0 || r->size == 0) { /* realloc(p, 0) */
+                    ops[nops].type = FREE;
+                    ops[nops++].size = 0;
+                    break;
+                }
+                ops[nops].type = REALLOC;
+                ops[nops].size = r->size;
+            } else {
+                if (r->ptr == 0 || r->size == 0)
+                    break;
+                ops[nops].type = ALLOC;
+                ops[nops].index = ids++;
+                ops[nops].size = r->size;
+            }
+            goto add;
+
+        default:
+            if (r->size == 0)
+                break;
+            ops[nops].type = ALLOC;
+            ops[nops].index = ids++;
+            ops[nops].size = r->size;
+        add:
+            /* A block given up without a record(say, by a realloc
+               whose CAP_MOVE was not logged) may be handed out again;
+               it is gone by now */
+            if ((s = ptr_find(r->ptr)) != NULL) {
+                ops[nops + 1] = ops[nops];
+                ops[nops].type = FREE;
+                ops[nops].index = s->id;
+                ops[nops++].size = 0;
+                ptr_remove(s);
+            }
+            ptr_add(r->ptr, ops[nops].index);
+            nops++;
+            break;
+        }
+    }
+    free(slots);
+    *num_ids = ids;
+    return nops;
+}
+
+static void write_text(FILE *out, const traceop_t *ops, size_t nops,
+                       int weight, int num_ids)
+{
+    size_t i;
+
+    fprintf(out, "%d\n%d\n%lu\n%d\n", weight, num_ids, (unsigned long)nops, 0);
+    for (i = 0; i < nops; i++) {
+        if (ops[i].type == FREE)
+            fprintf(out, "f %d\n", ops[i].index);
+        else
+            fprintf(out, "%c %d %lu\n", ops[i].type == ALLOC ? 'a' : 'r',
+                    ops[i].index, (unsigned long)ops[i].size);
+    }
+}
+
+static void write_binary(FILE *out, const traceop_t *ops, size_t nops,
+                         int weight, int num_ids)
+{
+    tracehdr_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGICLEN);
+    hdr.version = TRACE_VERSION;
+    hdr.weight = weight;
+    hdr.num_ids = num_ids;
+    hdr.ignore_ranges = 0;
+    hdr.num_ops = nops;
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    fwrite(ops, sizeof(*ops), nops, out);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: mmcap2rep [-b] [-w <weight>] -o <out> <log>\n"
+            "\t-b         Write a binary trace instead of a .rep.\n"
+            "\t-w <w>     Trace weight (default 0).\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *outname = NULL;
+    caprec_t *recs;
+    traceop_t *ops;
+    struct stat st;
+    FILE *out;
+    size_t n, nops;
+    int c, fd, num_ids;
+    int binary = 0, weight = 0;
+
+    while ((c = getopt(argc, argv, "bw:o:h")) != EOF) {
+        switch (c) {
+        case 'b':
+            binary = 1;
+            break;
+        case 'w':
+            weight = atoi(optarg);
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        default:
+            usage();
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+    if (outname == NULL || optind != argc - 1 || weight < 0 || weight > 3) {
+        usage();
+        exit(1);
+    }
+
+    /* Sort a private copy of the log by sequence number */
+    if ((fd = open(argv[optind], O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        perror(argv[optind]);
+        exit(1);
+    }
+    if ((n = st.st_size / sizeof(caprec_t)) == 0) {
+        fprintf(stderr, "%s: empty log\n", argv[optind]);
+        exit(1);
+    }
+    recs = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (recs == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    close(fd);
+    qsort(recs, n, sizeof(*recs), by_seq);
+
+    /* Every record gives at most two ops */
+    if ((ops = malloc((2 * n + 1) * sizeof(*ops))) == NULL) {
+        perror("mmcap2rep");
+        exit(1);
+    }
+    nops = convert(recs, n, ops, &num_ids);
+    if (num_ids == 0) {
+        fprintf(stderr, "%s: no allocations captured\n", argv[optind]);
+        exit(1);
+    }
+
+    if ((out = fopen(outname, "w")) == NULL) {
+        perror(outname);
+        exit(1);
+    }
+    if (binary)
+        write_binary(out, ops, nops, weight, num_ids);
+    else
+        write_text(out, ops, nops, weight, num_ids);
+    if (fclose(out) != 0) {
+        perror(outname);
+        exit(1);
+    }
+
+    printf("%s: %lu ops, %d ids\n", outname, (unsigned long)nops, num_ids);
+    return 0;
+}
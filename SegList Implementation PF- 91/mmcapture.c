@@ -0,0 +1,280 @@
+/*
+ * mmcapture.c - LD_PRELOAD shim that logs the malloc calls of a program
+ *
+ *     unix> LD_PRELOAD=./libmmcapture.so MMCAPTURE_FILE=app.raw app ...
+ *     unix> ./mmcap2rep -o app.rep app.raw
+ *
+ * malloc, calloc, realloc, free and the memalign family are passed on
+ * to glibc's own entry points and logged as caprec_t records. The hot
+ * path takes no shared lock: each thread appends to its own buffer,
+ * under a lock of that buffer that nobody else takes until the exit
+ * flush, and the only shared write is one atomic add for the sequence
+ * number. A full buffer is written to the log with a single O_APPEND
+ * write. Block
+ * ids are not known here; mmcap2rep assigns them densely from the
+ * pointers when it converts the log.
+ *
+ * Calls made in a child after fork and after the log has been flushed
+ * at exit are not logged.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mmcapture.h"
+
+/* glibc's allocator, under the names it exports for this purpose */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+/* Records per thread buffer */
+#define CAP_BUFRECS 4096
+
+typedef struct capbuf {
+    struct capbuf *next, *prev;  /* registry of live buffers */
+    pthread_mutex_t lock;        /* held to append or flush */
+    int n;
+    caprec_t recs[CAP_BUFRECS];
+} capbuf_t;
+
+#define TLS __thread __attribute__((tls_model("initial-exec")))
+
+static TLS capbuf_t *mybuf;
+static TLS int in_capture;     /* don't log our own calls */
+static TLS int exited;         /* buffer gone, in later key destructors */
+
+static uint64_t seq = 1;       /* global sequence number */
+static int logfd = -1;
+static int off;                /* set in forked children and at exit */
+
+static pthread_key_t bufkey;
+static pthread_mutex_t reg_lock = PTHREAD_MUTEX_INITIALIZER;
+static capbuf_t *bufs;         /* all live buffers, under reg_lock; so
+                                  are writes straight to the log */
+
+static void flush(capbuf_t *b)
+{
+    ssize_t len = b->n * sizeof(caprec_t);
+
+    if (b->n > 0 && logfd >= 0 && write(logfd, b->recs, len) != len)
+        off = 1;
+    b->n = 0;
+}
+
+/*
+ * thread_exit - Flush and drop the buffer of an exiting thread. Key
+ *     destructors that run after this one may still allocate; record
+ *     writes their calls straight to the log
+ */
+static void thread_exit(void *arg)
+{
+    capbuf_t *b = arg;
+
+    mybuf = NULL;
+    exited = 1;
+    pthread_mutex_lock(&reg_lock);
+    if (b->prev != NULL)
+        b->prev->next = b->next;
+    else
+        bufs = b->next;
+    if (b->next != NULL)
+        b->next->prev = b->prev;
+    flush(b);
+    pthread_mutex_unlock(&reg_lock);
+    pthread_mutex_destroy(&b->lock);
+    munmap(b, sizeof(*b));
+}
+
+/*
+ * new_buf - Give the calling thread its buffer
+ */
+static capbuf_t *new_buf(void)
+{
+    capbuf_t *b;
+
+    b = mmap(NULL, sizeof(*b), PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b == MAP_FAILED)
+        return NULL;
+    pthread_mutex_init(&b->lock, NULL);
+    b->prev = NULL;
+    pthread_mutex_lock(&reg_lock);
+    b->next = bufs;
+    if (bufs != NULL)
+        bufs->prev = b;
+    bufs = b;
+    pthread_mutex_unlock(&reg_lock);
+    pthread_setspecific(bufkey, b);
+    return mybuf = b;
+}
+
+/*
+ * record - Log a call; returns its sequence number, 0 if not logged
+ */
+static uint64_t record(int type, void *ptr, uint64_t old, size_t size)
+{
+    capbuf_t *b = mybuf;
+    pthread_mutex_t *lock;
+    caprec_t one;
+    caprec_t *r = &one;
+    uint64_t s = 0;
+
+    if (off || in_capture)
+        return 0;
+    in_capture = 1;
+    if (b == NULL && !exited && (b = new_buf()) == NULL) {
+        in_capture = 0;
+        return 0;
+    }
+
+    /* capture_fini may be flushing this buffer, or closing the log */
+    lock = (b != NULL) ? &b->lock : &reg_lock;
+    pthread_mutex_lock(lock);
+    if (!off) {
+        if (b != NULL)
+            r = &b->recs[b->n];
+        s = __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED);
+        r->seqtype = s << CAP_TYPEBITS | type;
+        r->ptr = (uintptr_t)ptr;
+        r->old = old;
+        r->size = size;
+        if (b == NULL) {
+            if (write(logfd, r, sizeof(*r)) != sizeof(*r))
+                off = 1;
+        } else if (++b->n == CAP_BUFRECS)
+            flush(b);
+    }
+    pthread_mutex_unlock(lock);
+    in_capture = 0;
+    return s;
+}
+
+static void fork_child(void)
+{
+    off = 1;
+}
+
+__attribute__((constructor))
+static void capture_init(void)
+{
+    char name[64];
+    const char *file = getenv("MMCAPTURE_FILE");
+
+    if (file == NULL) {
+        snprintf(name, sizeof(name), CAP_DEFAULTFILE, (int)getpid());
+        file = name;
+    }
+    logfd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                 0644);
+    if (logfd < 0 || pthread_key_create(&bufkey, thread_exit) != 0) {
+        fprintf(stderr, "mmcapture: can't log to %s: %s\n", file,
+                strerror(errno));
+        off = 1;
+    }
+    pthread_atfork(NULL, NULL, fork_child);
+}
+
+__attribute__((destructor))
+static void capture_fini(void)
+{
+    capbuf_t *b;
+
+    pthread_mutex_lock(&reg_lock);
+    off = 1;
+    for (b = bufs; b != NULL; b = b->next) {
+        pthread_mutex_lock(&b->lock);
+        flush(b);
+        pthread_mutex_unlock(&b->lock);
+    }
+    if (logfd >= 0)
+        close(logfd);
+    logfd = -1;
+    pthread_mutex_unlock(&reg_lock);
+}
+
+/*
+ * The interposed functions. free is logged before the block is
+ * released and the others after they return, so that a block being
+ * reused by another thread always shows up after its free. realloc
+ * does both: its CAP_MOVE gives up the old block before the call.
+ */
+void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+
+    if (p != NULL)
+        record(CAP_MALLOC, p, 0, size);
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p = __libc_calloc(nmemb, size);
+
+    if (p != NULL)
+        record(CAP_MALLOC, p, 0, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    uint64_t move = 0;
+    void *p;
+
+    if (ptr != NULL)
+        move = record(CAP_MOVE, ptr, 0, size);
+    p = __libc_realloc(ptr, size);
+
+    /* A failed realloc is logged too, to give the old block back */
+    if (p != NULL || size == 0 || move != 0)
+        record(CAP_REALLOC, p, move, size);
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+        record(CAP_FREE, ptr, 0, 0);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p = __libc_memalign(alignment, size);
+
+    if (p != NULL)
+        record(CAP_MALLOC, p, 0, size);
+    return p;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    if ((p = memalign(alignment, size)) == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    return memalign(sysconf(_SC_PAGESIZE), size);
+}
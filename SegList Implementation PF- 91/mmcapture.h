@@ -0,0 +1,42 @@
+/*
+ * mmcapture.h - Raw log format of the libmmcapture.so capture shim
+ *
+ * The shim appends fixed-size records to the log as each thread's
+ * buffer fills up, so records of different threads are interleaved
+ * out of order; seq puts them back in the order the calls happened.
+ * mmcap2rep turns a log into a trace.
+ *
+ * realloc may free its old block and another thread get it back from
+ * malloc before realloc returns. So that the old block is not confused
+ * with the new one, realloc first gives it up in a CAP_MOVE record,
+ * and its CAP_REALLOC record, taken after it returns, refers to that
+ * record by its sequence number.
+ */
+#ifndef __MMCAPTURE_H_
+#define __MMCAPTURE_H_
+
+#include <stdint.h>
+
+/* Record types, in the low bits of seqtype */
+#define CAP_MALLOC   0  /* ptr = malloc/calloc/memalign(size) */
+#define CAP_FREE     1  /* free(ptr) */
+#define CAP_REALLOC  2  /* ptr = realloc(<old's CAP_MOVE ptr>, size) */
+#define CAP_MOVE     3  /* realloc(ptr, size) is about to run */
+#define CAP_TYPEBITS 2
+
+typedef struct {
+    uint64_t seqtype;  /* global sequence number << CAP_TYPEBITS | type;
+                          numbers start at 1 */
+    uint64_t ptr;      /* NULL from a failed realloc or realloc(p, 0) */
+    uint64_t old;      /* CAP_REALLOC: sequence number of its CAP_MOVE,
+                          0 for realloc(NULL, size) */
+    uint64_t size;
+} caprec_t;
+
+#define CAP_SEQ(r)  ((r)->seqtype >> CAP_TYPEBITS)
+#define CAP_TYPE(r) ((int)((r)->seqtype & ((1 << CAP_TYPEBITS) - 1)))
+
+/* The log goes to $MMCAPTURE_FILE, or to this name with the pid */
+#define CAP_DEFAULTFILE "mmcapture.%d.raw"
+
+#endif /* __MMCAPTURE_H_ */
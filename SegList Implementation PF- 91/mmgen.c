@@ -0,0 +1,504 @@
+/*
+ * mmgen.c - Generate synthetic traces from parameterized distributions
+ *
+ *     unix> ./mmgen [-b] [-w <weight>] [-s <seed>] [-m <maxlive>]
+ *                   -P <phase> [-P <phase>...] -o <out>
+ *
+ * writes a .rep trace, or with -b a binary one (see trace.h). The same
+ * arguments and seed always give the same trace. A trace is a list of
+ * phases run one after another, each a comma separated list of
+ * key=value pairs:
+ *
+ *   n=<count>        allocations in the phase (default 10000)
+ *   size=<dist>      payload size in bytes (default pow:16:4096:1.2)
+ *   life=<dist>      lifetime, counted in allocations (default exp:100)
+ *   realloc=<pct>[:<grow>]
+ *                    share of steps that realloc a random live block
+ *                    instead of allocating; it grows by the factor
+ *                    <grow>(default 2), or by a fixed amount if <grow>
+ *                    starts with '+'
+ *   end=keep|free    what happens to blocks still live when the phase
+ *                    ends (default keep: they die as planned)
+ *
+ * and a <dist> is one of
+ *
+ *   fixed:<v>                     always v
+ *   uniform:<lo>:<hi>             uniform on [lo, hi]
+ *   exp:<mean>                    exponential
+ *   pow:<lo>:<hi>:<alpha>         power law (Pareto) cut to [lo, hi]
+ *   bimodal:<a>:<b>:<p>           a with probability p, else b
+ *   hist:<file>                   a measured histogram: "<value> <count>"
+ *                                 lines, '#' starts a comment
+ *
+ * Bursts are phases with short lifetimes and end=free; a phase with
+ * life=fixed:<k> frees its blocks in allocation order, k behind, which
+ * is producer-consumer handoff when replayed with mdriver-mt -T <n> -X
+ * (every block is freed by another thread than the one that made it).
+ * If the live payload would go over <maxlive> bytes(default 32M), the
+ * blocks due to die soonest are freed early to make room.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAXPHASES  64        /* most -P options */
+#define MAXSIZE    (1 << 24) /* largest payload a trace gets */
+
+/* A distribution of sizes or lifetimes */
+typedef enum { DFIXED, DUNIFORM, DEXP, DPOW, DBIMODAL, DHIST } dtype_t;
+typedef struct {
+    dtype_t type;
+    double a, b, c;      /* parameters, in the order of the spec */
+    int nbins;           /* DHIST: number of bins... */
+    double *value;       /* ...their values... */
+    double *cum;         /* ...and cumulative counts */
+} dist_t;
+
+typedef struct {
+    long n;              /* allocations */
+    dist_t size, life;
+    double realloc_pct;  /* share of steps that realloc, in percent */
+    double grow;         /* realloc growth factor... */
+    int grow_add;        /* ...or, if set, amount added */
+    int free_at_end;     /* end=free */
+} phase_t;
+
+/*
+ * Random numbers: splitmix64, so that a seed gives the same trace on
+ * every machine and libc
+ */
+static unsigned long long rng_state;
+
+static unsigned long long rng_next(void)
+{
+    unsigned long long z = (rng_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* Uniform on [0, 1) */
+static double rng_unit(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void die(const char *fmt, const char *arg)
+{
+    fprintf(stderr, "mmgen: ");
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+/* read_hist - Read a "<value> <count>" histogram into d */
+static void read_hist(dist_t *d, const char *filename)
+{
+    FILE *fp;
+    char line[256];
+    double value, count, total = 0;
+    int max = 0;
+
+    if ((fp = fopen(filename, "r")) == NULL)
+        die("can't open histogram %s", filename);
+    d->nbins = 0;
+    d->value = d->cum = NULL;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%lf %lf", &value, &count) != 2)
+            continue;
+        if (value < 0 || count < 0)
+            die("negative value or count in %s", filename);
+        if (d->nbins == max) {
+            max = max ? 2 * max : 64;
+            d->value = realloc(d->value, max * sizeof(double));
+            d->cum = realloc(d->cum, max * sizeof(double));
+            if (d->value == NULL || d->cum == NULL)
+                die("out of memory reading %s", filename);
+        }
+        total += count;
+        d->value[d->nbins] = value;
+        d->cum[d->nbins++] = total;
+    }
+    fclose(fp);
+    if (total <= 0)
+        die("empty histogram %s", filename);
+}
+
+/* parse_dist - Parse a distribution spec into d */
+static void parse_dist(dist_t *d, const char *spec)
+{
+    int n = 0;
+
+    memset(d, 0, sizeof(*d));
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        d->type = DFIXED;
+        n = sscanf(spec + 6, "%lf", &d->a) == 1;
+    } else if (strncmp(spec, "uniform:", 8) == 0) {
+        d->type = DUNIFORM;
+        n = sscanf(spec + 8, "%lf:%lf", &d->a, &d->b) == 2 && d->a <= d->b;
+    } else if (strncmp(spec, "exp:", 4) == 0) {
+        d->type = DEXP;
+        n = sscanf(spec + 4, "%lf", &d->a) == 1;
+    } else if (strncmp(spec, "pow:", 4) == 0) {
+        d->type = DPOW;
+        n = sscanf(spec + 4, "%lf:%lf:%lf", &d->a, &d->b, &d->c) == 3 &&
+            d->a > 0 && d->a <= d->b && d->c > 0;
+    } else if (strncmp(spec, "bimodal:", 8) == 0) {
+        d->type = DBIMODAL;
+        n = sscanf(spec + 8, "%lf:%lf:%lf", &d->a, &d->b, &d->c) == 3 &&
+            d->c >= 0 && d->c <= 1;
+    } else if (strncmp(spec, "hist:", 5) == 0) {
+        d->type = DHIST;
+        read_hist(d, spec + 5);
+        n = 1;
+    }
+    if (!n || d->a < 0 || d->b < 0)
+        die("bad distribution \"%s\"", spec);
+}
+
+/* sample - Draw a value from d */
+static double sample(const dist_t *d)
+{
+    double u = rng_unit(), x;
+    int lo, hi, mid;
+
+    switch (d->type) {
+    case DFIXED:
+        return d->a;
+    case DUNIFORM:
+        return d->a + u * (d->b - d->a + 1);
+    case DEXP:
+        return -d->a * log(1 - u);
+    case DPOW:
+        /* Inverse of the Pareto CDF cut to [a, b] */
+        x = pow(d->a, -d->c) - u * (pow(d->a, -d->c) - pow(d->b, -d->c));
+        return pow(x, -1 / d->c);
+    case DBIMODAL:
+        return (u < d->c) ? d->a : d->b;
+    default:
+        /* First bin whose cumulative count is above u * total */
+        u *= d->cum[d->nbins - 1];
+        for (lo = 0, hi = d->nbins - 1; lo < hi; ) {
+            mid = (lo + hi) / 2;
+            if (d->cum[mid] > u)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        return d->value[lo];
+    }
+}
+
+/* parse_phase - Parse a -P spec into p */
+static void parse_phase(phase_t *p, char *spec)
+{
+    char *kv, *val, *grow;
+
+    p->n = 10000;
+    parse_dist(&p->size, "pow:16:4096:1.2");
+    parse_dist(&p->life, "exp:100");
+    p->realloc_pct = 0;
+    p->grow = 2;
+    p->grow_add = 0;
+    p->free_at_end = 0;
+
+    for (kv = strtok(spec, ","); kv != NULL; kv = strtok(NULL, ",")) {
+        if ((val = strchr(kv, '=')) == NULL)
+            die("phase option \"%s\" needs a value", kv);
+        *val++ = '\0';
+        if (strcmp(kv, "n") == 0) {
+            if ((p->n = atol(val)) <= 0)
+                die("bad n=%s", val);
+        } else if (strcmp(kv, "size") == 0) {
+            parse_dist(&p->size, val);
+        } else if (strcmp(kv, "life") == 0) {
+            parse_dist(&p->life, val);
+        } else if (strcmp(kv, "realloc") == 0) {
+            p->realloc_pct = atof(val);
+            if ((grow = strchr(val, ':')) != NULL) {
+                p->grow_add = (grow[1] == '+');
+                p->grow = atof(grow + 1 + p->grow_add);
+            }
+            if (p->realloc_pct < 0 || p->realloc_pct >= 100 || p->grow <= 0)
+                die("bad realloc=%s", val);
+        } else if (strcmp(kv, "end") == 0) {
+            if (strcmp(val, "free") != 0 && strcmp(val, "keep") != 0)
+                die("end=%s should be keep or free", val);
+            p->free_at_end = (strcmp(val, "free") == 0);
+        } else {
+            die("unknown phase option \"%s\"", kv);
+        }
+    }
+}
+
+/*
+ * The trace being built. Live blocks are in a binary min-heap on their
+ * time of death, which also gives each id its place in the heap(pos)
+ * so that a realloc can pick a random live block.
+ */
+typedef struct {
+    double death;
+    int id;
+} live_t;
+
+static traceop_t *ops;
+static size_t nops, maxops;
+static live_t *heap;
+static int nlive, maxlive_blocks;
+static int *pos;             /* pos[id]: index of id in heap */
+static size_t *cur_size;     /* cur_size[id]: its payload size */
+static int num_ids, max_ids;
+static size_t live_bytes, max_live_bytes;
+
+static void add_op(int type, int id, size_t size)
+{
+    if (nops == maxops) {
+        maxops = maxops ? 2 * maxops : 65536;
+        if ((ops = realloc(ops, maxops * sizeof(*ops))) == NULL)
+            die("out of memory%s", "");
+    }
+    ops[nops].type = type;
+    ops[nops].index = id;
+    ops[nops++].size = size;
+}
+
+static void heap_swap(int i, int j)
+{
+    live_t t = heap[i];
+
+    heap[i] = heap[j];
+    heap[j] = t;
+    pos[heap[i].id] = i;
+    pos[heap[j].id] = j;
+}
+
+static void heap_push(double death, int id)
+{
+    int i, parent;
+
+    if (nlive == maxlive_blocks) {
+        maxlive_blocks = maxlive_blocks ? 2 * maxlive_blocks : 1024;
+        if ((heap = realloc(heap, maxlive_blocks * sizeof(*heap))) == NULL)
+            die("out of memory%s", "");
+    }
+    i = nlive++;
+    heap[i].death = death;
+    heap[i].id = id;
+    pos[id] = i;
+    for (; i > 0 && heap[parent = (i - 1) / 2].death > heap[i].death;
+         i = parent)
+        heap_swap(i, parent);
+}
+
+/* free_first - Free the live block due to die first */
+static void free_first(void)
+{
+    int i = 0, child, id = heap[0].id;
+
+    add_op(FREE, id, 0);
+    live_bytes -= cur_size[id];
+    heap_swap(0, --nlive);
+    for (; (child = 2 * i + 1) < nlive; i = child) {
+        if (child + 1 < nlive && heap[child + 1].death < heap[child].death)
+            child++;
+        if (heap[i].death <= heap[child].death)
+            break;
+        heap_swap(i, child);
+    }
+}
+
+/* new_id - Hand out the next id, growing the per id arrays */
+static int new_id(void)
+{
+    if (num_ids == max_ids) {
+        max_ids = max_ids ? 2 * max_ids : 1024;
+        pos = realloc(pos, max_ids * sizeof(*pos));
+        cur_size = realloc(cur_size, max_ids * sizeof(*cur_size));
+        if (pos == NULL || cur_size == NULL)
+            die("out of memory%s", "");
+    }
+    return num_ids++;
+}
+
+static size_t clamp_size(double x)
+{
+    if (x < 1)
+        return 1;
+    if (x > MAXSIZE)
+        return MAXSIZE;
+    return (size_t)x;
+}
+
+/* make_room - Free early until size more bytes fit under the cap */
+static void make_room(size_t size)
+{
+    while (nlive > 0 && live_bytes + size > max_live_bytes)
+        free_first();
+}
+
+/*
+ * run_phase - Add the ops of phase p; now is the step count so far,
+ *     and is advanced by one per allocation or realloc
+ */
+static void run_phase(const phase_t *p, double *now)
+{
+    long i;
+    int id;
+    size_t size;
+
+    for (i = 0; i < p->n; ) {
+        *now += 1;
+        while (nlive > 0 && heap[0].death <= *now)
+            free_first();
+
+        if (nlive > 0 && 100 * rng_unit() < p->realloc_pct) {
+            id = heap[rng_next() % nlive].id;
+            size = clamp_size(p->grow_add ? cur_size[id] + p->grow
+                                          : cur_size[id] * p->grow);
+            if (size > cur_size[id])
+                make_room(size - cur_size[id]);
+            if (pos[id] >= nlive || heap[pos[id]].id != id)
+                continue;  /* it was freed to make room */
+            live_bytes += size - cur_size[id];
+            cur_size[id] = size;
+            add_op(REALLOC, id, size);
+            continue;
+        }
+
+        size = clamp_size(sample(&p->size));
+        make_room(size);
+        id = new_id();
+        cur_size[id] = size;
+        live_bytes += size;
+        add_op(ALLOC, id, size);
+        heap_push(*now + sample(&p->life), id);
+        i++;
+    }
+
+    if (p->free_at_end)
+        while (nlive > 0)
+            free_first();
+}
+
+static void write_text(FILE *out, int weight)
+{
+    size_t i;
+
+    fprintf(out, "%d\n%d\n%lu\n%d\n", weight, num_ids, (unsigned long)nops, 0);
+    for (i = 0; i < nops; i++) {
+        if (ops[i].type == FREE)
+            fprintf(out, "f %d\n", ops[i].index);
+        else
+            fprintf(out, "%c %d %lu\n", ops[i].type == ALLOC ? 'a' : 'r',
+                    ops[i].index, (unsigned long)ops[i].size);
+    }
+}
+
+static void write_binary(FILE *out, int weight)
+{
+    tracehdr_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGICLEN);
+    hdr.version = TRACE_VERSION;
+    hdr.weight = weight;
+    hdr.num_ids = num_ids;
+    hdr.ignore_ranges = 0;
+    hdr.num_ops = nops;
+    fwrite(&hdr, sizeof(hdr), 1, out);
+    fwrite(ops, sizeof(*ops), nops, out);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: mmgen [-b] [-w <weight>] [-s <seed>] [-m <maxlive>]\n"
+            "             -P <phase> [-P <phase>...] -o <out>\n"
+            "\t-b         Write a binary trace instead of a .rep.\n"
+            "\t-w <w>     Trace weight (default 0).\n"
+            "\t-s <seed>  Random seed (default 1).\n"
+            "\t-m <bytes> Cap on the live payload (default 32M).\n"
+            "\t-P <phase> n=<allocs>,size=<dist>,life=<dist>,"
+            "realloc=<pct>[:<grow>],end=keep|free\n"
+            "<dist>: fixed:<v> uniform:<lo>:<hi> exp:<mean> "
+            "pow:<lo>:<hi>:<alpha>\n"
+            "        bimodal:<a>:<b>:<p> hist:<file>\n");
+}
+
+int main(int argc, char **argv)
+{
+    static phase_t phases[MAXPHASES];
+    const char *outname = NULL;
+    unsigned long long seed = 1;
+    FILE *out;
+    double now = 0;
+    int c, i, nphases = 0;
+    int binary = 0, weight = 0;
+    char *end;
+
+    max_live_bytes = 32 << 20;
+    while ((c = getopt(argc, argv, "bw:s:m:P:o:h")) != EOF) {
+        switch (c) {
+        case 'b':
+            binary = 1;
+            break;
+        case 'w':
+            weight = atoi(optarg);
+            break;
+        case 's':
+            seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'm':
+            max_live_bytes = strtoul(optarg, &end, 0);
+            if (*end == 'k' || *end == 'K')
+                max_live_bytes <<= 10;
+            else if (*end == 'm' || *end == 'M')
+                max_live_bytes <<= 20;
+            break;
+        case 'P':
+            if (nphases == MAXPHASES)
+                die("too many phases%s", "");
+            parse_phase(&phases[nphases++], optarg);
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        default:
+            usage();
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+    if (outname == NULL || nphases == 0 || optind != argc ||
+        weight < 0 || weight > 3 || max_live_bytes == 0) {
+        usage();
+        exit(1);
+    }
+
+    rng_state = seed;
+    for (i = 0; i < nphases; i++)
+        run_phase(&phases[i], &now);
+    while (nlive > 0)
+        free_first();
+
+    if ((out = fopen(outname, "w")) == NULL) {
+        perror(outname);
+        exit(1);
+    }
+    if (binary)
+        write_binary(out, weight);
+    else
+        write_text(out, weight);
+    if (fclose(out) != 0) {
+        perror(outname);
+        exit(1);
+    }
+
+    printf("%s: %lu ops, %d ids, seed %llu\n", outname, (unsigned long)nops,
+           num_ids, seed);
+    return 0;
+}
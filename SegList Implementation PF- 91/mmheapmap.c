@@ -0,0 +1,293 @@
+/*
+ * mmheapmap.c - Draw a heap map written by mm_dump_heapmap
+ *
+ *     unix> ./mmheapmap [-j] [-w <width>] [-r <bytes per row>] -o <out> <map>
+ *
+ * writes an SVG picture of the heap(or with -j, the same data as JSON).
+ * The heap is laid out left to right, top to bottom, <bytes per row> to
+ * a row (default: a multiple of the page size that gives at most 128
+ * rows). Runs of allocated blocks are drawn as one bar; every free
+ * block is drawn on its own, coloured by its seg list, so fragmentation
+ * shows up as many small bright slivers. Under each row a strip shows
+ * the pages: blank if not resident, orange if resident but wholly
+ * inside a free block(memory a purge could give back), grey otherwise.
+ * The summary line gives the heap size, the free share, the largest
+ * free block, external fragmentation (1 - largest free / free bytes)
+ * and the resident and purgeable bytes.
+ *
+ * mdriver --heapmap <prefix> [--heapmap-at <ops>] writes the maps.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mm.h"
+
+#define MAXROWS    128    /* most rows the default row size gives */
+#define BARH       16     /* pixels: block bar of a row... */
+#define STRIPH     4      /* ...its page strip... */
+#define ROWH       24     /* ...and the whole row */
+#define TOP        40     /* room for the summary above the rows */
+
+/* The map being drawn */
+static mm_heapmap_hdr_t hdr;
+static mm_heapmap_block_t *blocks;
+static unsigned char *pages;
+
+/* Layout */
+static int width = 1024;
+static unsigned long bytes_per_row;
+
+/* Summary */
+static unsigned long long nfree, free_bytes, largest_free;
+static unsigned long long resident_bytes, purgeable_bytes;
+static unsigned long long class_free[MM_SIZECLASSES];
+
+static void die(const char *fmt, const char *arg)
+{
+    fprintf(stderr, "mmheapmap: ");
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+/* read_map - Read the header, blocks and page bytes of filename */
+static void read_map(const char *filename)
+{
+    FILE *fp;
+
+    if ((fp = fopen(filename, "r")) == NULL)
+        die("can't open %s", filename);
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, MM_HEAPMAP_MAGIC, sizeof(hdr.magic)) != 0)
+        die("%s is not a heap map", filename);
+    if (hdr.version != MM_HEAPMAP_VERSION)
+        die("%s: unknown heap map version", filename);
+    if ((blocks = malloc(hdr.nblocks * sizeof(*blocks) + 1)) == NULL ||
+        (pages = malloc(hdr.npages + 1)) == NULL)
+        die("out of memory reading %s", filename);
+    if (fread(blocks, sizeof(*blocks), hdr.nblocks, fp) != hdr.nblocks ||
+        fread(pages, 1, hdr.npages, fp) != hdr.npages)
+        die("%s is truncated", filename);
+    fclose(fp);
+}
+
+static void summarize(void)
+{
+    unsigned long long i;
+
+    for (i = 0; i < hdr.nblocks; i++) {
+        if (!blocks[i].is_free)
+            continue;
+        nfree++;
+        free_bytes += blocks[i].size;
+        if (blocks[i].size > largest_free)
+            largest_free = blocks[i].size;
+        if (blocks[i].list < MM_SIZECLASSES)
+            class_free[blocks[i].list] += blocks[i].size;
+    }
+    for (i = 0; i < hdr.npages; i++) {
+        if (!(pages[i] & MM_PAGE_RESIDENT))
+            continue;
+        resident_bytes += hdr.page_size;
+        if (pages[i] & MM_PAGE_FREE)
+            purgeable_bytes += hdr.page_size;
+    }
+}
+
+static double ext_frag(void)
+{
+    return free_bytes ? 1.0 - (double)largest_free / free_bytes : 0;
+}
+
+/* class_color - Free blocks: small lists red through to large ones blue */
+static void class_color(int list, char *buf, size_t len)
+{
+    snprintf(buf, len, "hsl(%d,85%%,55%%)", list * 240 / (MM_SIZECLASSES - 1));
+}
+
+/*
+ * rect - Draw [off, off+len) of the heap in colour, height h at y
+ *     offset dy within each row it crosses
+ */
+static void rect(FILE *out, unsigned long long off, unsigned long long len,
+                 const char *color, int dy, int h)
+{
+    unsigned long long row, col, n;
+    double scale = (double)width / bytes_per_row;
+
+    while (len > 0) {
+        row = off / bytes_per_row;
+        col = off % bytes_per_row;
+        n = bytes_per_row - col < len ? bytes_per_row - col : len;
+        fprintf(out, "<rect x=\"%.2f\" y=\"%llu\" width=\"%.2f\" "
+                "height=\"%d\" fill=\"%s\"/>\n", col * scale,
+                TOP + row * ROWH + dy, n * scale < 0.5 ? 0.5 : n * scale,
+                h, color);
+        off += n;
+        len -= n;
+    }
+}
+
+static void write_svg(FILE *out)
+{
+    unsigned long long i, j, rows, first;
+    char color[32];
+    int state, x;
+
+    rows = (hdr.heap_bytes + bytes_per_row - 1) / bytes_per_row;
+    fprintf(out, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" "
+            "height=\"%llu\" font-family=\"monospace\" font-size=\"12\">\n",
+            width, TOP + rows * ROWH + 3 * ROWH);
+    fprintf(out, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+    fprintf(out, "<text x=\"0\" y=\"14\">heap %llu bytes, %llu blocks, "
+            "%llu free (%.1f%%), largest free %llu, ext frag %.3f</text>\n",
+            (unsigned long long)hdr.heap_bytes,
+            (unsigned long long)hdr.nblocks, nfree,
+            hdr.heap_bytes ? 100.0 * free_bytes / hdr.heap_bytes : 0.0,
+            largest_free, ext_frag());
+    fprintf(out, "<text x=\"0\" y=\"30\">resident %llu bytes, purgeable "
+            "%llu bytes; %lu bytes per row</text>\n",
+            resident_bytes, purgeable_bytes, bytes_per_row);
+
+    /* Whatever comes before the first block: list heads and prologue */
+    first = hdr.nblocks ? blocks[0].offset : hdr.heap_bytes;
+    rect(out, 0, first, "black", 0, BARH);
+
+    /* Runs of allocated blocks, then each free block */
+    for (i = 0; i < hdr.nblocks; i = j) {
+        if (blocks[i].is_free) {
+            class_color(blocks[i].list, color, sizeof(color));
+            rect(out, blocks[i].offset, blocks[i].size, color, 0, BARH);
+            j = i + 1;
+            continue;
+        }
+        for (j = i; j < hdr.nblocks && !blocks[j].is_free; j++)
+            ;
+        rect(out, blocks[i].offset, blocks[j - 1].offset + blocks[j - 1].size -
+             blocks[i].offset, "#4a6fa5", 0, BARH);
+    }
+
+    /* Page strip, one rect per run of pages in the same state */
+    for (i = 0; i < hdr.npages; i = j) {
+        state = pages[i];
+        for (j = i; j < hdr.npages && pages[j] == state; j++)
+            ;
+        if (!(state & MM_PAGE_RESIDENT))
+            continue;
+        rect(out, i * hdr.page_size, (j - i) * hdr.page_size,
+             (state & MM_PAGE_FREE) ? "orange" : "#999", BARH + 2, STRIPH);
+    }
+
+    /* Legend */
+    x = 0;
+    fprintf(out, "<rect x=\"%d\" y=\"%llu\" width=\"12\" height=\"12\" "
+            "fill=\"#4a6fa5\"/><text x=\"%d\" y=\"%llu\">allocated</text>\n",
+            x, TOP + rows * ROWH + 8, x + 16, TOP + rows * ROWH + 18);
+    x += 100;
+    fprintf(out, "<rect x=\"%d\" y=\"%llu\" width=\"12\" height=\"12\" "
+            "fill=\"orange\"/><text x=\"%d\" y=\"%llu\">purgeable page</text>\n",
+            x, TOP + rows * ROWH + 8, x + 16, TOP + rows * ROWH + 18);
+    x += 140;
+    fprintf(out, "<text x=\"%d\" y=\"%llu\">free, by seg list:</text>\n",
+            x, TOP + rows * ROWH + 18);
+    x += 140;
+    for (i = 0; i < MM_SIZECLASSES; i++) {
+        class_color(i, color, sizeof(color));
+        fprintf(out, "<rect x=\"%llu\" y=\"%llu\" width=\"12\" height=\"12\" "
+                "fill=\"%s\"><title>list %llu: %llu bytes free</title></rect>\n",
+                x + i * 14, TOP + rows * ROWH + 8, color, i, class_free[i]);
+    }
+    fprintf(out, "</svg>\n");
+}
+
+static void write_json(FILE *out)
+{
+    unsigned long long i;
+
+    fprintf(out, "{\"heap_base\": %llu, \"heap_bytes\": %llu, "
+            "\"page_size\": %u,\n \"free_blocks\": %llu, "
+            "\"free_bytes\": %llu, \"largest_free\": %llu, "
+            "\"ext_frag\": %.4f, \"resident_bytes\": %llu, "
+            "\"purgeable_bytes\": %llu,\n \"class_free\": [",
+            (unsigned long long)hdr.heap_base,
+            (unsigned long long)hdr.heap_bytes, hdr.page_size, nfree,
+            free_bytes, largest_free, ext_frag(), resident_bytes,
+            purgeable_bytes);
+    for (i = 0; i < MM_SIZECLASSES; i++)
+        fprintf(out, "%s%llu", i ? ", " : "", class_free[i]);
+    /* Blocks as [offset, size, free, list]; list is -1 if allocated */
+    fprintf(out, "],\n \"blocks\": [");
+    for (i = 0; i < hdr.nblocks; i++)
+        fprintf(out, "%s[%llu, %u, %d, %d]", i ? (i % 8 ? ", " : ",\n  ") : "",
+                (unsigned long long)blocks[i].offset, blocks[i].size,
+                blocks[i].is_free, blocks[i].is_free ? blocks[i].list : -1);
+    /* Pages as one digit each: MM_PAGE_RESIDENT | MM_PAGE_FREE */
+    fprintf(out, "],\n \"pages\": \"");
+    for (i = 0; i < hdr.npages; i++)
+        fputc('0' + (pages[i] & 3), out);
+    fprintf(out, "\"}\n");
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: mmheapmap [-j] [-w <width>] [-r <bytes per row>] "
+            "-o <out> <map>\n"
+            "\t-j         Write JSON instead of SVG.\n"
+            "\t-w <px>    Picture width (default 1024).\n"
+            "\t-r <bytes> Heap bytes per row (default: at most %d rows).\n",
+            MAXROWS);
+}
+
+int main(int argc, char **argv)
+{
+    const char *outname = NULL;
+    FILE *out;
+    int c, json = 0;
+
+    while ((c = getopt(argc, argv, "jw:r:o:h")) != EOF) {
+        switch (c) {
+        case 'j':
+            json = 1;
+            break;
+        case 'w':
+            width = atoi(optarg);
+            break;
+        case 'r':
+            bytes_per_row = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        default:
+            usage();
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+    if (outname == NULL || optind != argc - 1 || width <= 0) {
+        usage();
+        exit(1);
+    }
+
+    read_map(argv[optind]);
+    summarize();
+    if (bytes_per_row == 0) {
+        bytes_per_row = (hdr.heap_bytes + MAXROWS - 1) / MAXROWS;
+        bytes_per_row = (bytes_per_row + hdr.page_size - 1) /
+                        hdr.page_size * hdr.page_size;
+        if (bytes_per_row == 0)
+            bytes_per_row = hdr.page_size;
+    }
+
+    if ((out = fopen(outname, "w")) == NULL)
+        die("can't open %s", outname);
+    if (json)
+        write_json(out);
+    else
+        write_svg(out);
+    if (fclose(out) != 0)
+        die("can't write %s", outname);
+    return 0;
+}
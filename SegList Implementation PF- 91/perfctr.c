@@ -0,0 +1,135 @@
+/*
+ * perfctr.c - Hardware performance counters via perf_event_open(2)
+ */
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfctr.h"
+
+/* What to count for each event */
+static const struct {
+    const char *name;
+    unsigned type;
+    unsigned long long config;
+} events[PERFCTR_NEVENTS] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instrs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "L1d-miss", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "LLC-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { "dTLB-miss", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+};
+
+static int fds[PERFCTR_NEVENTS] = { -1, -1, -1, -1, -1, -1 };
+
+/* What read(2) returns, given the read_format set below */
+typedef struct {
+    unsigned long long value;
+    unsigned long long enabled;  /* ns the event was enabled... */
+    unsigned long long running;  /* ...and actually on the PMU */
+} reading_t;
+
+/* Reset does not zero the times, so perfctr_start notes them here */
+static reading_t base[PERFCTR_NEVENTS];
+
+/*
+ * perfctr_open - Open one counter per event, disabled for now
+ */
+int perfctr_open(void)
+{
+    struct perf_event_attr attr;
+    int i, nopen = 0;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[i] >= 0)
+            nopen++;
+    }
+    return nopen;
+}
+
+/*
+ * perfctr_close - Close all counters
+ */
+void perfctr_close(void)
+{
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+        if (fds[i] >= 0)
+            close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+/*
+ * perfctr_name - Short name of event i
+ */
+const char *perfctr_name(int i)
+{
+    return events[i].name;
+}
+
+/*
+ * perfctr_start - Zero and start the counters
+ */
+void perfctr_start(void)
+{
+    int i;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+        if (fds[i] >= 0) {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            if (read(fds[i], &base[i], sizeof(base[i])) != sizeof(base[i]))
+                memset(&base[i], 0, sizeof(base[i]));
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+/*
+ * perfctr_stop - Stop the counters and read them, scaling the ones
+ *     that were multiplexed by enabled / running time
+ */
+int perfctr_stop(double counts[PERFCTR_NEVENTS])
+{
+    reading_t r;
+    unsigned long long enabled, running;
+    int i, scaled = 0;
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++)
+        if (fds[i] >= 0)
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (i = 0; i < PERFCTR_NEVENTS; i++) {
+        counts[i] = -1;
+        if (fds[i] < 0 || read(fds[i], &r, sizeof(r)) != sizeof(r))
+            continue;
+        enabled = r.enabled - base[i].enabled;
+        running = r.running - base[i].running;
+        if (running == 0)
+            continue;
+        counts[i] = (double)r.value;
+        if (running < enabled) {
+            counts[i] *= (double)enabled / running;
+            scaled |= 1 << i;
+        }
+    }
+    return scaled;
+}
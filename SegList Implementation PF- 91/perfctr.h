@@ -0,0 +1,40 @@
+/*
+ * perfctr.h - Hardware performance counters via perf_event_open(2)
+ *
+ * Counts user-space events of the calling thread between perfctr_start
+ * and perfctr_stop. Events the machine (or a VM, or the
+ * perf_event_paranoid setting) does not allow are simply left out.
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+enum {
+    PERFCTR_CYCLES,
+    PERFCTR_INSTRUCTIONS,
+    PERFCTR_L1D_MISSES,
+    PERFCTR_LLC_MISSES,
+    PERFCTR_DTLB_MISSES,
+    PERFCTR_BRANCH_MISSES,
+    PERFCTR_NEVENTS
+};
+
+/* Open the counters; returns how many of them could be opened */
+int perfctr_open(void);
+
+/* Close all counters */
+void perfctr_close(void);
+
+/* Short name of event i, for table headers */
+const char *perfctr_name(int i);
+
+/* Zero and start all open counters */
+void perfctr_start(void);
+
+/* Stop the counters and read them into counts; events that are not
+   available, or never got on the PMU, read as -1. When there are more
+   events than hardware counters the kernel time-shares them; such
+   counts are scaled up to the whole interval. Returns a mask with bit
+   i set if event i was scaled */
+int perfctr_stop(double counts[PERFCTR_NEVENTS]);
+
+#endif /* __PERFCTR_H_ */
@@ -0,0 +1,221 @@
+/*
+ * pmrbench.cc - Container-heavy workloads on the mm.c heap vs std::allocator
+ *
+ * Each workload is run with std::allocator(libc malloc), mm::allocator,
+ * a std::pmr container on mm::heap_resource() and a std::pmr container
+ * on a mm::region_resource(monotonic: nothing is freed until the
+ * workload ends). The best of a few runs is reported, along with the
+ * speedup over std::allocator.
+ *
+ *     unix> ./pmrbench [-r <runs>]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "memlib.h"
+#include "mm_resource.hpp"
+
+/* Workload sizes */
+#define NVECTORS    1000   /* vectors alive at once in vector_workload */
+#define MAXVECLEN   2000   /* each grows to a random length below this */
+#define NKEYS       100000 /* keys in the map workloads */
+#define NLISTOPS    200000 /* push/pop operations in list_workload */
+
+/* Deterministic random numbers, so every variant does the same work */
+static unsigned long rand_state;
+static unsigned next_rand(void)
+{
+    rand_state = rand_state * 6364136223846793005UL + 1442695040888963407UL;
+    return (unsigned)(rand_state >> 33);
+}
+
+template <typename Alloc, typename T>
+using rebind_t = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+/* Many vectors growing by push_back, then all destroyed */
+template <typename Alloc>
+static long vector_workload(const Alloc &alloc)
+{
+    using vec_t = std::vector<int, rebind_t<Alloc, int>>;
+    std::vector<vec_t> vecs;
+    long sum = 0;
+    int i, j, len;
+
+    vecs.reserve(NVECTORS);
+    for (i = 0; i < NVECTORS; i++)
+        vecs.emplace_back(rebind_t<Alloc, int>(alloc));
+    for (i = 0; i < NVECTORS; i++) {
+        len = next_rand() % MAXVECLEN;
+        for (j = 0; j < len; j++)
+            vecs[i].push_back(j);
+        sum += vecs[i].size();
+    }
+    return sum;
+}
+
+/* Insert, erase half, insert again into an unordered_map */
+template <typename Alloc>
+static long umap_workload(const Alloc &alloc)
+{
+    using pair_t = std::pair<const int, int>;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                       rebind_t<Alloc, pair_t>>
+        map(0, std::hash<int>(), std::equal_to<int>(),
+            rebind_t<Alloc, pair_t>(alloc));
+    int i;
+
+    for (i = 0; i < NKEYS; i++)
+        map[next_rand()] = i;
+    for (auto it = map.begin(); it != map.end(); )
+        it = (it->second & 1) ? map.erase(it) : std::next(it);
+    for (i = 0; i < NKEYS; i++)
+        map[next_rand()] = i;
+    return map.size();
+}
+
+/* Random inserts and erases in a std::map */
+template <typename Alloc>
+static long map_workload(const Alloc &alloc)
+{
+    using pair_t = std::pair<const int, int>;
+    std::map<int, int, std::less<int>, rebind_t<Alloc, pair_t>>
+        map{rebind_t<Alloc, pair_t>(alloc)};
+    int i;
+
+    for (i = 0; i < NKEYS; i++) {
+        map[next_rand() % NKEYS] = i;
+        map.erase(next_rand() % NKEYS);
+    }
+    return map.size();
+}
+
+/* A list used as a queue that keeps growing and shrinking */
+template <typename Alloc>
+static long list_workload(const Alloc &alloc)
+{
+    std::list<int, rebind_t<Alloc, int>> list{rebind_t<Alloc, int>(alloc)};
+    int i;
+
+    for (i = 0; i < NLISTOPS; i++) {
+        if (list.empty() || next_rand() % 3 != 0)
+            list.push_back(i);
+        else
+            list.pop_front();
+    }
+    return list.size();
+}
+
+enum { WVECTOR, WUMAP, WMAP, WLIST, NWORKLOADS };
+static const char *workload_names[NWORKLOADS] = {
+    "vector", "unordered_map", "map", "list"
+};
+
+template <typename Alloc>
+static long run_workload(int w, const Alloc &alloc)
+{
+    rand_state = 1;
+    switch (w) {
+    case WVECTOR: return vector_workload(alloc);
+    case WUMAP:   return umap_workload(alloc);
+    case WMAP:    return map_workload(alloc);
+    default:      return list_workload(alloc);
+    }
+}
+
+enum { VSTD, VMM, VPMRHEAP, VPMRREGION, NVARIANTS };
+static const char *variant_names[NVARIANTS] = {
+    "std::allocator", "mm::allocator", "pmr(heap)", "pmr(region)"
+};
+
+/* Run workload w once with the given variant, return elapsed secs */
+static double time_once(int w, int v)
+{
+    auto start = std::chrono::steady_clock::now();
+    long result;
+
+    switch (v) {
+    case VSTD:
+        result = run_workload(w, std::allocator<int>());
+        break;
+    case VMM:
+        result = run_workload(w, mm::allocator<int>());
+        break;
+    case VPMRHEAP:
+        result = run_workload(
+            w, std::pmr::polymorphic_allocator<int>(mm::heap_resource()));
+        break;
+    default: {
+        mm::region_resource region;
+        result = run_workload(w, std::pmr::polymorphic_allocator<int>(&region));
+        break;
+    }
+    }
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    if (result < 0)
+        std::printf("?"); /* keep the result alive */
+    return secs.count();
+}
+
+int main(int argc, char **argv)
+{
+    double best[NWORKLOADS][NVARIANTS];
+    double secs;
+    int runs = 5;
+    int c, w, v, r;
+
+    while ((c = getopt(argc, argv, "r:h")) != EOF) {
+        switch (c) {
+        case 'r':
+            runs = std::atoi(optarg);
+            break;
+        default:
+            std::fprintf(stderr, "Usage: pmrbench [-r <runs>]\n");
+            std::exit(c == 'h' ? 0 : 1);
+        }
+    }
+    if (runs < 1)
+        runs = 1;
+
+    mem_init();
+    if (mm_init() < 0) {
+        std::fprintf(stderr, "mm_init failed\n");
+        std::exit(1);
+    }
+
+    for (w = 0; w < NWORKLOADS; w++) {
+        for (v = 0; v < NVARIANTS; v++) {
+            best[w][v] = 0;
+            for (r = 0; r < runs; r++) {
+                secs = time_once(w, v);
+                if (r == 0 || secs < best[w][v])
+                    best[w][v] = secs;
+            }
+        }
+    }
+
+    std::printf("Best of %d runs, secs (speedup over std::allocator)\n", runs);
+    std::printf("%-14s", "workload");
+    for (v = 0; v < NVARIANTS; v++)
+        std::printf("%22s", variant_names[v]);
+    std::printf("\n");
+    for (w = 0; w < NWORKLOADS; w++) {
+        std::printf("%-14s", workload_names[w]);
+        for (v = 0; v < NVARIANTS; v++)
+            std::printf("%13.6f (%5.2fx)", best[w][v],
+                        best[w][VSTD] / best[w][v]);
+        std::printf("\n");
+    }
+    std::printf("heap size after all runs: %zu bytes\n", mem_heapsize());
+
+    mem_deinit();
+    return 0;
+}
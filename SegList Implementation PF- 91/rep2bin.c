@@ -0,0 +1,155 @@
+/*
+ * rep2bin.c - Convert text .rep traces to the binary trace format
+ *
+ * The binary file is written next to the text one with the .rep
+ * suffix replaced by .bin, unless -o names it:
+ *
+ *     unix> ./rep2bin traces/needle.rep traces/exhaust.rep
+ *     unix> ./rep2bin -o needle.bin traces/needle.rep
+ *
+ * mdriver tells the two formats apart by the magic at the start of
+ * the file, so a .bin can be passed anywhere a .rep is.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024
+
+/* Records are written out through a buffer of this many ops */
+#define OPBUFLEN 4096
+
+/*
+ * convert - Convert the text trace inname into the binary trace
+ *           outname; returns 0 on success, -1 after printing an error
+ */
+static int convert(const char *inname, const char *outname)
+{
+    static traceop_t buf[OPBUFLEN];
+    tracehdr_t hdr;
+    FILE *in, *out;
+    char type[MAXLINE];
+    unsigned index, size = 0;
+    unsigned long num_ops;
+    uint64_t nops = 0;
+    int nbuf = 0;
+    int max_index = -1;
+
+    if ((in = fopen(inname, "r")) == NULL) {
+        perror(inname);
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, TRACE_MAGICLEN);
+    hdr.version = TRACE_VERSION;
+    if (fscanf(in, "%d %d %lu %d", &hdr.weight, &hdr.num_ids,
+               &num_ops, &hdr.ignore_ranges) != 4) {
+        fprintf(stderr, "%s: bad trace header\n", inname);
+        fclose(in);
+        return -1;
+    }
+    hdr.num_ops = num_ops;
+    if ((out = fopen(outname, "w")) == NULL) {
+        perror(outname);
+        fclose(in);
+        return -1;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, out);
+
+    while (nops < hdr.num_ops && fscanf(in, "%s", type) == 1) {
+        traceop_t *op = &buf[nbuf];
+
+        switch (type[0]) {
+        case 'a':
+        case 'r':
+            /* A few traces leave out the size; read_trace then keeps
+               the previous one, so do the same */
+            if (fscanf(in, "%u %u", &index, &size) < 1)
+                goto bad;
+            op->type = (type[0] == 'a') ? ALLOC : REALLOC;
+            op->size = size;
+            if ((int)index > max_index)
+                max_index = index;
+            break;
+        case 'f':
+            if (fscanf(in, "%u", &index) != 1)
+                goto bad;
+            op->type = FREE;
+            op->size = 0;
+            break;
+        default:
+            goto bad;
+        }
+        op->index = index;
+        nops++;
+        if (++nbuf == OPBUFLEN) {
+            fwrite(buf, sizeof(*buf), nbuf, out);
+            nbuf = 0;
+        }
+    }
+    fwrite(buf, sizeof(*buf), nbuf, out);
+    fclose(in);
+
+    if (nops != hdr.num_ops || max_index != hdr.num_ids - 1) {
+        fprintf(stderr, "%s: header says %lu ops and %d ids, found %lu "
+                "and %d\n", inname, (unsigned long)hdr.num_ops,
+                hdr.num_ids, (unsigned long)nops, max_index + 1);
+        fclose(out);
+        unlink(outname);
+        return -1;
+    }
+    if (fclose(out) != 0) {
+        perror(outname);
+        unlink(outname);
+        return -1;
+    }
+    return 0;
+
+ bad:
+    fprintf(stderr, "%s: bad request %lu (%s)\n", inname,
+            (unsigned long)nops, type);
+    fclose(in);
+    fclose(out);
+    unlink(outname);
+    return -1;
+}
+
+int main(int argc, char **argv)
+{
+    char outname[MAXLINE];
+    const char *oflag = NULL;
+    size_t len;
+    int c, i, status = 0;
+
+    while ((c = getopt(argc, argv, "o:h")) != EOF) {
+        switch (c) {
+        case 'o':
+            oflag = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: rep2bin [-o <out.bin>] <trace.rep>...\n");
+            exit(c == 'h' ? 0 : 1);
+        }
+    }
+    if (optind == argc || (oflag != NULL && argc - optind > 1)) {
+        fprintf(stderr, "Usage: rep2bin [-o <out.bin>] <trace.rep>...\n");
+        exit(1);
+    }
+
+    for (i = optind; i < argc; i++) {
+        if (oflag != NULL) {
+            snprintf(outname, sizeof(outname), "%s", oflag);
+        } else {
+            len = strlen(argv[i]);
+            if (len > 4 && strcmp(argv[i] + len - 4, ".rep") == 0)
+                len -= 4;
+            snprintf(outname, sizeof(outname), "%.*s.bin", (int)len, argv[i]);
+        }
+        if (convert(argv[i], outname) < 0)
+            status = 1;
+    }
+    return status;
+}
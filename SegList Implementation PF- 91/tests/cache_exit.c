@@ -0,0 +1,106 @@
+/*
+ * cache_exit.c - Thread caches and the key destructors that run after
+ *     theirs
+ *
+ * With MM_RSEQ=0 every thread gets a thread cache, given back by a
+ * pthread key destructor when the thread exits. Destructors of other
+ * keys may run after it and still malloc and free; they must not use
+ * the cache any more, since a new thread may have taken it over. Each
+ * round starts threads while the last round's exit, and their
+ * destructors churn small blocks, checking that no block is handed to
+ * two threads at once and that no exited thread leaves blocks cached.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+#define ROUNDS    200
+#define THREADS   4
+#define CHURN     200
+#define SIZE      40
+
+static pthread_key_t churn_key;
+static int failed;
+
+/* churn - malloc, fill with this thread's mark, yield, check, free */
+static void churn(unsigned char mark)
+{
+    unsigned char *p;
+    int i, j;
+
+    for (i = 0; i < CHURN; i++) {
+        if ((p = mm_malloc(SIZE)) == NULL) {
+            failed = 1;
+            return;
+        }
+        memset(p, mark, SIZE);
+        sched_yield();
+        for (j = 0; j < SIZE; j++)
+            if (p[j] != mark) {
+                fprintf(stderr, "cache_exit: block handed out twice\n");
+                failed = 1;
+                break;
+            }
+        mm_free(p);
+    }
+}
+
+/* Runs after(or before) the cache's own destructor */
+static void churn_dtor(void *arg)
+{
+    churn((unsigned char)(uintptr_t)arg);
+}
+
+static void *worker(void *arg)
+{
+    pthread_setspecific(churn_key, arg);
+    churn((unsigned char)(uintptr_t)arg);
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t tids[2][THREADS];
+    mm_check_error_t err;
+    struct mm_stats st;
+    int r, t;
+
+    setenv("MM_RSEQ", "0", 1);
+    mem_init();
+    if (mm_init() < 0 || mm_cpucache_start(4096) != 0) {
+        fprintf(stderr, "cache_exit: no thread caches\n");
+        return 1;
+    }
+    pthread_key_create(&churn_key, churn_dtor);
+
+    /* A round's threads start before the last round's are joined */
+    for (r = 0; r <= ROUNDS; r++) {
+        for (t = 0; t < THREADS && r < ROUNDS; t++)
+            pthread_create(&tids[r % 2][t], NULL, worker,
+                           (void *)(uintptr_t)(r * THREADS + t + 1));
+        for (t = 0; t < THREADS && r > 0; t++)
+            pthread_join(tids[(r - 1) % 2][t], NULL);
+    }
+
+    /* Every thread is gone, so no cache may still hold blocks */
+    mm_stats(&st);
+    if (st.cache_bytes != 0) {
+        fprintf(stderr, "cache_exit: %llu bytes left in the caches of "
+                "exited threads\n", (unsigned long long)st.cache_bytes);
+        failed = 1;
+    }
+
+    mm_cpucache_stop();
+    if (mm_check(MM_CHECK_FULL, 1, &err) != MM_CHECK_OK) {
+        fprintf(stderr, "cache_exit: %s\n", mm_check_strerror(err.code));
+        failed = 1;
+    }
+    printf("cache_exit: %s\n", failed ? "FAILED" : "ok");
+    return failed;
+}
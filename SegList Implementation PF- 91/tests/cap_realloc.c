@@ -0,0 +1,80 @@
+/*
+ * cap_realloc.c - mmcap2rep and a realloc whose old block is handed
+ *     out again before its record is taken
+ *
+ *     unix> tests/cap_realloc <log> <trace>
+ *
+ * Thread A reallocs block 0 to a new place; glibc frees the old one
+ * inside realloc, and thread B's malloc gets it and is logged before
+ * A's realloc. B's block must be a block of its own, which B's later
+ * free frees, and A's realloc must move block 0. A realloc that fails
+ * must leave its block where it was. The log is written out of order,
+ * as buffers of several threads would be, converted with ./mmcap2rep,
+ * and the trace compared with the expected one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "mmcapture.h"
+
+#define REC(s, t, p, o, n) { (uint64_t)(s) << CAP_TYPEBITS | (t), p, o, n }
+
+/* Thread B's records first, then thread A's */
+static const caprec_t log_recs[] = {
+    REC(3, CAP_MALLOC, 0x1000, 0, 24),     /* B: malloc gets A's old */
+    REC(5, CAP_FREE, 0x1000, 0, 0),        /* B: frees it */
+    REC(1, CAP_MALLOC, 0x1000, 0, 16),     /* A: block 0 */
+    REC(2, CAP_MOVE, 0x1000, 0, 64),       /* A: realloc starts... */
+    REC(4, CAP_REALLOC, 0x2000, 2, 64),    /* ...and moves it */
+    REC(6, CAP_MOVE, 0x2000, 0, 1UL << 40),
+    REC(7, CAP_REALLOC, 0, 6, 1UL << 40),  /* A: realloc fails */
+    REC(8, CAP_FREE, 0x2000, 0, 0),        /* A: frees block 0 */
+};
+
+static const char expected[] =
+    "0\n2\n5\n0\n"
+    "a 0 16\n"
+    "a 1 24\n"
+    "r 0 64\n"
+    "f 1\n"
+    "f 0\n";
+
+int main(int argc, char **argv)
+{
+    char cmd[1024];
+    char got[sizeof(expected) + 64];
+    size_t len;
+    FILE *fp;
+    int ok;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: cap_realloc <log> <trace>\n");
+        return 1;
+    }
+    if ((fp = fopen(argv[1], "wb")) == NULL ||
+        fwrite(log_recs, sizeof(log_recs), 1, fp) != 1 || fclose(fp) != 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    snprintf(cmd, sizeof(cmd), "./mmcap2rep -o %s %s >/dev/null",
+             argv[2], argv[1]);
+    if (system(cmd) != 0) {
+        fprintf(stderr, "cap_realloc: mmcap2rep failed\n");
+        return 1;
+    }
+    if ((fp = fopen(argv[2], "r")) == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    len = fread(got, 1, sizeof(got) - 1, fp);
+    got[len] = '\0';
+    fclose(fp);
+
+    ok = strcmp(got, expected) == 0;
+    if (!ok)
+        fprintf(stderr, "cap_realloc: got\n%sexpected\n%s", got, expected);
+    printf("cap_realloc: %s\n", ok ? "ok" : "FAILED");
+    return !ok;
+}
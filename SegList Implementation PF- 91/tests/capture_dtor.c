@@ -0,0 +1,88 @@
+/*
+ * capture_dtor.c - libmmcapture.so and the key destructors that run
+ *     after its own
+ *
+ *     unix> LD_PRELOAD=./libmmcapture.so MMCAPTURE_FILE=<log> \
+ *           tests/capture_dtor <log>
+ *
+ * The shim flushes and unmaps a thread's buffer from a pthread key
+ * destructor. Destructors of the program's keys may run after it and
+ * still malloc and free; those calls must neither touch the unmapped
+ * buffer nor go missing from the log. Each thread hands its key a
+ * block of a size no other thread uses, and the destructor frees it;
+ * after the threads are joined the log must hold that free.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "mmcapture.h"
+
+#define THREADS 4
+#define SIZE    32
+
+static pthread_key_t key;
+
+/* Frees the thread's block and churns a little more */
+static void free_dtor(void *arg)
+{
+    free(arg);
+    free(malloc(SIZE));
+}
+
+static void *worker(void *arg)
+{
+    pthread_setspecific(key, malloc(SIZE + (uintptr_t)arg));
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t tids[THREADS];
+    uint64_t ptr[THREADS], seq[THREADS];
+    caprec_t r;
+    FILE *fp;
+    int t, freed = 0;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: capture_dtor <log>\n");
+        return 1;
+    }
+    pthread_key_create(&key, free_dtor);
+    for (t = 0; t < THREADS; t++)
+        pthread_create(&tids[t], NULL, worker, (void *)(uintptr_t)(t + 1));
+    for (t = 0; t < THREADS; t++)
+        pthread_join(tids[t], NULL);
+
+    /* Find each thread's block by its size, then its later free */
+    for (t = 0; t < THREADS; t++)
+        ptr[t] = 0;
+    if ((fp = fopen(argv[1], "rb")) == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    while (fread(&r, sizeof(r), 1, fp) == 1) {
+        if (CAP_TYPE(&r) == CAP_MALLOC && r.size > SIZE &&
+            r.size <= SIZE + THREADS) {
+            t = r.size - SIZE - 1;
+            ptr[t] = r.ptr;
+            seq[t] = CAP_SEQ(&r);
+        }
+    }
+    rewind(fp);
+    while (fread(&r, sizeof(r), 1, fp) == 1)
+        for (t = 0; t < THREADS; t++)
+            if (CAP_TYPE(&r) == CAP_FREE && ptr[t] != 0 &&
+                r.ptr == ptr[t] && CAP_SEQ(&r) > seq[t]) {
+                ptr[t] = 0;
+                freed++;
+            }
+    fclose(fp);
+
+    if (freed != THREADS)
+        fprintf(stderr, "capture_dtor: %d of %d destructor frees logged\n",
+                freed, THREADS);
+    printf("capture_dtor: %s\n", freed == THREADS ? "ok" : "FAILED");
+    return freed != THREADS;
+}
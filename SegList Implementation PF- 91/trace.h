@@ -0,0 +1,41 @@
+/*
+ * trace.h - Trace operations and the binary trace file format
+ *
+ * A text trace(.rep) is four header lines(weight, num_ids, num_ops,
+ * ignore_ranges) followed by one "a id size", "r id size" or "f id"
+ * line per request. A binary trace is a tracehdr_t followed by
+ * num_ops packed traceop_t records, in host byte order, so mdriver
+ * can mmap it and replay the records in place. rep2bin converts the
+ * first into the second.
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdint.h>
+
+/* Request types */
+enum { ALLOC, FREE, REALLOC };
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    int32_t type;   /* type of request */
+    int32_t index;  /* index for free() to use later */
+    uint64_t size;  /* byte size of alloc/realloc request */
+} traceop_t;
+
+/* First bytes of every binary trace */
+#define TRACE_MAGIC     "MMTRACE\n"
+#define TRACE_MAGICLEN  8
+#define TRACE_VERSION   1
+
+/* Binary trace header; the records start right after it */
+typedef struct {
+    char magic[TRACE_MAGICLEN]; /* TRACE_MAGIC */
+    uint32_t version;           /* TRACE_VERSION */
+    int32_t weight;             /* same four fields as a .rep header */
+    int32_t num_ids;
+    int32_t ignore_ranges;
+    uint64_t num_ops;
+} tracehdr_t;
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,243 @@
+/*
+ * tstream.c - Stream the ops of a trace in chunks
+ *
+ * Two chunk buffers are handed back and forth: the reader thread fills
+ * one while the replay works through the other. A chunk of length 0
+ * marks the end of the trace.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tstream.h"
+
+struct tstream {
+    FILE *fp;
+    int binary;                      /* binary records, else text lines */
+    uint64_t left;                   /* ops the reader has yet to read */
+    int error;                       /* short or malformed trace */
+    unsigned size;                   /* last size read, see read_text */
+
+    traceop_t *buf[2];               /* the two chunks... */
+    int len[2];                      /* ...their lengths... */
+    int full[2];                     /* ...and who owns them */
+    int cur;                         /* chunk the replay holds, or -1 */
+    int stop;                        /* tstream_close was called */
+
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+/*
+ * read_text - Parse up to n text requests into ops; returns how many.
+ *     Like read_trace, a request without a size keeps the previous one,
+ *     and only a free may have an id past INT_MAX(free(NULL) is -1).
+ */
+static int read_text(tstream_t *ts, traceop_t *ops, int n)
+{
+    char type[16];
+    unsigned index;
+    int i;
+
+    for (i = 0; i < n && fscanf(ts->fp, "%15s", type) == 1; i++) {
+        switch (type[0]) {
+        case 'a':
+        case 'r':
+            if (fscanf(ts->fp, "%u %u", &index, &ts->size) < 1)
+                return -1;
+            ops[i].type = (type[0] == 'a') ? ALLOC : REALLOC;
+            ops[i].size = ts->size;
+            break;
+        case 'f':
+            if (fscanf(ts->fp, "%u", &index) != 1)
+                return -1;
+            ops[i].type = FREE;
+            ops[i].size = 0;
+            break;
+        default:
+            return -1;
+        }
+        if (index > INT_MAX && type[0] != 'f')
+            return -1;
+        ops[i].index = index;
+    }
+    return i;
+}
+
+/*
+ * read_chunk - Read the next chunk into ops; returns its length, 0 at
+ *     the end of the trace
+ */
+static int read_chunk(tstream_t *ts, traceop_t *ops)
+{
+    int want = (ts->left < TSTREAM_CHUNK) ? (int)ts->left : TSTREAM_CHUNK;
+    int i, n;
+
+    if (want == 0)
+        return 0;
+    if (ts->binary) {
+        n = fread(ops, sizeof(*ops), want, ts->fp);
+        /* Like map_trace: only a free may have a negative id */
+        for (i = 0; i < n; i++)
+            if (ops[i].index < 0 && ops[i].type != FREE)
+                n = -1;
+    } else
+        n = read_text(ts, ops, want);
+
+    if (n <= 0) {
+        ts->error = 1;
+        ts->left = 0;
+        return 0;
+    }
+    ts->left -= n;
+    return n;
+}
+
+/*
+ * reader - Fill the chunks in turn until the end of the trace
+ */
+static void *reader(void *arg)
+{
+    tstream_t *ts = arg;
+    int b = 0, n, stop;
+
+    do {
+        pthread_mutex_lock(&ts->lock);
+        while (ts->full[b] && !ts->stop)
+            pthread_cond_wait(&ts->cond, &ts->lock);
+        stop = ts->stop;
+        pthread_mutex_unlock(&ts->lock);
+        if (stop)
+            break;
+
+        n = read_chunk(ts, ts->buf[b]);
+
+        pthread_mutex_lock(&ts->lock);
+        ts->len[b] = n;
+        ts->full[b] = 1;
+        pthread_cond_broadcast(&ts->cond);
+        pthread_mutex_unlock(&ts->lock);
+        b ^= 1;
+    } while (n > 0);
+
+    return NULL;
+}
+
+/*
+ * read_header - Read the trace header into info and ts->left
+ */
+static int read_header(tstream_t *ts, tstream_info_t *info)
+{
+    tracehdr_t hdr;
+    unsigned long num_ops;
+
+    if (fread(&hdr, 1, TRACE_MAGICLEN, ts->fp) == TRACE_MAGICLEN &&
+        memcmp(hdr.magic, TRACE_MAGIC, TRACE_MAGICLEN) == 0) {
+        if (fread((char *)&hdr + TRACE_MAGICLEN,
+                  sizeof(hdr) - TRACE_MAGICLEN, 1, ts->fp) != 1 ||
+            hdr.version != TRACE_VERSION)
+            return -1;
+        ts->binary = 1;
+        info->weight = hdr.weight;
+        info->num_ids = hdr.num_ids;
+        info->ignore_ranges = hdr.ignore_ranges;
+        info->num_ops = hdr.num_ops;
+    } else {
+        rewind(ts->fp);
+        if (fscanf(ts->fp, "%d %d %lu %d", &info->weight, &info->num_ids,
+                   &num_ops, &info->ignore_ranges) != 4)
+            return -1;
+        info->num_ops = num_ops;
+    }
+    ts->left = info->num_ops;
+    return 0;
+}
+
+tstream_t *tstream_open(const char *filename, tstream_info_t *info)
+{
+    tstream_t *ts;
+    int err;
+
+    if ((ts = calloc(1, sizeof(*ts))) == NULL)
+        return NULL;
+    if ((ts->fp = fopen(filename, "r")) == NULL)
+        goto fail;
+    if (read_header(ts, info) < 0) {
+        errno = EINVAL;
+        goto fail;
+    }
+    ts->buf[0] = malloc(TSTREAM_CHUNK * sizeof(traceop_t));
+    ts->buf[1] = malloc(TSTREAM_CHUNK * sizeof(traceop_t));
+    if (ts->buf[0] == NULL || ts->buf[1] == NULL)
+        goto fail;
+
+    ts->cur = -1;
+    pthread_mutex_init(&ts->lock, NULL);
+    pthread_cond_init(&ts->cond, NULL);
+    if ((err = pthread_create(&ts->reader, NULL, reader, ts)) != 0) {
+        pthread_cond_destroy(&ts->cond);
+        pthread_mutex_destroy(&ts->lock);
+        errno = err;
+        goto fail;
+    }
+    return ts;
+
+ fail:
+    err = errno;
+    if (ts->fp != NULL)
+        fclose(ts->fp);
+    free(ts->buf[0]);
+    free(ts->buf[1]);
+    free(ts);
+    errno = err;
+    return NULL;
+}
+
+const traceop_t *tstream_next(tstream_t *ts, int *n)
+{
+    pthread_mutex_lock(&ts->lock);
+    if (ts->cur >= 0) {
+        /* Hand the chunk we are done with back to the reader */
+        if (ts->len[ts->cur] == 0) {
+            pthread_mutex_unlock(&ts->lock);
+            *n = 0;
+            return NULL;
+        }
+        ts->full[ts->cur] = 0;
+        pthread_cond_broadcast(&ts->cond);
+        ts->cur ^= 1;
+    } else {
+        ts->cur = 0;
+    }
+    while (!ts->full[ts->cur])
+        pthread_cond_wait(&ts->cond, &ts->lock);
+    *n = ts->len[ts->cur];
+    pthread_mutex_unlock(&ts->lock);
+
+    return (*n > 0) ? ts->buf[ts->cur] : NULL;
+}
+
+int tstream_error(const tstream_t *ts)
+{
+    return ts->error;
+}
+
+void tstream_close(tstream_t *ts)
+{
+    pthread_mutex_lock(&ts->lock);
+    ts->stop = 1;
+    pthread_cond_broadcast(&ts->cond);
+    pthread_mutex_unlock(&ts->lock);
+    pthread_join(ts->reader, NULL);
+
+    pthread_cond_destroy(&ts->cond);
+    pthread_mutex_destroy(&ts->lock);
+    fclose(ts->fp);
+    free(ts->buf[0]);
+    free(ts->buf[1]);
+    free(ts);
+}
@@ -0,0 +1,40 @@
+/*
+ * tstream.h - Stream the ops of a trace in chunks
+ *
+ * A background thread reads the next chunk of a text or binary trace
+ * (see trace.h) while the caller replays the current one, so only two
+ * chunks are ever in memory, however long the trace is.
+ */
+#ifndef __TSTREAM_H_
+#define __TSTREAM_H_
+
+#include <stdint.h>
+#include "trace.h"
+
+/* Ops per chunk */
+#define TSTREAM_CHUNK (1 << 16)
+
+typedef struct tstream tstream_t;
+
+/* Header fields of a streamed trace */
+typedef struct {
+    int weight;
+    int num_ids;
+    int ignore_ranges;
+    uint64_t num_ops;
+} tstream_info_t;
+
+/* Open filename and start reading it; NULL (errno set) on failure */
+tstream_t *tstream_open(const char *filename, tstream_info_t *info);
+
+/* Return the next chunk and its length in *n, or NULL at the end of
+   the trace; the chunk is valid until the next call */
+const traceop_t *tstream_next(tstream_t *ts, int *n);
+
+/* Nonzero if the trace ended early or had a malformed request */
+int tstream_error(const tstream_t *ts);
+
+/* Stop the reader and close the trace */
+void tstream_close(tstream_t *ts);
+
+#endif /* __TSTREAM_H_ */